@@ -0,0 +1,89 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+// Measure inserts/sec into a single hnsw vector store with multiple threads.
+// Usage: redis-llm-insert-benchmark [dim] [items]
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "sw/redis-llm/hnsw.h"
+
+namespace {
+
+using namespace sw::redis::llm;
+
+std::vector<Vector> random_vectors(std::size_t dim, std::size_t cnt) {
+    std::mt19937 gen(47);
+    std::uniform_real_distribution<float> dist(-1.0, 1.0);
+
+    std::vector<Vector> vecs(cnt, Vector(dim));
+    for (auto &vec : vecs) {
+        for (auto &ele : vec) {
+            ele = dist(gen);
+        }
+    }
+
+    return vecs;
+}
+
+double run(const std::vector<Vector> &vecs, std::size_t threads) {
+    nlohmann::json conf;
+    conf["max_elements"] = vecs.size();
+    // Vacuum runs with the module's worker pool, which is not available here.
+    conf["vacuum_ratio"] = 0;
+
+    auto store = std::make_shared<Hnsw>(conf, LlmInfo());
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (std::size_t tid = 0; tid != threads; ++tid) {
+        workers.emplace_back([&vecs, &store, tid, threads]() {
+                for (auto idx = tid; idx < vecs.size(); idx += threads) {
+                    store->add(idx, "data", vecs[idx]);
+                }
+            });
+    }
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return vecs.size() / elapsed.count();
+}
+
+}
+
+int main(int argc, char **argv) {
+    std::size_t dim = argc > 1 ? std::stoul(argv[1]) : 128;
+    std::size_t items = argc > 2 ? std::stoul(argv[2]) : 100000;
+
+    auto vecs = random_vectors(dim, items);
+
+    std::printf("dim: %zu, items: %zu\n", dim, items);
+    std::printf("%8s %16s\n", "threads", "inserts/sec");
+    for (auto threads : {1, 4, 16, 32}) {
+        std::printf("%8d %16.0f\n", threads, run(vecs, threads));
+    }
+
+    return 0;
+}
@@ -0,0 +1,648 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+// End-to-end load test. Start a local OpenAI compatible stub server, point an openai model
+// of a running Redis server (with redis-llm loaded) to it, and drive LLM.ADD, LLM.KNN and
+// LLM.RUN (with search and chat applications) from many concurrent Redis clients.
+// Redis server must run on the same host, since the stub server listens on 127.0.0.1.
+// Usage: redis-llm-load-test [--host 127.0.0.1] [--port 6379] [--clients 50] [--duration 10]
+//          [--flows add,knn,search,chat] [--dim 1536] [--latency 0] [--jitter 0]
+//          [--error-rate 0] [--chunks 1] [--http-pool 5]
+// Latency and jitter are in milliseconds, and each stub response takes latency plus a
+// uniformly random jitter. With error rate, stub returns 429 randomly. With more than 1
+// chunks, stub streams the response with chunked transfer encoding.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 6379;
+    std::size_t clients = 50;
+    std::size_t duration = 10;
+    std::vector<std::string> flows = {"add", "knn", "search", "chat"};
+    std::size_t dim = 1536;
+    std::size_t latency = 0;
+    std::size_t jitter = 0;
+    double error_rate = 0;
+    std::size_t chunks = 1;
+    std::size_t http_pool = 5;
+};
+
+std::vector<std::string> split(const std::string &str, char delim) {
+    std::vector<std::string> parts;
+    std::size_t start = 0;
+    while (start <= str.size()) {
+        auto pos = str.find(delim, start);
+        if (pos == std::string::npos) {
+            pos = str.size();
+        }
+        if (pos > start) {
+            parts.push_back(str.substr(start, pos - start));
+        }
+        start = pos + 1;
+    }
+
+    return parts;
+}
+
+Options parse_options(int argc, char **argv) {
+    Options opts;
+    for (int idx = 1; idx + 1 < argc; idx += 2) {
+        std::string key = argv[idx];
+        std::string val = argv[idx + 1];
+        if (key == "--host") {
+            opts.host = val;
+        } else if (key == "--port") {
+            opts.port = std::stoi(val);
+        } else if (key == "--clients") {
+            opts.clients = std::stoul(val);
+        } else if (key == "--duration") {
+            opts.duration = std::stoul(val);
+        } else if (key == "--flows") {
+            opts.flows = split(val, ',');
+        } else if (key == "--dim") {
+            opts.dim = std::stoul(val);
+        } else if (key == "--latency") {
+            opts.latency = std::stoul(val);
+        } else if (key == "--jitter") {
+            opts.jitter = std::stoul(val);
+        } else if (key == "--error-rate") {
+            opts.error_rate = std::stod(val);
+        } else if (key == "--chunks") {
+            opts.chunks = std::max<std::size_t>(std::stoul(val), 1);
+        } else if (key == "--http-pool") {
+            opts.http_pool = std::stoul(val);
+        } else {
+            throw std::runtime_error("unknown option: " + key);
+        }
+    }
+
+    return opts;
+}
+
+bool send_all(int fd, const std::string_view &data) {
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+        auto len = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (len <= 0) {
+            return false;
+        }
+        sent += len;
+    }
+
+    return true;
+}
+
+std::string base64_encode(const std::string_view &input) {
+    const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string output;
+    std::size_t idx = 0;
+    for (; idx + 3 <= input.size(); idx += 3) {
+        uint32_t val = (static_cast<unsigned char>(input[idx]) << 16)
+            | (static_cast<unsigned char>(input[idx + 1]) << 8)
+            | static_cast<unsigned char>(input[idx + 2]);
+        output += alphabet[val >> 18];
+        output += alphabet[(val >> 12) & 0x3F];
+        output += alphabet[(val >> 6) & 0x3F];
+        output += alphabet[val & 0x3F];
+    }
+
+    if (idx + 1 == input.size()) {
+        uint32_t val = static_cast<unsigned char>(input[idx]) << 16;
+        output += alphabet[val >> 18];
+        output += alphabet[(val >> 12) & 0x3F];
+        output += "==";
+    } else if (idx + 2 == input.size()) {
+        uint32_t val = (static_cast<unsigned char>(input[idx]) << 16)
+            | (static_cast<unsigned char>(input[idx + 1]) << 8);
+        output += alphabet[val >> 18];
+        output += alphabet[(val >> 12) & 0x3F];
+        output += alphabet[(val >> 6) & 0x3F];
+        output += '=';
+    }
+
+    return output;
+}
+
+// OpenAI compatible server for /v1/embeddings and /v1/chat/completions.
+class StubServer {
+public:
+    explicit StubServer(const Options &opts) : _opts(opts) {
+        _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (_fd < 0) {
+            throw std::runtime_error("failed to create socket");
+        }
+
+        int on = 1;
+        ::setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        // Let kernel choose a free port.
+        addr.sin_port = 0;
+        if (::bind(_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0
+                || ::listen(_fd, 1024) != 0) {
+            throw std::runtime_error("failed to listen on loopback");
+        }
+
+        socklen_t len = sizeof(addr);
+        ::getsockname(_fd, reinterpret_cast<sockaddr *>(&addr), &len);
+        _port = ntohs(addr.sin_port);
+
+        std::thread([this]() { _accept(); }).detach();
+    }
+
+    int port() const {
+        return _port;
+    }
+
+    std::size_t requests() const {
+        return _requests;
+    }
+
+    std::size_t rejected() const {
+        return _rejected;
+    }
+
+    std::size_t in_flight() const {
+        return _in_flight;
+    }
+
+private:
+    void _accept() {
+        while (true) {
+            auto conn = ::accept(_fd, nullptr, nullptr);
+            if (conn < 0) {
+                continue;
+            }
+
+            int on = 1;
+            ::setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+            std::thread([this, conn]() {
+                    _serve(conn);
+                    ::close(conn);
+                }).detach();
+        }
+    }
+
+    // Serve requests of a keep-alive connection, until peer closes it.
+    void _serve(int conn) {
+        std::mt19937_64 gen(std::random_device{}());
+        std::string buf;
+        char data[16 * 1024];
+        while (true) {
+            auto header_end = buf.find("\r\n\r\n");
+            if (header_end == std::string::npos) {
+                auto len = ::recv(conn, data, sizeof(data), 0);
+                if (len <= 0) {
+                    return;
+                }
+                buf.append(data, len);
+                continue;
+            }
+
+            auto header = buf.substr(0, header_end + 2);
+            std::transform(header.begin(), header.end(), header.begin(), ::tolower);
+
+            std::size_t content_len = 0;
+            auto pos = header.find("content-length:");
+            if (pos != std::string::npos) {
+                content_len = std::stoul(header.substr(pos + std::strlen("content-length:")));
+            }
+
+            if (header.find("expect: 100-continue") != std::string::npos
+                    && buf.size() == header_end + 4
+                    && !send_all(conn, "HTTP/1.1 100 Continue\r\n\r\n")) {
+                return;
+            }
+
+            while (buf.size() < header_end + 4 + content_len) {
+                auto len = ::recv(conn, data, sizeof(data), 0);
+                if (len <= 0) {
+                    return;
+                }
+                buf.append(data, len);
+            }
+
+            auto body = buf.substr(header_end + 4, content_len);
+            auto path = header.substr(header.find(' ') + 1);
+            path = path.substr(0, path.find(' '));
+            buf.erase(0, header_end + 4 + content_len);
+
+            if (!_respond(conn, path, body, gen)) {
+                return;
+            }
+        }
+    }
+
+    bool _respond(int conn, const std::string &path, const std::string &body, std::mt19937_64 &gen) {
+        ++_requests;
+        ++_in_flight;
+
+        auto latency = _opts.latency;
+        if (_opts.jitter > 0) {
+            latency += std::uniform_int_distribution<std::size_t>(0, _opts.jitter)(gen);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+
+        int status = 200;
+        std::string resp;
+        if (_opts.error_rate > 0 && std::uniform_real_distribution<double>(0, 1)(gen) < _opts.error_rate) {
+            ++_rejected;
+            status = 429;
+            resp = R"({"error": {"message": "Rate limit reached", "type": "requests"}})";
+        } else if (path.find("/embeddings") != std::string::npos) {
+            resp = _embedding(body, gen);
+        } else if (path.find("/chat/completions") != std::string::npos) {
+            resp = R"({"id": "chatcmpl-stub", "object": "chat.completion", "choices": [{"index": 0, )"
+                R"("message": {"role": "assistant", "content": "This is a response from stub server."}, )"
+                R"("finish_reason": "stop"}], "usage": {"prompt_tokens": 8, "completion_tokens": 8, "total_tokens": 16}})";
+        } else {
+            status = 404;
+            resp = R"({"error": {"message": "unknown path"}})";
+        }
+
+        auto ok = _send(conn, status, resp);
+
+        --_in_flight;
+
+        return ok;
+    }
+
+    std::string _embedding(const std::string &body, std::mt19937_64 &gen) const {
+        std::uniform_real_distribution<float> dist(-1, 1);
+        std::vector<float> embedding(_opts.dim);
+        for (auto &ele : embedding) {
+            ele = dist(gen);
+        }
+
+        std::string data;
+        if (body.find("\"base64\"") != std::string::npos) {
+            data = "\"" + base64_encode(std::string_view(reinterpret_cast<const char *>(embedding.data()),
+                        embedding.size() * sizeof(float))) + "\"";
+        } else {
+            data = "[";
+            for (auto ele : embedding) {
+                data += std::to_string(ele) + ",";
+            }
+            data.back() = ']';
+        }
+
+        return R"({"object": "list", "data": [{"object": "embedding", "index": 0, "embedding": )" + data
+            + R"(}], "model": "stub", "usage": {"prompt_tokens": 8, "total_tokens": 8}})";
+    }
+
+    bool _send(int conn, int status, const std::string &resp) const {
+        std::string header = "HTTP/1.1 " + std::to_string(status)
+            + (status == 200 ? " OK" : " Error") + "\r\nContent-Type: application/json\r\n";
+        if (_opts.chunks <= 1) {
+            header += "Content-Length: " + std::to_string(resp.size()) + "\r\n\r\n";
+            return send_all(conn, header + resp);
+        }
+
+        header += "Transfer-Encoding: chunked\r\n\r\n";
+        if (!send_all(conn, header)) {
+            return false;
+        }
+
+        auto chunk_size = (resp.size() + _opts.chunks - 1) / _opts.chunks;
+        for (std::size_t pos = 0; pos < resp.size(); pos += chunk_size) {
+            auto chunk = std::string_view(resp).substr(pos, chunk_size);
+            char size[32];
+            std::snprintf(size, sizeof(size), "%zx\r\n", chunk.size());
+            if (!send_all(conn, size) || !send_all(conn, chunk) || !send_all(conn, "\r\n")) {
+                return false;
+            }
+        }
+
+        return send_all(conn, "0\r\n\r\n");
+    }
+
+    Options _opts;
+
+    int _fd = -1;
+
+    int _port = 0;
+
+    std::atomic<std::size_t> _requests{0};
+
+    std::atomic<std::size_t> _rejected{0};
+
+    std::atomic<std::size_t> _in_flight{0};
+};
+
+// Minimal blocking Redis client with RESP2 protocol.
+class RedisClient {
+public:
+    RedisClient(const std::string &host, int port) {
+        _fd = ::socket(AF_INET, SOCK_STREAM, 0);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        if (_fd < 0 || ::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1
+                || ::connect(_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+            throw std::runtime_error("failed to connect to Redis: " + host + ":" + std::to_string(port));
+        }
+
+        int on = 1;
+        ::setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+
+    RedisClient(const RedisClient &) = delete;
+    RedisClient& operator=(const RedisClient &) = delete;
+
+    ~RedisClient() {
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+    }
+
+    // Return error message, or empty string if it's not an error reply.
+    std::string command(const std::vector<std::string> &args) {
+        std::string req = "*" + std::to_string(args.size()) + "\r\n";
+        for (const auto &arg : args) {
+            req += "$" + std::to_string(arg.size()) + "\r\n" + arg + "\r\n";
+        }
+
+        if (!send_all(_fd, req)) {
+            throw std::runtime_error("failed to send command");
+        }
+
+        return _read_reply();
+    }
+
+private:
+    std::string _read_line() {
+        while (true) {
+            auto pos = _buf.find("\r\n", _pos);
+            if (pos != std::string::npos) {
+                auto line = _buf.substr(_pos, pos - _pos);
+                _pos = pos + 2;
+                return line;
+            }
+            _fill();
+        }
+    }
+
+    void _fill() {
+        if (_pos > 0) {
+            _buf.erase(0, _pos);
+            _pos = 0;
+        }
+
+        char data[16 * 1024];
+        auto len = ::recv(_fd, data, sizeof(data), 0);
+        if (len <= 0) {
+            throw std::runtime_error("connection closed by Redis");
+        }
+        _buf.append(data, len);
+    }
+
+    std::string _read_reply() {
+        auto line = _read_line();
+        if (line.empty()) {
+            throw std::runtime_error("invalid reply");
+        }
+
+        switch (line[0]) {
+        case '-':
+            return line.substr(1);
+
+        case '$': {
+            auto len = std::stol(line.substr(1));
+            if (len >= 0) {
+                while (_buf.size() < _pos + len + 2) {
+                    _fill();
+                }
+                _pos += len + 2;
+            }
+            return "";
+        }
+
+        case '*': {
+            auto cnt = std::stol(line.substr(1));
+            std::string err;
+            for (long idx = 0; idx < cnt; ++idx) {
+                auto e = _read_reply();
+                if (err.empty()) {
+                    err = std::move(e);
+                }
+            }
+            return err;
+        }
+
+        default:
+            return "";
+        }
+    }
+
+    int _fd = -1;
+
+    std::string _buf;
+
+    std::size_t _pos = 0;
+};
+
+const std::string PREFIX = "redis-llm-load-test";
+const std::string LLM_KEY = PREFIX + "-llm";
+const std::string STORE_KEY = PREFIX + "-store";
+const std::string SEARCH_KEY = PREFIX + "-search";
+const std::string CHAT_KEY = PREFIX + "-chat";
+
+void check(const std::string &err, const std::string &what) {
+    if (!err.empty()) {
+        throw std::runtime_error("failed to " + what + ": " + err);
+    }
+}
+
+void setup(const Options &opts, int stub_port) {
+    RedisClient cli(opts.host, opts.port);
+    check(cli.command({"DEL", LLM_KEY, STORE_KEY, SEARCH_KEY, CHAT_KEY}), "clean up keys");
+
+    auto params = R"({"api_key": "stub", "http": {"uri": "http://127.0.0.1:)" + std::to_string(stub_port)
+        + R"(", "socket_timeout": "60s", "pool": {"size": )" + std::to_string(opts.http_pool) + "}}}";
+    check(cli.command({"LLM.CREATE-LLM", LLM_KEY, "--TYPE", "openai", "--PARAMS", params}), "create llm");
+    check(cli.command({"LLM.CREATE-VECTOR-STORE", STORE_KEY, "--LLM", LLM_KEY}), "create vector store");
+    check(cli.command({"LLM.CREATE-SEARCH", SEARCH_KEY, "--LLM", LLM_KEY, "--VECTOR-STORE", STORE_KEY}),
+            "create search");
+    check(cli.command({"LLM.CREATE-CHAT", CHAT_KEY, "--LLM", LLM_KEY, "--VECTOR-STORE", STORE_KEY}),
+            "create chat");
+}
+
+void teardown(const Options &opts) {
+    RedisClient cli(opts.host, opts.port);
+    cli.command({"DEL", LLM_KEY, STORE_KEY, SEARCH_KEY, CHAT_KEY});
+}
+
+std::vector<std::string> flow_command(const std::string &flow, std::size_t client, std::size_t idx) {
+    auto data = "item " + std::to_string(client) + "-" + std::to_string(idx);
+    if (flow == "add") {
+        return {"LLM.ADD", STORE_KEY, data};
+    } else if (flow == "knn") {
+        return {"LLM.KNN", STORE_KEY, "--K", "10", data};
+    } else if (flow == "search") {
+        return {"LLM.RUN", SEARCH_KEY, data};
+    } else if (flow == "chat") {
+        return {"LLM.RUN", CHAT_KEY, "--SESSION", "session-" + std::to_string(client), data};
+    }
+
+    throw std::runtime_error("unknown flow: " + flow);
+}
+
+struct FlowResult {
+    std::vector<double> latencies;
+    std::size_t errors = 0;
+    std::string last_error;
+};
+
+void run_flow(const Options &opts, const StubServer &stub, const std::string &flow) {
+    std::vector<FlowResult> results(opts.clients);
+    std::atomic<bool> stop{false};
+
+    // Sample queue depth of stub server, i.e. number of in-flight provider requests.
+    std::size_t samples = 0;
+    std::size_t depth_sum = 0;
+    std::size_t max_depth = 0;
+    std::thread sampler([&]() {
+            while (!stop) {
+                auto depth = stub.in_flight();
+                depth_sum += depth;
+                max_depth = std::max(max_depth, depth);
+                ++samples;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        });
+
+    auto requests = stub.requests();
+    auto rejected = stub.rejected();
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::seconds(opts.duration);
+
+    std::vector<std::thread> clients;
+    for (std::size_t id = 0; id != opts.clients; ++id) {
+        clients.emplace_back([&opts, &flow, &results, deadline, id]() {
+                auto &result = results[id];
+                try {
+                    RedisClient cli(opts.host, opts.port);
+                    for (std::size_t idx = 0; std::chrono::steady_clock::now() < deadline; ++idx) {
+                        auto cmd_start = std::chrono::steady_clock::now();
+                        auto err = cli.command(flow_command(flow, id, idx));
+                        std::chrono::duration<double, std::milli> elapsed =
+                            std::chrono::steady_clock::now() - cmd_start;
+                        result.latencies.push_back(elapsed.count());
+                        if (!err.empty()) {
+                            ++result.errors;
+                            result.last_error = std::move(err);
+                        }
+                    }
+                } catch (const std::exception &e) {
+                    ++result.errors;
+                    result.last_error = e.what();
+                }
+            });
+    }
+
+    for (auto &cli : clients) {
+        cli.join();
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stop = true;
+    sampler.join();
+
+    std::vector<double> latencies;
+    std::size_t errors = 0;
+    std::string last_error;
+    for (auto &result : results) {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        errors += result.errors;
+        if (!result.last_error.empty()) {
+            last_error = result.last_error;
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    auto percentile = [&latencies](double p) {
+        if (latencies.empty()) {
+            return 0.0;
+        }
+        return latencies[std::min(latencies.size() - 1, static_cast<std::size_t>(p * latencies.size()))];
+    };
+
+    std::printf("%8s %10.1f %10.2f %10.2f %10.2f %8zu %8zu %10.1f %10zu %8zu\n",
+            flow.c_str(),
+            latencies.size() / elapsed.count(),
+            percentile(0.5), percentile(0.99), latencies.empty() ? 0.0 : latencies.back(),
+            errors,
+            stub.requests() - requests,
+            samples == 0 ? 0.0 : static_cast<double>(depth_sum) / samples,
+            max_depth,
+            stub.rejected() - rejected);
+    if (!last_error.empty()) {
+        std::printf("%8s last error: %s\n", "", last_error.c_str());
+    }
+}
+
+}
+
+int main(int argc, char **argv) {
+    try {
+        auto opts = parse_options(argc, argv);
+
+        StubServer stub(opts);
+
+        setup(opts, stub.port());
+
+        std::printf("clients: %zu, duration: %zus, dim: %zu, latency: %zums + [0, %zu]ms, "
+                "error rate: %.3f, chunks: %zu, http pool: %zu, stub port: %d\n",
+                opts.clients, opts.duration, opts.dim, opts.latency, opts.jitter,
+                opts.error_rate, opts.chunks, opts.http_pool, stub.port());
+        std::printf("%8s %10s %10s %10s %10s %8s %8s %10s %10s %8s\n",
+                "flow", "ops/sec", "p50(ms)", "p99(ms)", "max(ms)", "errors",
+                "upstream", "avg-depth", "max-depth", "429s");
+
+        for (const auto &flow : opts.flows) {
+            run_flow(opts, stub, flow);
+        }
+
+        teardown(opts);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
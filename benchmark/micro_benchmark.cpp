@@ -0,0 +1,312 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+// Microbenchmarks of hot paths with Google Benchmark. Emit results as JSON to compare releases:
+// redis-llm-micro-benchmark --benchmark_out=result.json --benchmark_out_format=json
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <benchmark/benchmark.h>
+#include "sw/redis-llm/hnsw.h"
+#include "sw/redis-llm/http_client.h"
+#include "sw/redis-llm/prompt.h"
+#include "sw/redis-llm/redis_llm.h"
+#include "sw/redis-llm/utils.h"
+#include "sw/redis-llm/worker_pool.h"
+
+namespace {
+
+using namespace sw::redis::llm;
+
+Vector random_vector(std::size_t dim, std::mt19937 &gen) {
+    std::uniform_real_distribution<float> dist(-1.0, 1.0);
+    Vector vec(dim);
+    for (auto &ele : vec) {
+        ele = dist(gen);
+    }
+
+    return vec;
+}
+
+std::vector<Vector> random_vectors(std::size_t dim, std::size_t cnt) {
+    std::mt19937 gen(47);
+    std::vector<Vector> vecs;
+    vecs.reserve(cnt);
+    for (std::size_t idx = 0; idx != cnt; ++idx) {
+        vecs.push_back(random_vector(dim, gen));
+    }
+
+    return vecs;
+}
+
+std::shared_ptr<Hnsw> make_store(std::size_t size) {
+    nlohmann::json conf;
+    conf["max_elements"] = size;
+    // Vacuum runs with the module's worker pool, which is not available here.
+    conf["vacuum_ratio"] = 0;
+
+    return std::make_shared<Hnsw>(conf, LlmInfo());
+}
+
+// Stores with *size* items of *dim* dimension, which are shared by benchmarks.
+std::shared_ptr<Hnsw> cached_store(std::size_t dim, std::size_t size) {
+    static std::mutex mtx;
+    static std::map<std::pair<std::size_t, std::size_t>, std::shared_ptr<Hnsw>> stores;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    auto &store = stores[{dim, size}];
+    if (!store) {
+        store = make_store(size);
+        auto vecs = random_vectors(dim, size);
+        for (std::size_t idx = 0; idx != size; ++idx) {
+            store->add(idx, "data " + std::to_string(idx), vecs[idx]);
+        }
+    }
+
+    return store;
+}
+
+void BM_ParseEmbedding(benchmark::State &state) {
+    std::mt19937 gen(47);
+    auto str = util::dump_embedding(random_vector(state.range(0), gen));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(util::parse_embedding(str));
+    }
+    state.SetBytesProcessed(state.iterations() * str.size());
+}
+BENCHMARK(BM_ParseEmbedding)->Arg(128)->Arg(768)->Arg(1536)->Arg(3072);
+
+void BM_DumpEmbedding(benchmark::State &state) {
+    std::mt19937 gen(47);
+    auto vec = random_vector(state.range(0), gen);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(util::dump_embedding(vec));
+    }
+    state.SetItemsProcessed(state.iterations() * vec.size());
+}
+BENCHMARK(BM_DumpEmbedding)->Arg(128)->Arg(768)->Arg(1536)->Arg(3072);
+
+void BM_VectorStoreAdd(benchmark::State &state) {
+    auto dim = state.range(0);
+    auto size = state.range(1);
+    auto vecs = random_vectors(dim, size);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto store = make_store(size);
+        state.ResumeTiming();
+
+        for (decltype(size) idx = 0; idx != size; ++idx) {
+            store->add(idx, "data", vecs[idx]);
+        }
+
+        state.PauseTiming();
+        store.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_VectorStoreAdd)
+    ->ArgsProduct({{128, 768, 1536}, {1000, 10000}})
+    ->Unit(benchmark::kMillisecond);
+
+void BM_VectorStoreKnn(benchmark::State &state) {
+    auto dim = state.range(0);
+    auto store = cached_store(dim, state.range(1));
+    auto queries = random_vectors(dim, 100);
+    std::size_t idx = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(store->knn(queries[idx++ % queries.size()], 10));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_VectorStoreKnn)
+    ->ArgsProduct({{128, 768, 1536}, {1000, 10000}})
+    ->Unit(benchmark::kMicrosecond);
+
+const std::string PROMPT_TPL = "Answer the question based on the context below.\n\n"
+    "Context: {{context}}\n\n---\n\nQuestion: {{question}}\nAnswer:";
+
+void BM_PromptRenderVars(benchmark::State &state) {
+    Prompt prompt(PROMPT_TPL);
+    std::string context(state.range(0), 'x');
+    std::string question = "What is redis-llm?";
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(prompt.render(PromptVars{{"question", question}, {"context", context}}));
+    }
+}
+BENCHMARK(BM_PromptRenderVars)->Arg(1024)->Arg(16 * 1024);
+
+void BM_PromptRenderJson(benchmark::State &state) {
+    Prompt prompt(PROMPT_TPL);
+    nlohmann::json data;
+    data["question"] = "What is redis-llm?";
+    data["context"] = std::string(state.range(0), 'x');
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(prompt.render(data));
+    }
+}
+BENCHMARK(BM_PromptRenderJson)->Arg(1024)->Arg(16 * 1024);
+
+// Round trip of enqueuing a task and waiting for its result, with contention of multiple threads.
+void BM_WorkerPoolEnqueue(benchmark::State &state) {
+    static WorkerPool pool(WorkerPoolOptions{4, 100000});
+    for (auto _ : state) {
+        pool.enqueue([]() {}).get();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_WorkerPoolEnqueue)->Threads(1)->Threads(4)->Threads(16)->UseRealTime();
+
+// Fetch and release clients without sending requests, i.e. contention on the pool.
+void BM_HttpClientPoolFetch(benchmark::State &state) {
+    static HttpClientPool pool = []() {
+        HttpClientOptions opts;
+        opts.uri = "http://127.0.0.1";
+        HttpClientPoolOptions pool_opts;
+        pool_opts.size = 4;
+        return HttpClientPool(opts, pool_opts);
+    }();
+
+    for (auto _ : state) {
+        auto cli = pool.fetch();
+        pool.release(std::move(cli));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HttpClientPoolFetch)->Threads(1)->Threads(4)->Threads(16)->UseRealTime();
+
+// In-memory RedisModuleIO for RDB save and load.
+struct StubIO {
+    std::string buf;
+
+    std::size_t pos = 0;
+};
+
+StubIO* stub_io(RedisModuleIO *io) {
+    return reinterpret_cast<StubIO *>(io);
+}
+
+void stub_save(RedisModuleIO *io, const void *data, std::size_t len) {
+    stub_io(io)->buf.append(static_cast<const char *>(data), len);
+}
+
+void stub_load(RedisModuleIO *io, void *data, std::size_t len) {
+    auto *stub = stub_io(io);
+    if (stub->pos + len > stub->buf.size()) {
+        throw Error("stub rdb: read beyond the end");
+    }
+    std::memcpy(data, stub->buf.data() + stub->pos, len);
+    stub->pos += len;
+}
+
+void stub_save_unsigned(RedisModuleIO *io, uint64_t val) {
+    stub_save(io, &val, sizeof(val));
+}
+
+uint64_t stub_load_unsigned(RedisModuleIO *io) {
+    uint64_t val = 0;
+    stub_load(io, &val, sizeof(val));
+    return val;
+}
+
+void stub_save_float(RedisModuleIO *io, float val) {
+    stub_save(io, &val, sizeof(val));
+}
+
+float stub_load_float(RedisModuleIO *io) {
+    float val = 0;
+    stub_load(io, &val, sizeof(val));
+    return val;
+}
+
+void stub_save_string_buffer(RedisModuleIO *io, const char *str, size_t len) {
+    stub_save_unsigned(io, len);
+    stub_save(io, str, len);
+}
+
+char* stub_load_string_buffer(RedisModuleIO *io, size_t *len) {
+    *len = stub_load_unsigned(io);
+    auto *str = static_cast<char *>(std::malloc(*len + 1));
+    stub_load(io, str, *len);
+    return str;
+}
+
+void stub_log_io_error(RedisModuleIO *io, const char *level, const char *fmt, ...) {
+    // redis-llm always passes the error message as fmt.
+    std::fprintf(stderr, "%s: %s\n", level, fmt);
+}
+
+void install_stub_rdb() {
+    RedisModule_SaveUnsigned = stub_save_unsigned;
+    RedisModule_LoadUnsigned = stub_load_unsigned;
+    RedisModule_SaveFloat = stub_save_float;
+    RedisModule_LoadFloat = stub_load_float;
+    RedisModule_SaveStringBuffer = stub_save_string_buffer;
+    RedisModule_LoadStringBuffer = stub_load_string_buffer;
+    RedisModule_Free = std::free;
+    RedisModule_LogIOError = stub_log_io_error;
+}
+
+void BM_RdbSaveVectorStore(benchmark::State &state) {
+    install_stub_rdb();
+
+    auto store = cached_store(state.range(0), state.range(1));
+    StubIO io;
+    for (auto _ : state) {
+        io.buf.clear();
+        RedisLlm::save_vector_store(reinterpret_cast<RedisModuleIO *>(&io), store.get());
+    }
+    state.SetBytesProcessed(state.iterations() * io.buf.size());
+}
+BENCHMARK(BM_RdbSaveVectorStore)
+    ->ArgsProduct({{128, 1536}, {1000, 10000}})
+    ->Unit(benchmark::kMillisecond);
+
+void BM_RdbLoadVectorStore(benchmark::State &state) {
+    install_stub_rdb();
+
+    auto store = cached_store(state.range(0), state.range(1));
+    StubIO io;
+    RedisLlm::save_vector_store(reinterpret_cast<RedisModuleIO *>(&io), store.get());
+
+    auto &llm = RedisLlm::instance();
+    for (auto _ : state) {
+        io.pos = 0;
+        auto *loaded = static_cast<VectorStore *>(RedisLlm::load_vector_store(
+                    reinterpret_cast<RedisModuleIO *>(&io), llm.encoding_version()));
+        if (loaded == nullptr) {
+            state.SkipWithError("failed to load vector store");
+            break;
+        }
+
+        state.PauseTiming();
+        llm.unregister_object(loaded->shared_from_this());
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * io.buf.size());
+}
+BENCHMARK(BM_RdbLoadVectorStore)
+    ->ArgsProduct({{128, 1536}, {1000, 10000}})
+    ->Unit(benchmark::kMillisecond);
+
+}
+
+BENCHMARK_MAIN();
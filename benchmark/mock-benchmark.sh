@@ -0,0 +1,65 @@
+#!/usr/bin/sh
+
+#**************************************************************************
+#  Copyright (c) 2023 sewenew
+#
+#  Licensed under the Apache License, Version 2.0 (the "License");
+#  you may not use this file except in compliance with the License.
+#  You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+#   Unless required by applicable law or agreed to in writing, software
+#   distributed under the License is distributed on an "AS IS" BASIS,
+#   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+#   See the License for the specific language governing permissions and
+#   limitations under the License.
+# *************************************************************************
+
+# Measure per-command overhead of redis-llm with the mock LLM model, i.e. no network access.
+# Redis server with redis-llm loaded should be running at host:port.
+
+redis_cli=redis-cli
+redis_benchmark=redis-benchmark
+
+if [ $# -lt 2 ]
+then
+    echo "Usage: mock-benchmark.sh host port [clients] [requests] [dim] [mock-latency-params]"
+    echo "e.g. mock-benchmark.sh 127.0.0.1 6379 50 100000 1536 '{\"distribution\": \"constant\", \"mean\": 0}'"
+    exit 1
+fi
+
+host=$1
+port=$2
+clients=${3:-50}
+requests=${4:-100000}
+dim=${5:-1536}
+latency=${6:-'{"distribution": "constant", "mean": 0}'}
+
+prefix="redis-llm-mock-benchmark"
+llm_key="$prefix-llm"
+store_key="$prefix-store"
+app_key="$prefix-app"
+search_key="$prefix-search"
+chat_key="$prefix-chat"
+
+cli="$redis_cli -h $host -p $port"
+benchmark="$redis_benchmark -h $host -p $port -c $clients -n $requests -r 100000 --csv"
+
+$cli del "$llm_key" "$store_key" "$app_key" "$search_key" "$chat_key" >/dev/null
+
+$cli llm.create-llm "$llm_key" --type mock --params "{\"dim\": $dim, \"latency\": $latency}" >/dev/null || exit 1
+$cli llm.create-vector-store "$store_key" --llm "$llm_key" >/dev/null || exit 1
+$cli llm.create-app "$app_key" --llm "$llm_key" --prompt 'You are an expert on {{domain}}.' >/dev/null || exit 1
+$cli llm.create-search "$search_key" --llm "$llm_key" --vector-store "$store_key" >/dev/null || exit 1
+$cli llm.create-chat "$chat_key" --llm "$llm_key" --vector-store "$store_key" >/dev/null || exit 1
+
+echo "clients: $clients, requests: $requests, dim: $dim, latency: $latency"
+
+$benchmark llm.add "$store_key" "data __rand_int__"
+$benchmark llm.knn "$store_key" --k 10 "query __rand_int__"
+$benchmark llm.run "$app_key" --vars '{"domain": "redis"}'
+$benchmark llm.run "$search_key" "question __rand_int__"
+$benchmark llm.run "$chat_key" --session "session-__rand_int__" "message __rand_int__"
+
+$cli del "$llm_key" "$store_key" "$app_key" "$search_key" "$chat_key" >/dev/null
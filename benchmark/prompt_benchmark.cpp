@@ -0,0 +1,87 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+// Compare rendering a search prompt with a large context through a fresh inja environment
+// and JSON variables, i.e. the old way, with Prompt::render and string_view variables.
+// Usage: redis-llm-prompt-benchmark [context-bytes] [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "inja/inja.hpp"
+#include "sw/redis-llm/prompt.h"
+
+namespace {
+
+const std::string TEMPLATE = R"(Please answer the following question based on the given context.
+Context: """
+{{context}}
+"""
+Question: """
+{{question}}
+"""
+Answer: )";
+
+template <typename Func>
+double run(std::size_t iterations, Func &&func) {
+    std::size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t idx = 0; idx != iterations; ++idx) {
+        bytes += func().size();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (bytes == 0) {
+        std::fprintf(stderr, "nothing rendered\n");
+    }
+
+    return elapsed.count() * 1e6 / iterations;
+}
+
+}
+
+int main(int argc, char **argv) {
+    std::size_t context_bytes = argc > 1 ? std::stoul(argv[1]) : 50 * 1024;
+    std::size_t iterations = argc > 2 ? std::stoul(argv[2]) : 10000;
+
+    std::string context;
+    while (context.size() < context_bytes) {
+        context += "redis-llm is an open source project written by sewenew.\n";
+    }
+    std::string question = "who is the author of redis-llm";
+
+    inja::Environment parse_env;
+    auto tpl = parse_env.parse(TEMPLATE);
+    auto inja_us = run(iterations, [&]() {
+            nlohmann::json vars;
+            vars["question"] = question;
+            vars["context"] = context;
+            inja::Environment env;
+            return env.render(tpl, vars);
+        });
+
+    sw::redis::llm::Prompt prompt(TEMPLATE);
+    auto prompt_us = run(iterations, [&]() {
+            return prompt.render(sw::redis::llm::PromptVars{{"question", question}, {"context", context}});
+        });
+
+    std::printf("context bytes: %zu, iterations: %zu\n", context.size(), iterations);
+    std::printf("%16s %16s\n", "renderer", "us/render");
+    std::printf("%16s %16.2f\n", "inja", inja_us);
+    std::printf("%16s %16.2f\n", "prompt", prompt_us);
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+// Compare CPU time of parsing an embedding response into a DOM and converting it to Vector,
+// with parsing it incrementally by EmbeddingResponseParser, for both float and base64 encoding.
+// Usage: redis-llm-response-parser-benchmark [dim] [iterations] [chunk-size]
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+#include "nlohmann/json.hpp"
+#include "sw/redis-llm/response_parser.h"
+
+namespace {
+
+using namespace sw::redis::llm;
+
+std::string base64_encode(const std::string_view &input) {
+    const char *alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string output;
+    std::size_t idx = 0;
+    for (; idx + 3 <= input.size(); idx += 3) {
+        uint32_t val = (static_cast<unsigned char>(input[idx]) << 16)
+            | (static_cast<unsigned char>(input[idx + 1]) << 8)
+            | static_cast<unsigned char>(input[idx + 2]);
+        output += alphabet[val >> 18];
+        output += alphabet[(val >> 12) & 0x3F];
+        output += alphabet[(val >> 6) & 0x3F];
+        output += alphabet[val & 0x3F];
+    }
+
+    if (idx + 1 == input.size()) {
+        uint32_t val = static_cast<unsigned char>(input[idx]) << 16;
+        output += alphabet[val >> 18];
+        output += alphabet[(val >> 12) & 0x3F];
+        output += "==";
+    } else if (idx + 2 == input.size()) {
+        uint32_t val = (static_cast<unsigned char>(input[idx]) << 16)
+            | (static_cast<unsigned char>(input[idx + 1]) << 8);
+        output += alphabet[val >> 18];
+        output += alphabet[(val >> 12) & 0x3F];
+        output += alphabet[(val >> 6) & 0x3F];
+        output += '=';
+    }
+
+    return output;
+}
+
+std::string make_response(std::size_t dim, bool base64) {
+    std::mt19937 gen(47);
+    std::uniform_real_distribution<float> dist(-0.1, 0.1);
+
+    Vector embedding(dim);
+    for (auto &ele : embedding) {
+        ele = dist(gen);
+    }
+
+    nlohmann::json data;
+    data["object"] = "embedding";
+    data["index"] = 0;
+    if (base64) {
+        data["embedding"] = base64_encode(std::string_view(
+                    reinterpret_cast<const char *>(embedding.data()), embedding.size() * sizeof(float)));
+    } else {
+        data["embedding"] = embedding;
+    }
+
+    nlohmann::json resp;
+    resp["object"] = "list";
+    resp["data"].push_back(std::move(data));
+    resp["model"] = "text-embedding-3-large";
+    resp["usage"] = {{"prompt_tokens", 8}, {"total_tokens", 8}};
+
+    return resp.dump();
+}
+
+template <typename Func>
+double run(std::size_t iterations, Func &&func) {
+    std::size_t cnt = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t idx = 0; idx != iterations; ++idx) {
+        cnt += func().size();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (cnt == 0) {
+        std::fprintf(stderr, "nothing parsed\n");
+    }
+
+    return elapsed.count() * 1e6 / iterations;
+}
+
+}
+
+int main(int argc, char **argv) {
+    std::size_t dim = argc > 1 ? std::stoul(argv[1]) : 3072;
+    std::size_t iterations = argc > 2 ? std::stoul(argv[2]) : 1000;
+    // libcurl delivers at most 16KB per write callback by default.
+    std::size_t chunk_size = argc > 3 ? std::stoul(argv[3]) : 16 * 1024;
+
+    auto resp = make_response(dim, false);
+    auto base64_resp = make_response(dim, true);
+
+    auto dom_us = run(iterations, [&resp]() {
+            auto ans = nlohmann::json::parse(resp);
+            return ans["data"][0]["embedding"].get<Vector>();
+        });
+
+    auto parse = [dim, chunk_size](const std::string &body) {
+        EmbeddingResponseParser parser(dim);
+        for (std::size_t pos = 0; pos < body.size(); pos += chunk_size) {
+            parser.feed(std::string_view(body).substr(pos, chunk_size));
+        }
+        return parser.embedding();
+    };
+
+    auto stream_us = run(iterations, [&resp, &parse]() { return parse(resp); });
+
+    auto base64_us = run(iterations, [&base64_resp, &parse]() { return parse(base64_resp); });
+
+    std::printf("dim: %zu, response bytes: %zu (float), %zu (base64), chunk size: %zu\n",
+            dim, resp.size(), base64_resp.size(), chunk_size);
+    std::printf("%16s %16s\n", "parser", "us/response");
+    std::printf("%16s %16.2f\n", "dom", dom_us);
+    std::printf("%16s %16.2f\n", "stream", stream_us);
+    std::printf("%16s %16.2f\n", "stream-base64", base64_us);
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+// Measure tokens/sec of the BPE tokenizer.
+// Usage: redis-llm-tokenizer-benchmark vocab-file [text-file] [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "sw/redis-llm/tokenizer.h"
+
+namespace {
+
+std::string load_text(const char *path) {
+    if (path == nullptr) {
+        std::string text;
+        for (auto idx = 0; idx != 1000; ++idx) {
+            text += "redis-llm is a Redis module that integrates LLM (Large Language Model) with Redis. "
+                "It's 2023, and you can build chat bots, search engines over private data, "
+                "and much more with only 3 Redis commands!\n\n";
+        }
+        return text;
+    }
+
+    std::ifstream file(path);
+    std::stringstream buf;
+    buf << file.rdbuf();
+
+    return buf.str();
+}
+
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s vocab-file [text-file] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    sw::redis::llm::Tokenizer tokenizer(argv[1]);
+    auto text = load_text(argc > 2 ? argv[2] : nullptr);
+    std::size_t iterations = argc > 3 ? std::stoul(argv[3]) : 10;
+
+    std::size_t tokens = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t idx = 0; idx != iterations; ++idx) {
+        tokens += tokenizer.count(text);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::printf("vocab size: %zu, text bytes: %zu, tokens: %zu\n",
+            tokenizer.vocab_size(), text.size(), tokens / iterations);
+    std::printf("%16s %16s\n", "tokens/sec", "MB/sec");
+    std::printf("%16.0f %16.2f\n", tokens / elapsed.count(),
+            text.size() * iterations / elapsed.count() / 1024 / 1024);
+
+    return 0;
+}
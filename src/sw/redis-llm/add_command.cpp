@@ -15,8 +15,11 @@
  *************************************************************************/
 
 #include "sw/redis-llm/add_command.h"
+#include "sw/redis-llm/cancel.h"
 #include "sw/redis-llm/module_api.h"
 #include "sw/redis-llm/redis_llm.h"
+#include "sw/redis-llm/slowlog.h"
+#include "sw/redis-llm/stats.h"
 #include "sw/redis-llm/utils.h"
 
 namespace sw::redis::llm {
@@ -29,9 +32,25 @@ void AddCommand::_run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) c
         _blocking_add(ctx, args);
     } else {
         // No need to do embedding, so no need to block the client.
-        auto id = _add(ctx, args);
+        LatencyTimer timer(Latency::CMD_ADD);
+
+        if (args.profile) {
+            Profile profile;
+            uint64_t id = 0;
+            {
+                ProfileScope scope(&profile);
+                id = _add(ctx, args);
+            }
 
-        RedisModule_ReplyWithLongLong(ctx, id);
+            RedisModule_ReplyWithArray(ctx, 2);
+            RedisModule_ReplyWithLongLong(ctx, id);
+            profile.record_since("total", args.start);
+            profile.reply(ctx);
+        } else {
+            auto id = _add(ctx, args);
+
+            RedisModule_ReplyWithLongLong(ctx, id);
+        }
 
         RedisModule_ReplicateVerbatim(ctx);
     }
@@ -55,10 +74,15 @@ void AddCommand::_blocking_add(RedisModuleCtx *ctx, const Args &args) const {
     auto llm_model = std::static_pointer_cast<LlmModel>(model->shared_from_this());
     auto *blocked_client = RedisModule_BlockClient(ctx, _reply_func, _timeout_func,
             _free_func, args.timeout.count());
+    auto &registry = CancelRegistry::instance();
+    auto token = registry.watch(blocked_client);
 
     try {
-        llm.worker_pool().enqueue(&AddCommand::_async_add, this, blocked_client, args, vector_store, llm_model);
+        llm.worker_pool().enqueue(_blocking_task_options(args.start, args.timeout, token),
+                &AddCommand::_async_add, this, blocked_client,
+                args, vector_store, llm_model, token);
     } catch (const Error &err) {
+        registry.unwatch(blocked_client);
         RedisModule_AbortBlock(blocked_client);
 
         api::reply_with_error(ctx, err);
@@ -66,28 +90,48 @@ void AddCommand::_blocking_add(RedisModuleCtx *ctx, const Args &args) const {
 }
 
 void AddCommand::_async_add(RedisModuleBlockedClient *blocked_client,
-        const Args &args, const VectorStoreSPtr &store, const LlmModelSPtr &model) const {
-    assert(blocked_client != nullptr && args.embedding.empty() && store && model);
+        const Args &args, const VectorStoreSPtr &store, const LlmModelSPtr &model,
+        const CancelTokenSPtr &token) const {
+    assert(blocked_client != nullptr && args.embedding.empty() && store && model && token);
 
     auto result = std::make_unique<AsyncResult>();
+    result->start = args.start;
+    if (args.profile) {
+        result->profile = std::make_unique<Profile>();
+        result->profile->record_since("queue", args.start);
+    }
+
+    ProfileScope scope(result->profile.get());
+    SlowLogScope slowlog_scope(args.origin);
+    CancelScope cancel_scope(token.get());
     try {
+        // Client timed out or disconnected while the task was queued.
+        token->check();
+
         auto embedding = model->embedding(args.data, store->llm().params);
 
+        // Client has been told nothing is added, so do not add it behind its back.
+        token->check();
+
         if (args.id) {
             store->add(*args.id, args.data, embedding);
             result->id = *args.id;
-            result->auto_gen_id = false;
         } else {
             result->id = store->add(args.data, embedding);
         }
 
         result->key = args.key_name;
-        result->embedding = util::dump_embedding(embedding);
-        result->data = args.data;
+        util::append_batch_item(result->batch, result->id, args.data, embedding);
+    } catch (const CancelledError &) {
+        Stats::instance().incr(Counter::TASKS_CANCELLED);
+        result->err = std::current_exception();
     } catch (const Error &) {
         result->err = std::current_exception();
     }
 
+    CancelRegistry::instance().unwatch(blocked_client);
+
+    result->unblock_time = std::chrono::steady_clock::now();
     RedisModule_UnblockClient(blocked_client, result.release());
 }
 
@@ -118,6 +162,7 @@ AddCommand::Args AddCommand::_parse_args(RedisModuleString **argv, int argc) con
 
     Args args;
     args.key_name = argv[1];
+    args.origin = SlowLog::origin("LLM.ADD", args.key_name);
 
     auto idx = 2;
     while (idx < argc) {
@@ -148,6 +193,8 @@ AddCommand::Args AddCommand::_parse_args(RedisModuleString **argv, int argc) con
             } catch (const std::exception &e) {
                 throw Error(std::string("timeout should be a number: ") + e.what());
             }
+        } else if (util::str_case_equal(opt, "--PROFILE")) {
+            args.profile = true;
         } else {
             break;
         }
@@ -168,6 +215,13 @@ int AddCommand::_reply_func(RedisModuleCtx *ctx, RedisModuleString ** /*argv*/,
     auto *res = static_cast<AsyncResult *>(RedisModule_GetBlockedClientPrivateData(ctx));
     assert(res != nullptr);
 
+    LatencyTimer timer(Latency::REPLY);
+
+    auto &profile = res->profile;
+    if (profile) {
+        profile->begin_reply(ctx, res->unblock_time);
+    }
+
     if (res->err) {
         try {
             std::rethrow_exception(res->err);
@@ -177,25 +231,24 @@ int AddCommand::_reply_func(RedisModuleCtx *ctx, RedisModuleString ** /*argv*/,
     } else {
         RedisModule_ReplyWithLongLong(ctx, res->id);
 
-        if (res->auto_gen_id) {
-            RedisModule_Replicate(ctx, "LLM.ADD", "scbb",
-                    res->key,
-                    "--EMBEDDING", res->embedding.data(), res->embedding.size(),
-                    res->data.data(), res->data.size());
-        } else {
-            auto id_str = std::to_string(res->id);
-            RedisModule_Replicate(ctx, "LLM.ADD", "scbcbb",
-                    res->key,
-                    "--ID", id_str.data(), id_str.size(),
-                    "--EMBEDDING", res->embedding.data(), res->embedding.size(),
-                    res->data.data(), res->data.size());
-        }
+        // Replicate with full precision binary embedding.
+        RedisModule_Replicate(ctx, "LLM.MADD", "sb",
+                res->key, res->batch.data(), res->batch.size());
+    }
+
+    Stats::instance().record_since(Latency::CMD_ADD, res->start);
+
+    if (profile) {
+        profile->end_reply(ctx, res->start);
     }
 
     return REDISMODULE_OK;
 }
 
 int AddCommand::_timeout_func(RedisModuleCtx *ctx, RedisModuleString ** /*argv*/, int /*argc*/) {
+    // Client gets nothing from the task any more, so give it up.
+    CancelRegistry::instance().cancel(ctx);
+
     return RedisModule_ReplyWithNull(ctx);
 }
 
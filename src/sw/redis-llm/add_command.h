@@ -19,15 +19,19 @@
 
 #include <chrono>
 #include <exception>
+#include <memory>
+#include <string>
+#include "sw/redis-llm/cancel.h"
 #include "sw/redis-llm/command.h"
 #include "sw/redis-llm/llm_model.h"
 #include "sw/redis-llm/module_api.h"
+#include "sw/redis-llm/profile.h"
 #include "sw/redis-llm/vector_store.h"
 #include "sw/redis-llm/utils.h"
 
 namespace sw::redis::llm {
 
-// LLM.ADD key [--ID id] [--EMBEDDING xxx] [--TIMEOUT in-milliseconds] data
+// LLM.ADD key [--ID id] [--EMBEDDING xxx] [--TIMEOUT in-milliseconds] [--PROFILE] data
 // This command works with VECTOR STORE
 class AddCommand : public Command {
 private:
@@ -36,6 +40,10 @@ private:
     struct Args {
         RedisModuleString *key_name = nullptr;
 
+        // Originating command for slow log. It's copied, since key_name might be
+        // freed while the task is running, e.g. client times out or disconnects.
+        std::string origin;
+
         std::optional<uint64_t> id;
 
         std::string_view data;
@@ -43,16 +51,30 @@ private:
         Vector embedding;
 
         std::chrono::milliseconds timeout{0};
+
+        bool profile = false;
+
+        // Time when the command is received.
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     };
 
     struct AsyncResult {
         RedisModuleString *key = nullptr;
         uint64_t id = 0;
-        bool auto_gen_id = true;
-        std::string embedding;
-        std::string_view data;
+
+        // Added item encoded with util::append_batch_item, for replication.
+        std::string batch;
 
         std::exception_ptr err;
+
+        // Time when the command is received.
+        std::chrono::steady_clock::time_point start;
+
+        // Time when the worker unblocks the client.
+        std::chrono::steady_clock::time_point unblock_time;
+
+        // Not null, if --PROFILE is specified.
+        std::unique_ptr<Profile> profile;
     };
 
     Args _parse_args(RedisModuleString **argv, int argc) const;
@@ -65,7 +87,7 @@ private:
 
     void _async_add(RedisModuleBlockedClient *blocked_client,
             const Args &args, const VectorStoreSPtr &store,
-            const LlmModelSPtr &model) const;
+            const LlmModelSPtr &model, const CancelTokenSPtr &token) const;
 
     static int _reply_func(RedisModuleCtx *ctx, RedisModuleString **argv, int argc);
 
@@ -27,6 +27,19 @@ Application::Application(const std::string &type,
         const LlmInfo &llm, const nlohmann::json &conf) :
     _type(type), _llm(llm), _conf(conf) {}
 
+RedisModuleCtx* Application::_thread_safe_context(RedisModuleBlockedClient *blocked_client,
+        const nlohmann::json &context) {
+    auto *ctx = RedisModule_GetThreadSafeContext(blocked_client);
+    if (blocked_client == nullptr && context.is_object()) {
+        auto iter = context.find("db");
+        if (iter != context.end()) {
+            RedisModule_SelectDb(ctx, iter->get<int>());
+        }
+    }
+
+    return ctx;
+}
+
 ApplicationFactory::ApplicationFactory() {
     _register("app", std::make_unique<ApplicationCreatorTpl<SimpleApplication>>());
     _register("search", std::make_unique<ApplicationCreatorTpl<SearchApplication>>());
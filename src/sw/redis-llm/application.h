@@ -57,6 +57,12 @@ public:
         return _conf;
     }
 
+protected:
+    // Thread safe context to access keys from a worker thread. If there's no blocked client,
+    // i.e. LLM.RUN with --ASYNC option, select the db of the job, i.e. context["db"].
+    static RedisModuleCtx* _thread_safe_context(RedisModuleBlockedClient *blocked_client,
+            const nlohmann::json &context);
+
 private:
     std::string _type;
 
@@ -16,6 +16,7 @@
 
 #include "sw/redis-llm/azure_openai.h"
 #include "sw/redis-llm/errors.h"
+#include "sw/redis-llm/stats.h"
 #include "sw/redis-llm/utils.h"
 
 namespace sw::redis::llm {
@@ -23,29 +24,22 @@ namespace sw::redis::llm {
 AzureOpenAi::AzureOpenAi(const nlohmann::json &conf) :
     LlmModel("azure_openai", conf),
     _opts(_parse_options(conf)),
-    _client_pool(_opts.http_opts, _opts.http_pool_opts) {}
+    _load_balancer(_opts.routing, _opts.endpoints),
+    _embedding_batcher(_opts.embedding_batch,
+            [this](const std::vector<std::string_view> &inputs) { return _embeddings(inputs); }) {}
 
 std::string AzureOpenAi::predict(const std::string_view &input, const nlohmann::json &params) {
+    LatencyTimer timer(Latency::PREDICT);
+
     try {
         // Set model and other parameters.
         auto req = _opts.chat;
         req["messages"] = _construct_msg(input);
 
-        auto path = "/openai/deployments/" + _opts.chat_deployment_id +
-            "/chat/completions?api-version=" + _opts.api_version;
-        auto ans = _query(path, req);
-
-        auto &choices = ans["choices"];
-        if (!choices.is_array() || choices.empty()) {
-            throw Error("invalid chat choices");
-        }
-
-        auto &content = choices[0]["message"]["content"];
-        if (!content.is_string()) {
-            throw Error("invalid chat choices");
-        }
+        ChatResponseParser parser;
+        _query([this](std::size_t endpoint) { return _opts.paths[endpoint].chat; }, req, parser);
 
-        return content.get<std::string>();
+        return parser.content();
     } catch (const std::exception &e) {
         throw Error(std::string("failed to predict with openai: ") + e.what());
     }
@@ -57,26 +51,17 @@ std::string AzureOpenAi::chat(const std::string_view &input,
         const std::string &system_msg,
         const nlohmann::json &recent_history,
         const nlohmann::json &params) {
+    LatencyTimer timer(Latency::PREDICT);
+
     try {
         // Set model and other parameters.
         auto req = _opts.chat;
         req["messages"] = _construct_msg(input, system_msg, recent_history);
 
-        auto path = "/openai/deployments/" + _opts.chat_deployment_id +
-            "/chat/completions?api-version=" + _opts.api_version;
-        auto ans = _query(path, req);
-
-        auto &choices = ans["choices"];
-        if (!choices.is_array() || choices.empty()) {
-            throw Error("invalid chat choices");
-        }
-
-        auto &content = choices[0]["message"]["content"];
-        if (!content.is_string()) {
-            throw Error("invalid chat choices");
-        }
+        ChatResponseParser parser;
+        _query([this](std::size_t endpoint) { return _opts.paths[endpoint].chat; }, req, parser);
 
-        return content.get<std::string>();
+        return parser.content();
     } catch (const std::exception &e) {
         throw Error(std::string("failed to predict: ") + e.what());
     }
@@ -85,25 +70,23 @@ std::string AzureOpenAi::chat(const std::string_view &input,
 }
 
 Vector AzureOpenAi::embedding(const std::string_view &input, const nlohmann::json &params) {
+    LatencyTimer timer(Latency::EMBEDDING);
+
     try {
+        if (_embedding_batcher.enabled()) {
+            return _embedding_batcher.embedding(input);
+        }
+
         auto req = _opts.embedding;
         req["input"] = input;
 
-        auto path = "/openai/deployments/" + _opts.embedding_deployment_id +
-            "/embeddings?api-version=" + _opts.api_version;
-        auto ans = _query(path, req);
-
-        auto &data = ans["data"];
-        if (!data.is_array() || data.empty()) {
-            throw Error("invalid embedding response");
-        }
+        EmbeddingResponseParser parser(_embedding_dim);
+        _query([this](std::size_t endpoint) { return _opts.paths[endpoint].embedding; }, req, parser);
 
-        auto &embedding = data[0]["embedding"];
-        if (!embedding.is_array()) {
-            throw Error("invalid embedding response");
-        }
+        auto embedding = parser.embedding();
+        _embedding_dim = embedding.size();
 
-        return embedding.get<Vector>();
+        return embedding;
     } catch (const std::exception &e) {
         throw Error(std::string("failed to request embedding: ") + e.what());
     }
@@ -112,6 +95,19 @@ Vector AzureOpenAi::embedding(const std::string_view &input, const nlohmann::jso
     return {};
 }
 
+std::vector<Vector> AzureOpenAi::_embeddings(const std::vector<std::string_view> &inputs) {
+    auto req = _opts.embedding;
+    req["input"] = inputs;
+
+    EmbeddingResponseParser parser(_embedding_dim, inputs.size());
+    _query([this](std::size_t endpoint) { return _opts.paths[endpoint].embedding; }, req, parser);
+
+    auto embeddings = parser.embeddings();
+    _embedding_dim = embeddings.front().size();
+
+    return embeddings;
+}
+
 nlohmann::json AzureOpenAi::_construct_msg(const std::string_view &input,
         std::string system_info,
         nlohmann::json recent_history) const {
@@ -136,31 +132,42 @@ nlohmann::json AzureOpenAi::_construct_msg(const std::string_view &input,
     return msgs;
 }
 
-nlohmann::json AzureOpenAi::_query(const std::string &path, const nlohmann::json &req) {
-    SafeClient cli(_client_pool);
-
-    auto headers = std::unordered_multimap<std::string, std::string>{{"api-key", _opts.api_key}};
-    auto output = cli.client().post(path, headers, req.dump());
-
-    return nlohmann::json::parse(output);
+void AzureOpenAi::_query(const LoadBalancer::PathFunc &path,
+        const nlohmann::json &req, JsonStreamParser &parser) {
+    _load_balancer.post(path, req.dump(),
+            [&parser](const std::string_view &data) { parser.feed(data); });
 }
 
 AzureOpenAi::Options AzureOpenAi::_parse_options(const nlohmann::json &conf) const {
     Options opts;
     try {
         // {"api_key": "", "resource_name" : "", "chat_deployment_id":"", "embedding_deployment_id":"", "api_version":"", "chat": {}, "embedding": {}, "http":{"socket_timeout":"5s","connect_timeout":"5s", "enable_certificate_verification":false, "proxy_host" :"", "proxy_port":0, "pool" : {"size":3, "wait_timeout":"0s", "connection_lifetime":"0s"}}}
-        opts.api_key = conf.at("api_key").get<std::string>();
-        opts.resource_name = conf.at("resource_name").get<std::string>();
-        opts.chat_deployment_id = conf.at("chat_deployment_id").get<std::string>();
-        opts.embedding_deployment_id = conf.at("embedding_deployment_id").get<std::string>();
-        opts.api_version = conf.at("api_version").get<std::string>();
+        // These fields can also be specified by each endpoint.
+        opts.api_key = conf.value<std::string>("api_key", "");
+        opts.resource_name = conf.value<std::string>("resource_name", "");
+        opts.chat_deployment_id = conf.value<std::string>("chat_deployment_id", "");
+        opts.embedding_deployment_id = conf.value<std::string>("embedding_deployment_id", "");
+        opts.api_version = conf.value<std::string>("api_version", "");
 
         opts.chat = conf.value<nlohmann::json>("chat", nlohmann::json{});
         opts.embedding = conf.value<nlohmann::json>("embedding", nlohmann::json{});
+        if (opts.embedding.find("encoding_format") == opts.embedding.end()) {
+            opts.embedding["encoding_format"] = "base64";
+        }
 
         std::tie(opts.http_opts, opts.http_pool_opts) = _parse_http_options(conf);
 
-        opts.http_opts.uri = "https://" + opts.resource_name + ".openai.azure.com";
+        auto iter = conf.find("embedding_batch");
+        if (iter != conf.end()) {
+            opts.embedding_batch = EmbeddingBatchOptions(iter.value());
+        }
+
+        _parse_endpoints(conf, opts);
+
+        iter = conf.find("routing");
+        if (iter != conf.end()) {
+            opts.routing = LoadBalancerOptions(iter.value());
+        }
     } catch (const nlohmann::json::exception &e) {
         throw Error(std::string("failed to parse openai options: ") + e.what() + ":" + conf.dump());
     }
@@ -168,6 +175,38 @@ AzureOpenAi::Options AzureOpenAi::_parse_options(const nlohmann::json &conf) con
     return opts;
 }
 
+void AzureOpenAi::_parse_endpoints(const nlohmann::json &conf, Options &opts) const {
+    // {"endpoints": [{"api_key": "", "resource_name": "", "chat_deployment_id": "", "embedding_deployment_id": "", "api_version": ""}]}
+    auto endpoints_conf = conf.value<nlohmann::json>("endpoints", nlohmann::json::array({nlohmann::json::object()}));
+    for (const auto &endpoint_conf : endpoints_conf) {
+        auto field = [&endpoint_conf](const std::string &name, const std::string &default_value) {
+            auto value = endpoint_conf.value<std::string>(name, default_value);
+            if (value.empty()) {
+                throw Error(name + " is required");
+            }
+
+            return value;
+        };
+
+        auto resource_name = field("resource_name", opts.resource_name);
+        auto api_version = field("api_version", opts.api_version);
+
+        Options::Paths paths;
+        paths.chat = "/openai/deployments/" + field("chat_deployment_id", opts.chat_deployment_id) +
+            "/chat/completions?api-version=" + api_version;
+        paths.embedding = "/openai/deployments/" + field("embedding_deployment_id", opts.embedding_deployment_id) +
+            "/embeddings?api-version=" + api_version;
+        opts.paths.push_back(std::move(paths));
+
+        LoadBalancer::EndpointOptions endpoint;
+        endpoint.http_opts = opts.http_opts;
+        endpoint.http_opts.uri = "https://" + resource_name + ".openai.azure.com";
+        endpoint.pool_opts = opts.http_pool_opts;
+        endpoint.headers.emplace("api-key", field("api_key", opts.api_key));
+        opts.endpoints.push_back(std::move(endpoint));
+    }
+}
+
 auto AzureOpenAi::_parse_http_options(const nlohmann::json &conf) const
     -> std::pair<HttpClientOptions, HttpClientPoolOptions> {
     auto iter = conf.find("http");
@@ -17,9 +17,13 @@
 #ifndef SEWENEW_REDIS_LLM_AZURE_OPENAI_H
 #define SEWENEW_REDIS_LLM_AZURE_OPENAI_H
 
+#include <atomic>
 #include "nlohmann/json.hpp"
+#include "sw/redis-llm/embedding_batcher.h"
 #include "sw/redis-llm/http_client.h"
 #include "sw/redis-llm/llm_model.h"
+#include "sw/redis-llm/load_balancer.h"
+#include "sw/redis-llm/response_parser.h"
 
 namespace sw::redis::llm {
 
@@ -57,6 +61,23 @@ private:
         HttpClientOptions http_opts;
 
         HttpClientPoolOptions http_pool_opts;
+
+        EmbeddingBatchOptions embedding_batch;
+
+        // Endpoints with their own resource, API key and deployments. If not specified,
+        // there's only one endpoint built from the options above.
+        std::vector<LoadBalancer::EndpointOptions> endpoints;
+
+        struct Paths {
+            std::string chat;
+
+            std::string embedding;
+        };
+
+        // Request paths of each endpoint, which depend on its deployments.
+        std::vector<Paths> paths;
+
+        LoadBalancerOptions routing;
     };
 
     Options _parse_options(const nlohmann::json &conf) const;
@@ -68,11 +89,22 @@ private:
             std::string system_msg = "",
             nlohmann::json recent_history = {}) const;
 
-    nlohmann::json _query(const std::string &path, const nlohmann::json &input);
+    // Create embeddings of multiple inputs with a single request.
+    std::vector<Vector> _embeddings(const std::vector<std::string_view> &inputs);
+
+    // Post request, and parse the response while receiving it.
+    void _query(const LoadBalancer::PathFunc &path, const nlohmann::json &input, JsonStreamParser &parser);
+
+    void _parse_endpoints(const nlohmann::json &conf, Options &opts) const;
 
     Options _opts;
 
-    HttpClientPool _client_pool;
+    LoadBalancer _load_balancer;
+
+    // Dimension of the last embedding, used to reserve space for the next one.
+    std::atomic<std::size_t> _embedding_dim{0};
+
+    EmbeddingBatcher _embedding_batcher;
 };
 
 }
@@ -0,0 +1,78 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/cancel.h"
+#include <cassert>
+#include "sw/redis-llm/errors.h"
+
+namespace sw::redis::llm {
+
+thread_local CancelToken* CancelToken::_current = nullptr;
+
+void CancelToken::check() const {
+    if (cancelled()) {
+        throw CancelledError();
+    }
+}
+
+CancelRegistry& CancelRegistry::instance() {
+    static CancelRegistry registry;
+
+    return registry;
+}
+
+CancelTokenSPtr CancelRegistry::watch(RedisModuleBlockedClient *blocked_client) {
+    assert(blocked_client != nullptr);
+
+    auto token = std::make_shared<CancelToken>();
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+
+        _tokens[blocked_client] = token;
+    }
+
+    RedisModule_SetDisconnectCallback(blocked_client, _on_disconnect);
+
+    return token;
+}
+
+void CancelRegistry::unwatch(RedisModuleBlockedClient *blocked_client) {
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    _tokens.erase(blocked_client);
+}
+
+void CancelRegistry::cancel(RedisModuleBlockedClient *blocked_client) {
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    auto iter = _tokens.find(blocked_client);
+    if (iter != _tokens.end()) {
+        iter->second->cancel();
+    }
+}
+
+void CancelRegistry::cancel(RedisModuleCtx *ctx) {
+    auto *blocked_client = RedisModule_GetBlockedClientHandle(ctx);
+    if (blocked_client != nullptr) {
+        cancel(blocked_client);
+    }
+}
+
+void CancelRegistry::_on_disconnect(RedisModuleCtx * /*ctx*/, RedisModuleBlockedClient *blocked_client) {
+    instance().cancel(blocked_client);
+}
+
+}
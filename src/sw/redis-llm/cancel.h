@@ -0,0 +1,115 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SEWENEW_REDIS_LLM_CANCEL_H
+#define SEWENEW_REDIS_LLM_CANCEL_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "sw/redis-llm/redismodule.h"
+
+namespace sw::redis::llm {
+
+// Cancellation flag of a request, which is set once its client times out or disconnects.
+// Work still in the queue is dropped, and outbound calls in flight are aborted.
+class CancelToken {
+public:
+    // Token of the request being processed by the current thread, or nullptr if the
+    // request cannot be cancelled.
+    static CancelToken* current() {
+        return _current;
+    }
+
+    void cancel() {
+        _cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    bool cancelled() const {
+        return _cancelled.load(std::memory_order_relaxed);
+    }
+
+    // Throw CancelledError, if it has been cancelled.
+    void check() const;
+
+private:
+    friend class CancelScope;
+
+    static thread_local CancelToken *_current;
+
+    std::atomic<bool> _cancelled{false};
+};
+
+using CancelTokenSPtr = std::shared_ptr<CancelToken>;
+
+// Make *token* the current token of this thread for the enclosing scope.
+// If *token* is nullptr, work in the scope cannot be cancelled.
+class CancelScope {
+public:
+    explicit CancelScope(CancelToken *token) : _prev(CancelToken::_current) {
+        CancelToken::_current = token;
+    }
+
+    CancelScope(const CancelScope &) = delete;
+    CancelScope& operator=(const CancelScope &) = delete;
+
+    ~CancelScope() {
+        CancelToken::_current = _prev;
+    }
+
+private:
+    CancelToken *_prev = nullptr;
+};
+
+// Tokens of blocked clients. Timeout and disconnect callbacks only know the blocked client,
+// so they look up the token here.
+class CancelRegistry {
+public:
+    static CancelRegistry& instance();
+
+    CancelRegistry(const CancelRegistry &) = delete;
+    CancelRegistry& operator=(const CancelRegistry &) = delete;
+
+    CancelRegistry(CancelRegistry &&) = delete;
+    CancelRegistry& operator=(CancelRegistry &&) = delete;
+
+    // Create a token for *blocked_client*, and cancel it if the client disconnects.
+    // Should be called in the main thread right after blocking the client.
+    CancelTokenSPtr watch(RedisModuleBlockedClient *blocked_client);
+
+    // Should be called before unblocking or aborting the block of *blocked_client*.
+    void unwatch(RedisModuleBlockedClient *blocked_client);
+
+    // Cancel the token of *blocked_client*. No-op if it's not watched.
+    void cancel(RedisModuleBlockedClient *blocked_client);
+
+    // Cancel the token of the blocked client of *ctx*. Called by timeout callbacks.
+    void cancel(RedisModuleCtx *ctx);
+
+private:
+    CancelRegistry() = default;
+
+    static void _on_disconnect(RedisModuleCtx *ctx, RedisModuleBlockedClient *blocked_client);
+
+    std::unordered_map<RedisModuleBlockedClient *, CancelTokenSPtr> _tokens;
+
+    std::mutex _mtx;
+};
+
+}
+
+#endif // end SEWENEW_REDIS_LLM_CANCEL_H
@@ -15,6 +15,11 @@
  *************************************************************************/
 
 #include "sw/redis-llm/chat_application.h"
+#include <algorithm>
+#include <tuple>
+#include <vector>
+#include "sw/redis-llm/cancel.h"
+#include "sw/redis-llm/profile.h"
 #include "sw/redis-llm/redis_llm.h"
 
 namespace sw::redis::llm {
@@ -23,8 +28,10 @@ ChatApplication::ChatApplication(const LlmInfo &llm,
         const nlohmann::json &conf) :
     Application("chat", llm, conf),
     _system_prompt(conf.value<std::string>("prompt", _default_prompt)),
-    _chat_history(_create_chat_history(conf.value<nlohmann::json>("history", {}))),
-    _vector_store(conf.at("vector-store").get<std::string>()) {}
+    _history_opts(conf.value<nlohmann::json>("history", {})),
+    _vector_store(conf.at("vector-store").get<std::string>()) {
+    _history_opts.llm = llm;
+}
 
 std::string ChatApplication::run(RedisModuleBlockedClient *blocked_client, LlmModel &model, const nlohmann::json &context, const std::string_view &input, bool verbose) {
     /*
@@ -36,8 +43,11 @@ std::string ChatApplication::run(RedisModuleBlockedClient *blocked_client, LlmMo
     VectorStoreSPtr vector_store;
     LlmModelSPtr llm_model;
 
-    auto *ctx = RedisModule_GetThreadSafeContext(blocked_client);
-    RedisModule_ThreadSafeContextLock(ctx);
+    auto *ctx = _thread_safe_context(blocked_client, context);
+    {
+        ProfileTimer timer("lock");
+        RedisModule_ThreadSafeContextLock(ctx);
+    }
 
     try {
         auto &store = _get_vector_store(ctx, context);
@@ -53,61 +63,232 @@ std::string ChatApplication::run(RedisModuleBlockedClient *blocked_client, LlmMo
         throw;
     }
 
+    // Summaries should be replicated to the db of the app.
+    auto db = RedisModule_GetSelectedDb(ctx);
+
     RedisModule_ThreadSafeContextUnlock(ctx);
     RedisModule_FreeThreadSafeContext(ctx);
 
-    std::lock_guard<std::mutex> lock(_mtx);
+    std::string session_id;
+    if (context.is_object()) {
+        session_id = context.value<std::string>("session", "");
+    }
+
+    std::string reply;
+    while (true) {
+        auto session = _get_session(session_id);
+
+        std::lock_guard<std::mutex> lock(session->mtx);
+
+        if (session->evicted) {
+            // Removed before we got the lock, retry with a new one.
+            continue;
+        }
+
+        reply = _chat(session, model, llm_model, vector_store, db, input);
+
+        auto memory = session->history.memory_usage();
+        _memory += memory;
+        _memory -= session->memory;
+        session->memory = memory;
+
+        break;
+    }
+
+    _evict_sessions_if_needed();
 
-    auto [summary, recent_history] = _chat_history.history(*llm_model, *vector_store, input);
+    return reply;
+}
+
+std::string ChatApplication::_chat(const SessionSPtr &session, LlmModel &model,
+        const LlmModelSPtr &store_model, const VectorStoreSPtr &store,
+        int db, const std::string_view &input) {
+    auto &history = session->history;
 
-    nlohmann::json vars;
-    vars["history"] = summary;
-    auto system_msg = _system_prompt.render(vars);
+    auto [summary, recent_history] = history.history(*store_model, *store, input);
+
+    auto system_msg = _system_prompt.render(PromptVars{{"history", summary}});
 
     auto reply = model.chat(input, system_msg, recent_history, {});
 
-    auto user_res = _chat_history.add(*llm_model, *vector_store, "user", input);
-    auto assistant_res = _chat_history.add(*llm_model, *vector_store, "assistant", reply);
-    auto user_id = std::get<0>(user_res);
-    auto assistant_id = std::get<0>(assistant_res);
-    if (user_id > 0 || assistant_id > 0) {
-        auto *ctx = RedisModule_GetThreadSafeContext(blocked_client);
-        RedisModule_ThreadSafeContextLock(ctx);
+    if (Profile::current() != nullptr) {
+        std::vector<std::string_view> prompt = {system_msg, input};
+        for (const auto &msg : recent_history) {
+            auto iter = msg.find("content");
+            if (iter != msg.end() && iter->is_string()) {
+                prompt.push_back(iter->get_ref<const std::string &>());
+            }
+        }
+        Profile::add_tokens(prompt, reply);
+    }
+
+    auto user_msgs = history.add("user", input);
+    if (!user_msgs.empty()) {
+        _summarize_async(session, store_model, store, db, user_msgs);
+    }
+
+    auto assistant_msgs = history.add("assistant", reply);
+    if (!assistant_msgs.empty()) {
+        _summarize_async(session, store_model, store, db, assistant_msgs);
+    }
+
+    return reply;
+}
+
+void ChatApplication::_summarize_async(const SessionSPtr &session, const LlmModelSPtr &store_model,
+        const VectorStoreSPtr &store, int db, const std::vector<ChatHistory::Msg> &msgs) {
+    auto self = std::static_pointer_cast<ChatApplication>(shared_from_this());
+    try {
+        TaskOptions task_opts;
+        task_opts.priority = TaskPriority::BACKGROUND;
+        RedisLlm::instance().worker_pool().enqueue(task_opts,
+                [self, session, store_model, store, db, msgs]() {
+                    self->_summarize(session, *store_model, *store, db, msgs);
+                });
+    } catch (const Error &) {
+        // Worker pool is busy, do it synchronously. History is shared by the session,
+        // so it should not be cancelled by client of the current request.
+        CancelScope scope(nullptr);
+        _summarize(session, *store_model, *store, db, msgs);
+    }
+}
 
-        if (user_id > 0) {
-            auto [id, data, embedding] = user_res;
-            auto embedding_str = util::dump_embedding(embedding);
-            auto id_str = std::to_string(id);
-            RedisModule_Replicate(ctx, "LLM.ADD", "bcbcbb",
-                    _vector_store.data(), _vector_store.size(),
-                    "--ID", id_str.data(), id_str.size(),
-                    "--EMBEDDING", embedding_str.data(), embedding_str.size(),
-                    data.data(), data.size());
+void ChatApplication::_summarize(const SessionSPtr &session, LlmModel &store_model,
+        VectorStore &store, int db, const std::vector<ChatHistory::Msg> &msgs) {
+    std::string batch;
+    std::string err;
+    try {
+        auto [id, data, embedding] = session->history.summarize(store_model, store, msgs);
+        if (id == 0) {
+            return;
         }
 
-        if (assistant_id > 0) {
-            auto [id, data, embedding] = assistant_res;
-            auto embedding_str = util::dump_embedding(embedding);
-            auto id_str = std::to_string(id);
-            RedisModule_Replicate(ctx, "LLM.ADD", "bcbcbb",
-                    _vector_store.data(), _vector_store.size(),
-                    "--ID", id_str.data(), id_str.size(),
-                    "--EMBEDDING", embedding_str.data(), embedding_str.size(),
-                    data.data(), data.size());
+        // Replicate with full precision binary embedding.
+        util::append_batch_item(batch, id, data, embedding);
+    } catch (const std::exception &e) {
+        // Failed to summarize, e.g. LLM is unavailable. Discard these messages,
+        // since they are still kept as latest messages for a while.
+        err = e.what();
+    }
+
+    auto *ctx = RedisModule_GetThreadSafeContext(nullptr);
+    RedisModule_ThreadSafeContextLock(ctx);
+
+    if (err.empty()) {
+        RedisModule_SelectDb(ctx, db);
+
+        RedisModule_Replicate(ctx, "LLM.MADD", "bb",
+                _vector_store.data(), _vector_store.size(),
+                batch.data(), batch.size());
+    } else {
+        api::warning(ctx, "failed to summarize chat history of %s: %s",
+                _vector_store.c_str(), err.c_str());
+    }
+
+    RedisModule_ThreadSafeContextUnlock(ctx);
+    RedisModule_FreeThreadSafeContext(ctx);
+}
+
+ChatApplication::SessionSPtr ChatApplication::_get_session(const std::string &id) {
+    auto &shard = _shard(id);
+    auto now = _now();
+
+    std::lock_guard<std::mutex> lock(shard.mtx);
+
+    _purge_expired_sessions(shard, now);
+
+    auto iter = shard.sessions.find(id);
+    if (iter == shard.sessions.end()) {
+        iter = shard.sessions.emplace(id, std::make_shared<Session>(_history_opts, !id.empty())).first;
+    }
+
+    auto session = iter->second;
+    session->last_access = now;
+
+    return session;
+}
+
+void ChatApplication::_purge_expired_sessions(SessionShard &shard, int64_t now) {
+    if (_history_opts.session_ttl == 0) {
+        return;
+    }
+
+    // Scan the shard at most once per second.
+    if (now - shard.last_purge < 1000) {
+        return;
+    }
+
+    shard.last_purge = now;
+
+    auto ttl = static_cast<int64_t>(_history_opts.session_ttl) * 1000;
+    for (auto iter = shard.sessions.begin(); iter != shard.sessions.end(); ) {
+        if (_evictable(iter->first) && now - iter->second->last_access > ttl) {
+            auto cur = iter++;
+            _remove_session(shard, cur);
+        } else {
+            ++iter;
         }
+    }
+}
 
-        RedisModule_ThreadSafeContextUnlock(ctx);
-        RedisModule_FreeThreadSafeContext(ctx);
+void ChatApplication::_evict_sessions_if_needed() {
+    auto max_memory = _history_opts.max_session_memory;
+    if (max_memory == 0 || _memory <= max_memory) {
+        return;
     }
 
-    return reply;
+    std::unique_lock<std::mutex> evict_lock(_evict_mtx, std::try_to_lock);
+    if (!evict_lock.owns_lock()) {
+        // Some other thread is doing the eviction.
+        return;
+    }
+
+    // Evict the least recently used sessions.
+    std::vector<std::tuple<int64_t, std::size_t, std::string>> candidates;
+    for (std::size_t idx = 0; idx != _shards.size(); ++idx) {
+        auto &shard = _shards[idx];
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        for (const auto &[id, session] : shard.sessions) {
+            if (_evictable(id)) {
+                candidates.emplace_back(session->last_access.load(), idx, id);
+            }
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    for (const auto &[last_access, idx, id] : candidates) {
+        if (_memory <= max_memory) {
+            break;
+        }
+
+        auto &shard = _shards[idx];
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        auto iter = shard.sessions.find(id);
+        if (iter != shard.sessions.end() && iter->second->last_access == last_access) {
+            _remove_session(shard, iter);
+        }
+    }
 }
 
-ChatHistory ChatApplication::_create_chat_history(const nlohmann::json &conf) const {
-    ChatHistoryOptions opts(conf);
-    opts.llm = llm();
+bool ChatApplication::_remove_session(SessionShard &shard,
+        std::unordered_map<std::string, SessionSPtr>::iterator iter) {
+    auto &session = iter->second;
+
+    std::unique_lock<std::mutex> lock(session->mtx, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+
+    session->evicted = true;
+    _memory -= session->memory;
+    session->memory = 0;
+
+    lock.unlock();
+
+    shard.sessions.erase(iter);
 
-    return ChatHistory(opts);
+    return true;
 }
 
 VectorStore& ChatApplication::_get_vector_store(RedisModuleCtx *ctx, const nlohmann::json &context) {
@@ -17,8 +17,14 @@
 #ifndef SEWENEW_REDIS_LLM_CHAT_APPLICATION_H
 #define SEWENEW_REDIS_LLM_CHAT_APPLICATION_H
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "nlohmann/json.hpp"
 #include "sw/redis-llm/application.h"
 #include "sw/redis-llm/chat_history.h"
@@ -33,7 +39,74 @@ public:
     virtual std::string run(RedisModuleBlockedClient *blocked_client, LlmModel &llm, const nlohmann::json &context, const std::string_view &input, bool verbose) override;
 
 private:
-    ChatHistory _create_chat_history(const nlohmann::json &conf) const;
+    // Each session has its own conversation history. Runs on different sessions
+    // can be processed concurrently, while runs on the same session are serialized.
+    // Summaries of the default session are saved in the vector store, as they are
+    // persisted and replicated. Other sessions keep their summaries privately,
+    // so that they are not visible to each other.
+    struct Session {
+        Session(const ChatHistoryOptions &opts, bool private_summaries) :
+            history(opts, private_summaries) {}
+
+        // Protect history, memory and evicted.
+        std::mutex mtx;
+
+        ChatHistory history;
+
+        // Memory usage of history that has been counted into ChatApplication::_memory.
+        std::size_t memory = 0;
+
+        // Whether this session has been removed from the session map.
+        bool evicted = false;
+
+        // Milliseconds since epoch of steady clock.
+        std::atomic<int64_t> last_access{0};
+    };
+
+    using SessionSPtr = std::shared_ptr<Session>;
+
+    struct SessionShard {
+        std::mutex mtx;
+
+        std::unordered_map<std::string, SessionSPtr> sessions;
+
+        int64_t last_purge = 0;
+    };
+
+    std::string _chat(const SessionSPtr &session, LlmModel &model,
+            const LlmModelSPtr &store_model, const VectorStoreSPtr &store,
+            int db, const std::string_view &input);
+
+    // Summarize messages in a background thread, so that user does not wait on it.
+    // The summary is replicated to *db*, i.e. db of the app.
+    void _summarize_async(const SessionSPtr &session, const LlmModelSPtr &store_model,
+            const VectorStoreSPtr &store, int db, const std::vector<ChatHistory::Msg> &msgs);
+
+    void _summarize(const SessionSPtr &session, LlmModel &store_model,
+            VectorStore &store, int db, const std::vector<ChatHistory::Msg> &msgs);
+
+    SessionSPtr _get_session(const std::string &id);
+
+    void _purge_expired_sessions(SessionShard &shard, int64_t now);
+
+    void _evict_sessions_if_needed();
+
+    bool _evictable(const std::string &id) const {
+        return !id.empty() || _history_opts.evict_default_session;
+    }
+
+    // Remove session from shard. Return false, if session is in use.
+    bool _remove_session(SessionShard &shard,
+            std::unordered_map<std::string, SessionSPtr>::iterator iter);
+
+    SessionShard& _shard(const std::string &id) {
+        return _shards[std::hash<std::string>{}(id) % _shards.size()];
+    }
+
+    static int64_t _now() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
 
     VectorStore& _get_vector_store(RedisModuleCtx *ctx, const nlohmann::json &context);
 
@@ -43,11 +116,17 @@ private:
 {{history}}
 """)";
 
-    ChatHistory _chat_history;
+    ChatHistoryOptions _history_opts;
 
     std::string _vector_store;
 
-    std::mutex _mtx;
+    std::array<SessionShard, 64> _shards;
+
+    // Memory used by all sessions.
+    std::atomic<std::size_t> _memory{0};
+
+    // Only one thread does eviction at a time.
+    std::mutex _evict_mtx;
 };
 
 }
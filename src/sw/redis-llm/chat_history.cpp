@@ -15,6 +15,9 @@
  *************************************************************************/
 
 #include "sw/redis-llm/chat_history.h"
+#include <algorithm>
+#include <iterator>
+#include <limits>
 #include "sw/redis-llm/errors.h"
 #include "sw/redis-llm/redis_llm.h"
 
@@ -45,35 +48,73 @@ ChatHistoryOptions::ChatHistoryOptions(const nlohmann::json &conf) {
         msg_ctx_cnt = iter.value().get<uint32_t>();
     }
 
+    iter = conf.find("token_budget");
+    if (iter != conf.end()) {
+        token_budget = iter.value().get<uint32_t>();
+    }
+
     iter = conf.find("store_type");
     if (iter != conf.end()) {
         store_type = iter.value().get<std::string>();
     }
 
+    iter = conf.find("session_ttl");
+    if (iter != conf.end()) {
+        session_ttl = iter.value().get<uint32_t>();
+    }
+
+    iter = conf.find("max_session_memory");
+    if (iter != conf.end()) {
+        max_session_memory = iter.value().get<uint64_t>();
+    }
+
+    iter = conf.find("evict_default_session");
+    if (iter != conf.end()) {
+        evict_default_session = iter.value().get<bool>();
+    }
+
     iter = conf.find("store_params");
     if (iter != conf.end()) {
         store_params = iter.value().get<std::string>();
     }
 }
 
-ChatHistory::ChatHistory(const ChatHistoryOptions &opts) :
-    _opts(opts), _summary_prompt(_opts.summary_prompt) {}
+ChatHistory::ChatHistory(const ChatHistoryOptions &opts, bool private_summaries) :
+    _opts(opts), _summary_prompt(_opts.summary_prompt), _private_summaries(private_summaries) {}
 
-std::tuple<uint64_t, std::string, Vector> ChatHistory::add(LlmModel &model, VectorStore &store, const std::string_view &role, const std::string_view &message) {
+std::vector<ChatHistory::Msg> ChatHistory::add(const std::string_view &role, const std::string_view &message) {
     auto msg = Msg(role, message);
 
-    auto res = _summarize_if_needed(model, store, msg);
+    std::vector<Msg> msgs_to_be_summarize;
+    if (_opts.summary_cnt > 0) {
+        _msgs_to_be_summarize.push_back(msg);
+
+        if (_opts.token_budget > 0) {
+            _tokens_to_be_summarize += RedisLlm::instance().count_tokens(message);
+        }
+
+        if (_msgs_to_be_summarize.size() >= _opts.summary_cnt ||
+                (_opts.token_budget > 0 && _tokens_to_be_summarize >= _opts.token_budget)) {
+            msgs_to_be_summarize.swap(_msgs_to_be_summarize);
+            _tokens_to_be_summarize = 0;
+        }
+    }
 
     _latest_msgs.push_back(std::move(msg));
     while (_latest_msgs.size() > _opts.msg_ctx_cnt) {
         _latest_msgs.pop_front();
     }
 
-    return res;
+    return msgs_to_be_summarize;
 }
 
 std::pair<std::string, nlohmann::json> ChatHistory::history(LlmModel &model, VectorStore &store, const std::string_view &input) {
-    auto latest_msgs = _get_latest_msgs();
+    auto budget = std::numeric_limits<std::size_t>::max();
+    if (_opts.token_budget > 0) {
+        budget = _opts.token_budget;
+    }
+
+    auto latest_msgs = _get_latest_msgs(budget);
 
     /*
     nlohmann::json current_msg;
@@ -86,63 +127,125 @@ std::pair<std::string, nlohmann::json> ChatHistory::history(LlmModel &model, Vec
     if (_opts.summary_cnt > 0 && _opts.summary_ctx_cnt > 0) {
         // TODO: Use the latest N message as input to look up the vector store,
         // so that it can be more semantic.
-        summary = _get_history_summary(model, store, input, _opts.summary_ctx_cnt);
+        summary = _get_history_summary(model, store, input, _opts.summary_ctx_cnt, budget);
     }
 
     return std::make_pair(std::move(summary), std::move(latest_msgs));
 }
 
-std::string ChatHistory::_get_history_summary(LlmModel &model, VectorStore &store, const std::string_view &input, int k) {
+std::size_t ChatHistory::memory_usage() const {
+    auto usage = sizeof(ChatHistory) + _opts.summary_prompt.size();
+    for (const auto &[role, content] : _latest_msgs) {
+        usage += sizeof(Msg) + role.size() + content.size();
+    }
+
+    for (const auto &[role, content] : _msgs_to_be_summarize) {
+        usage += sizeof(Msg) + role.size() + content.size();
+    }
+
+    std::lock_guard<std::mutex> lock(_summary_mtx);
+    for (const auto &summary : _summaries) {
+        usage += sizeof(Summary) + summary.data.size() + summary.embedding.size() * sizeof(float);
+    }
+
+    return usage;
+}
+
+std::string ChatHistory::_get_history_summary(LlmModel &model, VectorStore &store, const std::string_view &input, int k, std::size_t budget) {
     auto embedding = model.embedding(input, _opts.llm.params);
-    auto neighbors = store.knn(embedding, k);
+
+    std::vector<std::string> neighbors;
+    if (_private_summaries) {
+        neighbors = _knn_private_summaries(embedding, k);
+    } else {
+        for (auto [id, dist] : store.knn(embedding, k)) {
+            auto val = store.data(id);
+            if (val) {
+                neighbors.push_back(std::move(*val));
+            }
+        }
+    }
+
     std::string res;
-    for (auto [id, dist] : neighbors) {
-        auto val = store.data(id);
-        if (!val) {
-            continue;
+    for (const auto &val : neighbors) {
+        // Neighbors are sorted by distance, stop at the first one that does not fit.
+        auto tokens = RedisLlm::instance().count_tokens(val);
+        if (tokens > budget) {
+            break;
         }
+        budget -= tokens;
 
         if (!res.empty()) {
             res += "\n";
         }
-        res += *val;
+        res += val;
     }
 
     return res;
 }
 
-nlohmann::json ChatHistory::_get_latest_msgs() {
-    nlohmann::json msgs;
-    for (const auto &[role, content] : _latest_msgs) {
-        nlohmann::json msg;
-        msg["role"] = role;
-        msg["content"] = content;
-        msgs.push_back(std::move(msg));
+std::vector<std::string> ChatHistory::_knn_private_summaries(const Vector &query, std::size_t k) const {
+    std::lock_guard<std::mutex> lock(_summary_mtx);
+
+    // A session has only a few summaries, so brute force search with L2 distance,
+    // which is also used by the vector stores.
+    std::vector<std::pair<float, const Summary *>> candidates;
+    candidates.reserve(_summaries.size());
+    for (const auto &summary : _summaries) {
+        if (summary.embedding.size() != query.size()) {
+            continue;
+        }
+
+        float dist = 0;
+        for (std::size_t idx = 0; idx != query.size(); ++idx) {
+            auto diff = query[idx] - summary.embedding[idx];
+            dist += diff * diff;
+        }
+        candidates.emplace_back(dist, &summary);
     }
 
-    return msgs;
-}
+    k = std::min(k, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end(),
+            [](const auto &lhs, const auto &rhs) { return lhs.first < rhs.first; });
 
-std::tuple<uint64_t, std::string, Vector> ChatHistory::_summarize_if_needed(LlmModel &model, VectorStore &store, const Msg &msg) {
-    if (_opts.summary_cnt == 0) {
-        // Not enabled.
-        return std::make_tuple(0, std::string(""), Vector{});
+    std::vector<std::string> res;
+    res.reserve(k);
+    for (std::size_t idx = 0; idx != k; ++idx) {
+        res.push_back(candidates[idx].second->data);
     }
 
-    _msgs_to_be_summarize.push_back(msg);
+    return res;
+}
 
-    // TODO: also check the token limit.
-    std::tuple<uint64_t, std::string, Vector> res;
-    if (_msgs_to_be_summarize.size() >= _opts.summary_cnt) {
-        res = _summarize(model, store, _msgs_to_be_summarize);
+nlohmann::json ChatHistory::_get_latest_msgs(std::size_t &budget) {
+    // Pick messages from the latest one, until the budget is used up.
+    auto &llm = RedisLlm::instance();
+    auto first = _latest_msgs.end();
+    while (first != _latest_msgs.begin()) {
+        auto prev = std::prev(first);
+
+        // Each message has a few tokens of overhead for role and delimiters.
+        auto tokens = llm.count_tokens(prev->second) + 4;
+        if (tokens > budget) {
+            break;
+        }
+        budget -= tokens;
+        first = prev;
+    }
 
-        _msgs_to_be_summarize.clear();
+    nlohmann::json msgs;
+    for (auto iter = first; iter != _latest_msgs.end(); ++iter) {
+        const auto &[role, content] = *iter;
+        nlohmann::json msg;
+        msg["role"] = role;
+        msg["content"] = content;
+        msgs.push_back(std::move(msg));
     }
 
-    return res;
+    return msgs;
 }
 
-std::tuple<uint64_t, std::string, Vector> ChatHistory::_summarize(LlmModel &model, VectorStore &store, const std::vector<Msg> &msgs) {
+std::tuple<uint64_t, std::string, Vector> ChatHistory::summarize(LlmModel &model, VectorStore &store, const std::vector<Msg> &msgs) {
     std::string request;
     try {
         nlohmann::json conversation;
@@ -154,10 +257,9 @@ std::tuple<uint64_t, std::string, Vector> ChatHistory::_summarize(LlmModel &mode
             conversation.push_back(std::move(msg));
         }
 
-        nlohmann::json vars;
-        vars["conversation"] = conversation.dump();
+        auto conversation_str = conversation.dump();
 
-        request = _summary_prompt.render(vars);
+        request = _summary_prompt.render(PromptVars{{"conversation", conversation_str}});
     } catch (const std::exception &e) {
         throw Error(std::string("failed to build summary request") + e.what());
     }
@@ -166,6 +268,13 @@ std::tuple<uint64_t, std::string, Vector> ChatHistory::_summarize(LlmModel &mode
 
     auto embedding = model.embedding(output, _opts.llm.params);
 
+    if (_private_summaries) {
+        std::lock_guard<std::mutex> lock(_summary_mtx);
+        _summaries.push_back(Summary{output, embedding});
+
+        return std::make_tuple(0, output, embedding);
+    }
+
     auto id = store.add(output, embedding);
 
     return std::make_tuple(id, output, embedding);
@@ -17,6 +17,7 @@
 #ifndef SEWENEW_REDIS_LLM_CHAT_HISTORY_H
 #define SEWENEW_REDIS_LLM_CHAT_HISTORY_H
 
+#include <mutex>
 #include <tuple>
 #include <string>
 #include <string_view>
@@ -50,41 +51,85 @@ Summary: )";
     // Use latest n messages as context.
     uint32_t msg_ctx_cnt = 10;
 
+    // Max number of tokens of history, i.e. latest messages and summaries, used as context.
+    // Latest messages take priority over summaries. Also summarize pending messages
+    // once they exceed this limit. 0 means no limit.
+    uint32_t token_budget = 0;
+
     std::string ai_role = "assistant";
 
     LlmInfo llm;
 
     std::string store_type = "hnsw";
 
+    // Sessions idle for more than n seconds are removed. 0 means never expire.
+    uint32_t session_ttl = 3600;
+
+    // Max memory in bytes used by all sessions of an application.
+    // Least recently used sessions are removed when exceeded. 0 means no limit.
+    uint64_t max_session_memory = 128 * 1024 * 1024;
+
+    // Whether the above expiration and eviction policies also apply to the default session,
+    // i.e. runs without session id.
+    bool evict_default_session = false;
+
     nlohmann::json store_params = nlohmann::json::object();
 };
 
 class ChatHistory {
 public:
-    explicit ChatHistory(const ChatHistoryOptions &opts);
+    using Msg = std::pair<std::string, std::string>;
 
-    std::tuple<uint64_t, std::string, Vector> add(LlmModel &model, VectorStore &store, const std::string_view &role, const std::string_view &message);
+    // If *private_summaries* is true, summaries are kept by this history, instead of
+    // being added to the vector store, which might be shared with other histories.
+    explicit ChatHistory(const ChatHistoryOptions &opts, bool private_summaries = false);
 
-    std::pair<std::string, nlohmann::json> history(LlmModel &model, VectorStore &store, const std::string_view &input);
+    // Add message to history. If it's time to do summary, return messages to be summarized,
+    // and caller should call `summarize` with these messages, e.g. in a background thread.
+    std::vector<Msg> add(const std::string_view &role, const std::string_view &message);
 
-private:
-    using Msg = std::pair<std::string, std::string>;
+    // Summarize messages, and add the summary to store. This method is thread-safe,
+    // and can be called concurrently with other methods. If summaries are private,
+    // the returned id is 0, since the summary is not added to store.
+    std::tuple<uint64_t, std::string, Vector> summarize(LlmModel &model, VectorStore &store, const std::vector<Msg> &msgs);
 
-    std::tuple<uint64_t, std::string, Vector> _summarize_if_needed(LlmModel &model, VectorStore &store, const Msg &msg);
+    std::pair<std::string, nlohmann::json> history(LlmModel &model, VectorStore &store, const std::string_view &input);
 
-    std::tuple<uint64_t, std::string, Vector> _summarize(LlmModel &model, VectorStore &store, const std::vector<Msg> &msgs);
+    // Approximate memory in bytes used by this history.
+    std::size_t memory_usage() const;
 
-    nlohmann::json _get_latest_msgs();
+private:
+    // Get latest messages within *budget* tokens, and decrease *budget* with tokens used.
+    nlohmann::json _get_latest_msgs(std::size_t &budget);
+
+    std::string _get_history_summary(LlmModel &model, VectorStore &store, const std::string_view &input, int k, std::size_t budget);
 
-    std::string _get_history_summary(LlmModel &model, VectorStore &store, const std::string_view &input, int k);
+    // Get data of the k nearest private summaries, sorted by distance.
+    std::vector<std::string> _knn_private_summaries(const Vector &query, std::size_t k) const;
 
     ChatHistoryOptions _opts;
 
     Prompt _summary_prompt;
 
+    bool _private_summaries;
+
     std::vector<Msg> _msgs_to_be_summarize;
 
+    // Number of tokens of _msgs_to_be_summarize.
+    std::size_t _tokens_to_be_summarize = 0;
+
     std::deque<Msg> _latest_msgs;
+
+    struct Summary {
+        std::string data;
+
+        Vector embedding;
+    };
+
+    // Summaries are added in background threads, so protect them with a mutex.
+    mutable std::mutex _summary_mtx;
+
+    std::vector<Summary> _summaries;
 };
 
 }
@@ -23,10 +23,14 @@
 #include "sw/redis-llm/create_vector_store_command.h"
 #include "sw/redis-llm/errors.h"
 #include "sw/redis-llm/get_command.h"
+#include "sw/redis-llm/job_command.h"
 #include "sw/redis-llm/knn_command.h"
+#include "sw/redis-llm/madd_command.h"
 #include "sw/redis-llm/rem_command.h"
 #include "sw/redis-llm/run_command.h"
 #include "sw/redis-llm/size_command.h"
+#include "sw/redis-llm/slowlog_command.h"
+#include "sw/redis-llm/stats_command.h"
 
 namespace sw::redis::llm {
 
@@ -44,6 +48,18 @@ int Command::run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) const
     return REDISMODULE_ERR;
 }
 
+TaskOptions Command::_blocking_task_options(std::chrono::steady_clock::time_point start,
+        std::chrono::milliseconds timeout, const CancelTokenSPtr &token) {
+    TaskOptions opts;
+    opts.priority = TaskPriority::INTERACTIVE;
+    if (timeout.count() > 0) {
+        opts.deadline = start + timeout;
+    }
+    opts.token = token;
+
+    return opts;
+}
+
 namespace cmd {
 
 void create_commands(RedisModuleCtx *ctx) {
@@ -125,6 +141,19 @@ void create_commands(RedisModuleCtx *ctx) {
         throw Error("fail to create LLM.ADD command");
     }
 
+    if (RedisModule_CreateCommand(ctx,
+                "LLM.MADD",
+                [](RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+                    MaddCommand cmd;
+                    return cmd.run(ctx, argv, argc);
+                },
+                "write deny-oom",
+                1,
+                1,
+                1) == REDISMODULE_ERR) {
+        throw Error("fail to create LLM.MADD command");
+    }
+
     if (RedisModule_CreateCommand(ctx,
                 "LLM.REM",
                 [](RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
@@ -157,7 +186,7 @@ void create_commands(RedisModuleCtx *ctx) {
                     RunCommand cmd;
                     return cmd.run(ctx, argv, argc);
                 },
-                "readonly",
+                "readonly getkeys-api",
                 1,
                 1,
                 1) == REDISMODULE_ERR) {
@@ -189,6 +218,45 @@ void create_commands(RedisModuleCtx *ctx) {
                 1) == REDISMODULE_ERR) {
         throw Error("failed to create LLM.SIZE command");
     }
+
+    if (RedisModule_CreateCommand(ctx,
+                "LLM.STATS",
+                [](RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+                    StatsCommand cmd;
+                    return cmd.run(ctx, argv, argc);
+                },
+                "readonly",
+                0,
+                0,
+                0) == REDISMODULE_ERR) {
+        throw Error("failed to create LLM.STATS command");
+    }
+
+    if (RedisModule_CreateCommand(ctx,
+                "LLM.SLOWLOG",
+                [](RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+                    SlowlogCommand cmd;
+                    return cmd.run(ctx, argv, argc);
+                },
+                "admin",
+                0,
+                0,
+                0) == REDISMODULE_ERR) {
+        throw Error("failed to create LLM.SLOWLOG command");
+    }
+
+    if (RedisModule_CreateCommand(ctx,
+                "LLM.JOB",
+                [](RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+                    JobCommand cmd;
+                    return cmd.run(ctx, argv, argc);
+                },
+                "readonly",
+                0,
+                0,
+                0) == REDISMODULE_ERR) {
+        throw Error("failed to create LLM.JOB command");
+    }
 }
 
 }
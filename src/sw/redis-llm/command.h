@@ -17,7 +17,10 @@
 #ifndef SEWENEW_REDIS_LLM_COMMAND_H
 #define SEWENEW_REDIS_LLM_COMMAND_H
 
+#include <chrono>
+#include "sw/redis-llm/cancel.h"
 #include "sw/redis-llm/module_api.h"
+#include "sw/redis-llm/worker_pool.h"
 
 namespace sw::redis::llm {
 
@@ -27,6 +30,12 @@ public:
 
     int run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) const;
 
+protected:
+    // Options of the task serving a blocked client, which expires once the client times out.
+    // 0 *timeout* means no timeout.
+    static TaskOptions _blocking_task_options(std::chrono::steady_clock::time_point start,
+            std::chrono::milliseconds timeout, const CancelTokenSPtr &token);
+
 private:
     virtual void _run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) const = 0;
 };
@@ -63,6 +63,16 @@ CreateSearchCommand::Args CreateSearchCommand::_parse_args(RedisModuleString **a
             } catch (const std::exception &e) {
                 throw Error(std::string("invalid k") + e.what());
             }
+        } else if (util::str_case_equal(opt, "--TOKEN-BUDGET")) {
+            if (idx + 1 >= argc) {
+                throw Error("syntax error");
+            }
+            ++idx;
+            try {
+                args.params["token_budget"] = std::stoul(util::to_string(argv[idx]));
+            } catch (const std::exception &e) {
+                throw Error(std::string("invalid token budget") + e.what());
+            }
         } else {
             break;
         }
@@ -22,7 +22,7 @@
 
 namespace sw::redis::llm {
 
-// LLM.CREATE SEARCH key [--NX] [--XX] --LLM llm-info --VECTOR-STORE xxx [--K 3] [--PROMPT prompt]
+// LLM.CREATE SEARCH key [--NX] [--XX] --LLM llm-info --VECTOR-STORE xxx [--K 3] [--TOKEN-BUDGET 0] [--PROMPT prompt]
 class CreateSearchCommand : public CreateAppCommand {
 public:
     CreateSearchCommand() : CreateAppCommand("search") {}
@@ -0,0 +1,157 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/embedding_batcher.h"
+#include "sw/redis-llm/cancel.h"
+#include "sw/redis-llm/errors.h"
+#include "sw/redis-llm/profile.h"
+#include "sw/redis-llm/redis_llm.h"
+#include "sw/redis-llm/stats.h"
+
+namespace sw::redis::llm {
+
+EmbeddingBatchOptions::EmbeddingBatchOptions(const nlohmann::json &conf) {
+    try {
+        window = std::chrono::microseconds(conf.value<std::size_t>("window", 0));
+        max_size = conf.value<std::size_t>("max_size", 16);
+        max_tokens = conf.value<std::size_t>("max_tokens", 8000);
+    } catch (const nlohmann::json::exception &e) {
+        throw Error(std::string("invalid embedding batch options: ") + e.what());
+    }
+
+    if (max_size == 0 || max_tokens == 0) {
+        throw Error("max_size and max_tokens of embedding batch should be positive");
+    }
+}
+
+EmbeddingBatcher::EmbeddingBatcher(const EmbeddingBatchOptions &opts, BatchFunc func) :
+    _opts(opts), _func(std::move(func)) {}
+
+Vector EmbeddingBatcher::embedding(const std::string_view &input) {
+    Request req;
+    req.input = input;
+    req.tokens = RedisLlm::instance().count_tokens(input);
+    req.enqueue_time = std::chrono::steady_clock::now();
+    req.profile = Profile::current();
+
+    std::unique_lock<std::mutex> lock(_mtx);
+
+    _pending.push_back(&req);
+    _pending_tokens += req.tokens;
+
+    if (_pending.size() == 1) {
+        req.leader = true;
+    } else if (_full()) {
+        // Wake up the leader.
+        _cv.notify_all();
+    }
+
+    // Wait until either the batch is done by others, or this request becomes the leader.
+    _cv.wait(lock, [&req]() { return req.done || req.leader; });
+
+    if (!req.done) {
+        _cv.wait_until(lock, req.enqueue_time + _opts.window, [this]() { return _full(); });
+
+        auto batch = _take_batch();
+        if (!_pending.empty()) {
+            // Hand the rest over to the next leader.
+            _pending.front()->leader = true;
+            _cv.notify_all();
+        }
+
+        lock.unlock();
+
+        _run_batch(batch);
+
+        lock.lock();
+
+        for (auto *r : batch) {
+            r->done = true;
+        }
+
+        _cv.notify_all();
+    }
+
+    if (req.err) {
+        std::rethrow_exception(req.err);
+    }
+
+    return std::move(req.result);
+}
+
+bool EmbeddingBatcher::_full() const {
+    return _pending.size() >= _opts.max_size || _pending_tokens >= _opts.max_tokens;
+}
+
+auto EmbeddingBatcher::_take_batch() -> std::vector<Request *> {
+    std::vector<Request *> batch;
+    std::size_t tokens = 0;
+    for (auto *req : _pending) {
+        if (batch.size() == _opts.max_size
+                || (!batch.empty() && tokens + req->tokens > _opts.max_tokens)) {
+            break;
+        }
+
+        batch.push_back(req);
+        tokens += req->tokens;
+    }
+
+    _pending.erase(_pending.begin(), _pending.begin() + batch.size());
+    _pending_tokens -= tokens;
+
+    return batch;
+}
+
+void EmbeddingBatcher::_run_batch(std::vector<Request *> &batch) {
+    assert(!batch.empty());
+
+    Stats::instance().incr(Counter::EMBEDDING_BATCHES);
+    Stats::instance().incr(Counter::EMBEDDING_BATCHED_INPUTS, batch.size());
+
+    std::vector<std::string_view> inputs;
+    inputs.reserve(batch.size());
+    for (const auto *req : batch) {
+        inputs.push_back(req->input);
+    }
+
+    try {
+        // The batch also serves other requests, so it must not be aborted by the leader's client.
+        CancelScope scope(nullptr);
+
+        auto results = _func(inputs);
+        if (results.size() != batch.size()) {
+            throw Error("embedding batch size mismatch");
+        }
+
+        for (std::size_t idx = 0; idx != batch.size(); ++idx) {
+            batch[idx]->result = std::move(results[idx]);
+        }
+    } catch (...) {
+        auto err = std::current_exception();
+        for (auto *req : batch) {
+            req->err = err;
+        }
+    }
+
+    // Owners of profiles are blocked until their requests are done.
+    for (auto *req : batch) {
+        if (req->profile != nullptr) {
+            req->profile->add("embedding_batch", static_cast<long long>(batch.size()));
+        }
+    }
+}
+
+}
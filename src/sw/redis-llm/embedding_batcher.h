@@ -0,0 +1,119 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SEWENEW_REDIS_LLM_EMBEDDING_BATCHER_H
+#define SEWENEW_REDIS_LLM_EMBEDDING_BATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "nlohmann/json.hpp"
+#include "sw/redis-llm/utils.h"
+
+namespace sw::redis::llm {
+
+class Profile;
+
+struct EmbeddingBatchOptions {
+    EmbeddingBatchOptions() = default;
+
+    explicit EmbeddingBatchOptions(const nlohmann::json &conf);
+
+    // Max time the first input of a batch waits for others. 0 means inputs are not batched.
+    std::chrono::microseconds window{0};
+
+    // Max number of inputs in a batch.
+    std::size_t max_size = 16;
+
+    // Max number of tokens of all inputs in a batch. An input with more tokens than it,
+    // is sent in a batch of its own.
+    std::size_t max_tokens = 8000;
+};
+
+// Merge embedding requests from concurrent callers into a single call with multiple inputs.
+// The first caller arriving at an empty batch becomes the leader. It waits for at most
+// the window, or until the batch is full, and then sends the batch on behalf of others.
+// Inputs that do not fit into the batch are left to the next leader.
+class EmbeddingBatcher {
+public:
+    // Create embeddings of all inputs with a single request, in the order of inputs.
+    using BatchFunc = std::function<std::vector<Vector> (const std::vector<std::string_view> &)>;
+
+    EmbeddingBatcher(const EmbeddingBatchOptions &opts, BatchFunc func);
+
+    EmbeddingBatcher(const EmbeddingBatcher &) = delete;
+    EmbeddingBatcher& operator=(const EmbeddingBatcher &) = delete;
+
+    EmbeddingBatcher(EmbeddingBatcher &&) = delete;
+    EmbeddingBatcher& operator=(EmbeddingBatcher &&) = delete;
+
+    ~EmbeddingBatcher() = default;
+
+    bool enabled() const {
+        return _opts.window.count() > 0 && _opts.max_size > 1;
+    }
+
+    // Block until embedding of *input* is created with a batch.
+    Vector embedding(const std::string_view &input);
+
+private:
+    struct Request {
+        std::string_view input;
+
+        std::size_t tokens = 0;
+
+        std::chrono::steady_clock::time_point enqueue_time;
+
+        // Profile of the calling thread.
+        Profile *profile = nullptr;
+
+        bool leader = false;
+
+        bool done = false;
+
+        Vector result;
+
+        std::exception_ptr err;
+    };
+
+    bool _full() const;
+
+    // Take requests from the front of pending queue, as many as limits allow.
+    std::vector<Request *> _take_batch();
+
+    void _run_batch(std::vector<Request *> &batch);
+
+    EmbeddingBatchOptions _opts;
+
+    BatchFunc _func;
+
+    std::mutex _mtx;
+
+    std::condition_variable _cv;
+
+    // Pending requests, and the first one is the leader.
+    std::vector<Request *> _pending;
+
+    std::size_t _pending_tokens = 0;
+};
+
+}
+
+#endif // end SEWENEW_REDIS_LLM_EMBEDDING_BATCHER_H
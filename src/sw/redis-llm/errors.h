@@ -68,6 +68,48 @@ public:
     virtual ~WrongArityError() = default;
 };
 
+// Client of the request timed out or disconnected, so the work is given up.
+class CancelledError : public Error {
+public:
+    CancelledError() : Error("request cancelled") {}
+
+    CancelledError(const CancelledError &) = default;
+    CancelledError& operator=(const CancelledError &) = default;
+
+    CancelledError(CancelledError &&) = default;
+    CancelledError& operator=(CancelledError &&) = default;
+
+    virtual ~CancelledError() = default;
+};
+
+// Request to remote model failed, either with a transport error, or a non-200 status.
+class HttpError : public Error {
+public:
+    HttpError(const std::string &msg, long status) : Error(msg), _status(status) {}
+
+    HttpError(const HttpError &) = default;
+    HttpError& operator=(const HttpError &) = default;
+
+    HttpError(HttpError &&) = default;
+    HttpError& operator=(HttpError &&) = default;
+
+    virtual ~HttpError() = default;
+
+    // HTTP status code. 0, if it's a transport error.
+    long status() const {
+        return _status;
+    }
+
+    // Whether the endpoint, instead of the request, is to blame, i.e. transport error,
+    // rate limited or server error. Such request might succeed with another endpoint.
+    bool retryable() const {
+        return _status == 0 || _status == 429 || _status >= 500;
+    }
+
+private:
+    long _status = 0;
+};
+
 }
 
 #endif // end SEWENEW_REDIS_LLM_ERRORS_H
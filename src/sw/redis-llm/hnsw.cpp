@@ -16,27 +16,121 @@
 
 #include "sw/redis-llm/hnsw.h"
 #include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "sw/redis-llm/profile.h"
+#include "sw/redis-llm/redis_llm.h"
+
+namespace {
+
+// Index file: magic, number of shards, offset of each shard's section, and then the sections.
+// Each section has a header, labels, deleted slots and upper layers of the graph, followed by
+// the base layer, i.e. vectors and their level 0 links, which is aligned to page boundary,
+// so that it can be mapped into memory as is.
+const std::string INDEX_FILE_MAGIC = "LLMHNSW2";
+
+// Not smaller than page size of common platforms, i.e. 4KB, 16KB and 64KB.
+const uint64_t BASE_LAYER_ALIGNMENT = 64 * 1024;
+
+struct SectionHeader {
+    uint64_t max_elements = 0;
+    uint64_t cur_element_count = 0;
+    uint64_t size_data_per_element = 0;
+    uint64_t label_offset = 0;
+    uint64_t offset_data = 0;
+    int64_t max_level = 0;
+    uint64_t enterpoint_node = 0;
+    uint64_t max_m = 0;
+    uint64_t max_m0 = 0;
+    uint64_t m = 0;
+    double mult = 0;
+    uint64_t ef_construction = 0;
+    uint64_t num_deleted = 0;
+
+    // Offset of the base layer from the beginning of the file.
+    uint64_t base_layer_offset = 0;
+};
+
+// Base layer of a loaded graph. Slots in the file are mapped copy-on-write, so that the file
+// is never modified, and pages not modified are shared with page cache. Other slots are
+// mapped anonymously, and only take memory once they're used.
+struct MappedBaseLayer {
+    MappedBaseLayer(int fd, uint64_t offset, std::size_t used, std::size_t capacity);
+
+    MappedBaseLayer(const MappedBaseLayer &) = delete;
+    MappedBaseLayer& operator=(const MappedBaseLayer &) = delete;
+
+    ~MappedBaseLayer() {
+        munmap(addr, len);
+    }
+
+    char *addr = nullptr;
+
+    std::size_t len = 0;
+};
+
+MappedBaseLayer::MappedBaseLayer(int fd, uint64_t offset, std::size_t used, std::size_t capacity) :
+        len(capacity) {
+    auto *region = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+        throw sw::redis::llm::Error("failed to reserve memory for hnsw index");
+    }
+
+    if (used > 0 && mmap(region, used, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_FIXED, fd, offset) == MAP_FAILED) {
+        munmap(region, len);
+        throw sw::redis::llm::Error("failed to mmap hnsw index");
+    }
+
+    addr = static_cast<char *>(region);
+}
+
+}
 
 namespace sw::redis::llm {
 
 Hnsw::Hnsw(const nlohmann::json &conf, const LlmInfo &llm) :
-    VectorStore("hnsw", conf, llm), _opts(_parse_options(conf)) {}
+    VectorStore("hnsw", conf, llm), _opts(_parse_options(conf)) {
+    _shards.reserve(_opts.shards);
+    for (std::size_t idx = 0; idx != _opts.shards; ++idx) {
+        _shards.push_back(std::make_unique<Shard>());
+    }
+}
 
 void Hnsw::_rem(uint64_t id) {
+    auto shard_idx = _shard_idx(id);
+    auto &shard = *_shards[shard_idx];
+    auto need_vacuum = false;
     try {
-        assert(_hnsw);
+        std::shared_lock<std::shared_mutex> lock(shard.hnsw_mtx);
+
+        assert(shard.hnsw);
+
+        shard.hnsw->markDelete(id);
+
+        _touch(shard, id);
 
-        _hnsw->markDelete(id);
+        need_vacuum = _need_vacuum(*shard.hnsw);
     } catch (const std::exception &e) {
         throw Error("failed to delete: " + std::to_string(id) + ", err: " + e.what());
     }
+
+    if (need_vacuum) {
+        _schedule_vacuum(shard_idx);
+    }
 }
 
 std::optional<Vector> Hnsw::_get(uint64_t id) {
     try {
-        assert(_hnsw);
+        auto index = _index(*_shards[_shard_idx(id)]);
 
-        return _hnsw->getDataByLabel<float>(id);
+        return index->getDataByLabel<float>(id);
     } catch (const std::exception &e) {
         // Fall through
     }
@@ -45,29 +139,60 @@ std::optional<Vector> Hnsw::_get(uint64_t id) {
 }
 
 std::vector<std::pair<uint64_t, float>> Hnsw::_knn(const Vector &query, std::size_t k) {
+    auto *profile = Profile::current();
+
+    if (_shards.size() == 1) {
+        long visited = 0;
+        auto output = _search(*_shards.front(), query, k, visited);
+
+        if (profile != nullptr) {
+            profile->add("knn_visited", visited);
+        }
+
+        return output;
+    }
+
+    std::vector<std::vector<std::pair<uint64_t, float>>> results(_shards.size());
+    std::vector<long> visited(_shards.size(), 0);
+    _for_each_shard([this, &query, k, &results, &visited](std::size_t idx) {
+                results[idx] = _search(*_shards[idx], query, k, visited[idx]);
+            });
+
+    // Merge top k of each shard.
     std::vector<std::pair<uint64_t, float>> output;
-    try {
-        assert(_hnsw);
+    for (auto &res : results) {
+        output.insert(output.end(), res.begin(), res.end());
+    }
 
-        auto res = _hnsw->searchKnn(query.data(), k);
-        while (!res.empty()) {
-            auto &ele = res.top();
-            output.emplace_back(ele.second, ele.first);
-            res.pop();
+    auto cmp = [](const auto &lhs, const auto &rhs) { return lhs.second < rhs.second; };
+    if (output.size() > k) {
+        std::partial_sort(output.begin(), output.begin() + k, output.end(), cmp);
+        output.resize(k);
+    } else {
+        std::sort(output.begin(), output.end(), cmp);
+    }
+
+    if (profile != nullptr) {
+        long total = 0;
+        for (auto cnt : visited) {
+            total += cnt;
         }
-        std::reverse(output.begin(), output.end());
-    } catch (const std::exception &e) {
-        throw Error("failed to do knn");
+        profile->add("knn_visited", total);
     }
 
     return output;
 }
 
 void Hnsw::_add(uint64_t id, const Vector &embedding) {
+    auto &shard = *_shards[_shard_idx(id)];
     try {
-        assert(_hnsw);
+        std::shared_lock<std::shared_mutex> lock(shard.hnsw_mtx);
+
+        assert(shard.hnsw);
+
+        _upsert(shard, *shard.hnsw, id, embedding.data());
 
-        _hnsw->addPoint(embedding.data(), id);
+        _touch(shard, id);
     } catch (const std::exception &e) {
         throw Error("failed to do set: " + std::to_string(id));
     }
@@ -76,8 +201,290 @@ void Hnsw::_add(uint64_t id, const Vector &embedding) {
 void Hnsw::_lazily_init(std::size_t dim) {
     if (!_space) {
         _space = std::make_unique<hnswlib::L2Space>(dim);
-        _hnsw = std::make_unique<hnswlib::HierarchicalNSW<float>>(_space.get(), _opts.max_elements, _opts.m, _opts.ef_construction);
+
+        for (auto &shard : _shards) {
+            std::unique_lock<std::shared_mutex> lock(shard->hnsw_mtx);
+
+            shard->hnsw = _create_index();
+        }
+    }
+}
+
+uint64_t Hnsw::_dump_index(const std::string &path) {
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+
+    uint64_t cnt = _shards.size();
+    std::vector<uint64_t> offsets(cnt, 0);
+
+    // Offsets are filled after sections are written.
+    output.write(INDEX_FILE_MAGIC.data(), INDEX_FILE_MAGIC.size());
+    output.write(reinterpret_cast<const char *>(&cnt), sizeof(cnt));
+    output.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint64_t));
+
+    auto sum = util::checksum(nullptr, 0);
+    for (std::size_t idx = 0; idx != _shards.size(); ++idx) {
+        auto &shard = *_shards[idx];
+
+        std::shared_lock<std::shared_mutex> lock(shard.hnsw_mtx);
+
+        assert(shard.hnsw);
+
+        offsets[idx] = output.tellp();
+        sum = _dump_shard(*shard.hnsw, output, sum);
+    }
+
+    output.seekp(INDEX_FILE_MAGIC.size() + sizeof(cnt));
+    output.write(reinterpret_cast<const char *>(offsets.data()), offsets.size() * sizeof(uint64_t));
+
+    output.flush();
+    if (!output) {
+        throw Error("failed to write hnsw index: " + path);
+    }
+
+    sum = util::checksum(INDEX_FILE_MAGIC.data(), INDEX_FILE_MAGIC.size(), sum);
+    sum = util::checksum(reinterpret_cast<const char *>(&cnt), sizeof(cnt), sum);
+
+    return util::checksum(reinterpret_cast<const char *>(offsets.data()),
+            offsets.size() * sizeof(uint64_t), sum);
+}
+
+uint64_t Hnsw::_load_index(const std::string &path, std::size_t dim) {
+    _space = std::make_unique<hnswlib::L2Space>(dim);
+
+    std::ifstream input(path, std::ios::binary);
+
+    std::string magic(INDEX_FILE_MAGIC.size(), '\0');
+    uint64_t cnt = 0;
+    input.read(magic.data(), magic.size());
+    input.read(reinterpret_cast<char *>(&cnt), sizeof(cnt));
+    if (!input || magic != INDEX_FILE_MAGIC || cnt != _shards.size()) {
+        throw Error("invalid hnsw index: " + path);
+    }
+
+    std::vector<uint64_t> offsets(cnt, 0);
+    input.read(reinterpret_cast<char *>(offsets.data()), offsets.size() * sizeof(uint64_t));
+    if (!input) {
+        throw Error("truncated hnsw index: " + path);
+    }
+
+    auto fd = open(path.data(), O_RDONLY);
+    if (fd < 0) {
+        throw Error("failed to open hnsw index: " + path);
+    }
+
+    auto sum = util::checksum(nullptr, 0);
+    try {
+        for (std::size_t idx = 0; idx != _shards.size(); ++idx) {
+            input.seekg(offsets[idx]);
+
+            auto index = _load_shard(input, fd, sum);
+
+            auto &shard = *_shards[idx];
+            std::unique_lock<std::shared_mutex> lock(shard.hnsw_mtx);
+            shard.hnsw = std::move(index);
+        }
+    } catch (const std::exception &e) {
+        close(fd);
+        throw Error("failed to load hnsw index: " + path + ", err: " + e.what());
+    }
+
+    // Mappings keep their own references to the file.
+    close(fd);
+
+    sum = util::checksum(magic.data(), magic.size(), sum);
+    sum = util::checksum(reinterpret_cast<const char *>(&cnt), sizeof(cnt), sum);
+
+    return util::checksum(reinterpret_cast<const char *>(offsets.data()),
+            offsets.size() * sizeof(uint64_t), sum);
+}
+
+void Hnsw::_lock_index() {
+    for (auto &shard : _shards) {
+        shard->hnsw_mtx.lock();
+
+        // Vacuum reads the graph with only this lock held.
+        if (shard->hnsw) {
+            shard->hnsw->label_lookup_lock.lock();
+        }
+    }
+}
+
+void Hnsw::_unlock_index(bool child) {
+    for (auto &shard : _shards) {
+        if (child) {
+            if (shard->hnsw) {
+                _reset_lock(shard->hnsw->label_lookup_lock);
+            }
+
+            _reset_lock(shard->hnsw_mtx);
+        } else {
+            if (shard->hnsw) {
+                shard->hnsw->label_lookup_lock.unlock();
+            }
+
+            shard->hnsw_mtx.unlock();
+        }
+    }
+}
+
+uint64_t Hnsw::_dump_shard(Index &index, std::ofstream &output, uint64_t sum) const {
+    auto write = [&output, &sum](const void *data, std::size_t len) {
+        output.write(static_cast<const char *>(data), len);
+        sum = util::checksum(static_cast<const char *>(data), len, sum);
+    };
+
+    std::size_t cnt = index.cur_element_count;
+
+    std::vector<uint64_t> labels(cnt);
+    std::vector<uint32_t> deleted;
+    uint64_t upper_layers = 0;
+    for (std::size_t idx = 0; idx != cnt; ++idx) {
+        labels[idx] = index.getExternalLabel(idx);
+        if (index.isMarkedDeleted(idx)) {
+            deleted.push_back(idx);
+        }
+
+        upper_layers += sizeof(uint32_t) + index.size_links_per_element_ * index.element_levels_[idx];
+    }
+
+    SectionHeader header;
+    header.max_elements = index.max_elements_;
+    header.cur_element_count = cnt;
+    header.size_data_per_element = index.size_data_per_element_;
+    header.label_offset = index.label_offset_;
+    header.offset_data = index.offsetData_;
+    header.max_level = index.maxlevel_;
+    header.enterpoint_node = index.enterpoint_node_;
+    header.max_m = index.maxM_;
+    header.max_m0 = index.maxM0_;
+    header.m = index.M_;
+    header.mult = index.mult_;
+    header.ef_construction = index.ef_construction_;
+    header.num_deleted = deleted.size();
+
+    uint64_t end = static_cast<uint64_t>(output.tellp()) + sizeof(header)
+        + labels.size() * sizeof(uint64_t) + deleted.size() * sizeof(uint32_t) + upper_layers;
+    header.base_layer_offset = (end + BASE_LAYER_ALIGNMENT - 1) / BASE_LAYER_ALIGNMENT * BASE_LAYER_ALIGNMENT;
+
+    write(&header, sizeof(header));
+    write(labels.data(), labels.size() * sizeof(uint64_t));
+    write(deleted.data(), deleted.size() * sizeof(uint32_t));
+    for (std::size_t idx = 0; idx != cnt; ++idx) {
+        uint32_t len = index.size_links_per_element_ * index.element_levels_[idx];
+        write(&len, sizeof(len));
+        if (len > 0) {
+            write(index.linkLists_[idx], len);
+        }
+    }
+
+    // Base layer is not checksummed, so that loading it does not read the whole file.
+    std::string padding(header.base_layer_offset - end, '\0');
+    output.write(padding.data(), padding.size());
+    output.write(index.data_level0_memory_, cnt * index.size_data_per_element_);
+
+    return sum;
+}
+
+Hnsw::IndexSPtr Hnsw::_load_shard(std::ifstream &input, int fd, uint64_t &sum) const {
+    auto read = [&input, &sum](void *data, std::size_t len) {
+        input.read(static_cast<char *>(data), len);
+        if (!input) {
+            throw Error("truncated file");
+        }
+        sum = util::checksum(static_cast<const char *>(data), len, sum);
+    };
+
+    SectionHeader header;
+    read(&header, sizeof(header));
+
+    std::size_t cnt = header.cur_element_count;
+    std::size_t max_elements = std::max(cnt, _shard_capacity());
+
+    // The same way as hnswlib::HierarchicalNSW::loadIndex, except that the base layer is mapped.
+    std::unique_ptr<Index> index(new Index(_space.get()));
+    index->allow_replace_deleted_ = true;
+    index->max_elements_ = max_elements;
+    index->size_data_per_element_ = header.size_data_per_element;
+    index->label_offset_ = header.label_offset;
+    index->offsetData_ = header.offset_data;
+    index->offsetLevel0_ = 0;
+    index->maxlevel_ = header.max_level;
+    index->enterpoint_node_ = header.enterpoint_node;
+    index->maxM_ = header.max_m;
+    index->maxM0_ = header.max_m0;
+    index->M_ = header.m;
+    index->mult_ = header.mult;
+    index->revSize_ = 1.0 / header.mult;
+    index->ef_construction_ = header.ef_construction;
+    index->ef_ = 10;
+    index->data_size_ = _space->get_data_size();
+    index->fstdistfunc_ = _space->get_dist_func();
+    index->dist_func_param_ = _space->get_dist_func_param();
+    index->size_links_per_element_ = index->maxM_ * sizeof(hnswlib::tableint) + sizeof(hnswlib::linklistsizeint);
+    index->size_links_level0_ = index->maxM0_ * sizeof(hnswlib::tableint) + sizeof(hnswlib::linklistsizeint);
+
+    if (index->offsetData_ != index->size_links_level0_
+            || index->label_offset_ != index->offsetData_ + index->data_size_
+            || index->size_data_per_element_ != index->label_offset_ + sizeof(hnswlib::labeltype)) {
+        throw Error("dimension mismatch");
+    }
+
+    std::vector<std::mutex>(max_elements).swap(index->link_list_locks_);
+    std::vector<std::mutex>(Index::MAX_LABEL_OPERATION_LOCKS).swap(index->label_op_locks_);
+    index->visited_list_pool_ = new hnswlib::VisitedListPool(1, max_elements);
+    index->element_levels_ = std::vector<int>(max_elements);
+    index->linkLists_ = static_cast<char **>(malloc(sizeof(void *) * max_elements));
+    if (index->linkLists_ == nullptr) {
+        throw Error("failed to allocate link lists");
+    }
+
+    std::vector<uint64_t> labels(cnt);
+    read(labels.data(), labels.size() * sizeof(uint64_t));
+
+    std::vector<uint32_t> deleted(header.num_deleted);
+    read(deleted.data(), deleted.size() * sizeof(uint32_t));
+
+    index->cur_element_count = cnt;
+    for (std::size_t idx = 0; idx != cnt; ++idx) {
+        uint32_t len = 0;
+        read(&len, sizeof(len));
+
+        index->linkLists_[idx] = nullptr;
+        if (len > 0) {
+            if (len % index->size_links_per_element_ != 0) {
+                throw Error("invalid link list");
+            }
+
+            index->linkLists_[idx] = static_cast<char *>(malloc(len));
+            if (index->linkLists_[idx] == nullptr) {
+                throw Error("failed to allocate link list");
+            }
+            index->element_levels_[idx] = len / index->size_links_per_element_;
+
+            read(index->linkLists_[idx], len);
+        }
+
+        index->label_lookup_[labels[idx]] = idx;
+    }
+
+    for (auto idx : deleted) {
+        if (idx >= cnt) {
+            throw Error("invalid deleted slot");
+        }
+
+        index->deleted_elements.insert(idx);
     }
+    index->num_deleted_ = deleted.size();
+
+    auto base_layer = std::make_shared<MappedBaseLayer>(fd, header.base_layer_offset,
+            cnt * index->size_data_per_element_, max_elements * index->size_data_per_element_);
+    index->data_level0_memory_ = base_layer->addr;
+
+    return IndexSPtr(index.release(), [base_layer](Index *idx) {
+                // Base layer is unmapped by MappedBaseLayer, instead of being freed by hnswlib.
+                idx->data_level0_memory_ = nullptr;
+                delete idx;
+            });
 }
 
 Hnsw::Options Hnsw::_parse_options(const nlohmann::json &conf) const {
@@ -86,11 +493,301 @@ Hnsw::Options Hnsw::_parse_options(const nlohmann::json &conf) const {
         opts.max_elements = conf.value<std::size_t>("max_elements", 100000);
         opts.m = conf.value<std::size_t>("m", 16);
         opts.ef_construction = conf.value<std::size_t>("ef_construction", 200);
+        opts.vacuum_ratio = conf.value<float>("vacuum_ratio", 0.5);
+        opts.vacuum_min_deleted = conf.value<std::size_t>("vacuum_min_deleted", 1000);
+        opts.shards = conf.value<std::size_t>("shards", 1);
     } catch (const nlohmann::json::exception &e) {
         throw Error(std::string("failed to parse vector store options: ") + e.what());
     }
 
+    if (opts.vacuum_ratio < 0 || opts.vacuum_ratio > 1) {
+        throw Error("vacuum_ratio should be in range [0, 1]");
+    }
+
+    if (opts.shards == 0 || opts.shards > opts.max_elements) {
+        throw Error("shards should be in range [1, max_elements]");
+    }
+
     return opts;
 }
 
+Hnsw::IndexSPtr Hnsw::_create_index() const {
+    assert(_space);
+
+    // Enable replacing deleted elements, so that slots of removed items can be reused.
+    return std::make_shared<Index>(_space.get(), _shard_capacity(), _opts.m, _opts.ef_construction, 100, true);
+}
+
+std::size_t Hnsw::_shard_capacity() const {
+    if (_opts.shards == 1) {
+        return _opts.max_elements;
+    }
+
+    // Items are partitioned by id hash, so a shard might get a bit more than its even share.
+    // Leave room for 4 standard deviations of the imbalance.
+    auto share = (_opts.max_elements + _opts.shards - 1) / _opts.shards;
+
+    return share + 4 * static_cast<std::size_t>(std::ceil(std::sqrt(share)));
+}
+
+std::size_t Hnsw::_shard_idx(uint64_t id) const {
+    if (_shards.size() == 1) {
+        return 0;
+    }
+
+    // Fibonacci hashing, so that ids with patterns, e.g. all even, are still spread evenly.
+    return ((id * 11400714819323198485ULL) >> 32) % _shards.size();
+}
+
+Hnsw::IndexSPtr Hnsw::_index(Shard &shard) {
+    std::shared_lock<std::shared_mutex> lock(shard.hnsw_mtx);
+
+    assert(shard.hnsw);
+
+    return shard.hnsw;
+}
+
+std::vector<std::pair<uint64_t, float>> Hnsw::_search(Shard &shard,
+        const Vector &query, std::size_t k, long &visited) {
+    std::vector<std::pair<uint64_t, float>> output;
+    try {
+        std::shared_lock<std::shared_mutex> lock(shard.hnsw_mtx);
+
+        assert(shard.hnsw);
+
+        // hnswlib counts neighbors examined by all queries, so the delta is exact only if
+        // there's no concurrent query on the same graph.
+        auto computations = shard.hnsw->metric_distance_computations.load(std::memory_order_relaxed);
+
+        auto res = shard.hnsw->searchKnn(query.data(), k);
+
+        visited = shard.hnsw->metric_distance_computations.load(std::memory_order_relaxed) - computations;
+
+        while (!res.empty()) {
+            auto &ele = res.top();
+            output.emplace_back(ele.second, ele.first);
+            res.pop();
+        }
+        std::reverse(output.begin(), output.end());
+    } catch (const std::exception &e) {
+        throw Error("failed to do knn");
+    }
+
+    return output;
+}
+
+void Hnsw::_for_each_shard(const std::function<void (std::size_t)> &func) {
+    struct Job {
+        std::function<void (std::size_t)> func;
+
+        std::size_t shards = 0;
+
+        std::atomic<std::size_t> next{0};
+
+        std::size_t done = 0;
+
+        std::exception_ptr err;
+
+        std::mutex mtx;
+
+        std::condition_variable cv;
+
+        // Claim and run shards until all of them are claimed.
+        void run() {
+            while (true) {
+                auto idx = next.fetch_add(1);
+                if (idx >= shards) {
+                    break;
+                }
+
+                std::exception_ptr e;
+                try {
+                    func(idx);
+                } catch (...) {
+                    e = std::current_exception();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (e && !err) {
+                        err = e;
+                    }
+                    ++done;
+                }
+
+                cv.notify_all();
+            }
+        }
+    };
+
+    auto job = std::make_shared<Job>();
+    job->func = func;
+    job->shards = _shards.size();
+
+    // Only ask idle workers for help. Otherwise, helpers wait in the queue behind other
+    // commands, and take queue slots from them, while the current thread claims most shards.
+    auto &pool = RedisLlm::instance().worker_pool();
+    auto helpers = std::min(_shards.size() - 1, pool.idle_workers());
+    for (std::size_t idx = 0; idx < helpers; ++idx) {
+        try {
+            pool.enqueue([job]() { job->run(); });
+        } catch (const Error &) {
+            // Worker pool is busy, run the rest in the current thread.
+            break;
+        }
+    }
+
+    job->run();
+
+    // Shards not done are being run by other workers.
+    std::unique_lock<std::mutex> lock(job->mtx);
+    job->cv.wait(lock, [&job]() { return job->done == job->shards; });
+
+    if (job->err) {
+        std::rethrow_exception(job->err);
+    }
+}
+
+void Hnsw::_upsert(Shard &shard, Index &index, uint64_t id, const float *embedding) {
+    {
+        std::shared_lock<std::shared_mutex> lock(shard.replace_mtx);
+
+        switch (_label_state(index, id)) {
+        case LabelState::NONE:
+            index.addPoint(embedding, id, true);
+            return;
+
+        case LabelState::LIVE:
+            // Replacing a vacant slot with an existing label leaves a stale entry behind.
+            // So update it in place.
+            index.addPoint(embedding, id, false);
+            return;
+
+        default:
+            break;
+        }
+    }
+
+    // hnswlib refuses to update a deleted label, so undelete it, and update it in place.
+    // Its slot might be reused by others in the meantime, so check it again.
+    std::unique_lock<std::shared_mutex> lock(shard.replace_mtx);
+
+    auto state = _label_state(index, id);
+    if (state == LabelState::DELETED) {
+        index.unmarkDelete(id);
+    }
+
+    index.addPoint(embedding, id, state == LabelState::NONE);
+}
+
+Hnsw::LabelState Hnsw::_label_state(Index &index, uint64_t id) {
+    std::lock_guard<std::mutex> lock(index.label_lookup_lock);
+
+    auto iter = index.label_lookup_.find(id);
+    if (iter == index.label_lookup_.end()) {
+        return LabelState::NONE;
+    }
+
+    return index.isMarkedDeleted(iter->second) ? LabelState::DELETED : LabelState::LIVE;
+}
+
+bool Hnsw::_need_vacuum(Index &index) const {
+    if (_opts.vacuum_ratio <= 0) {
+        return false;
+    }
+
+    auto deleted = index.getDeletedCount();
+    if (deleted < _opts.vacuum_min_deleted) {
+        return false;
+    }
+
+    return deleted > _opts.vacuum_ratio * index.getCurrentElementCount();
+}
+
+void Hnsw::_schedule_vacuum(std::size_t shard_idx) {
+    auto &shard = *_shards[shard_idx];
+    {
+        std::lock_guard<std::mutex> lock(shard.vacuum_mtx);
+
+        if (shard.vacuuming) {
+            return;
+        }
+
+        shard.vacuuming = true;
+        shard.vacuum_touched.clear();
+    }
+
+    auto self = std::static_pointer_cast<Hnsw>(shared_from_this());
+    try {
+        TaskOptions task_opts;
+        task_opts.priority = TaskPriority::BACKGROUND;
+        RedisLlm::instance().worker_pool().enqueue(task_opts,
+                [self, shard_idx]() { self->_vacuum(shard_idx); });
+    } catch (const Error &) {
+        // Worker pool is busy, try again on next deletion.
+        std::lock_guard<std::mutex> lock(shard.vacuum_mtx);
+        shard.vacuuming = false;
+    }
+}
+
+void Hnsw::_vacuum(std::size_t shard_idx) {
+    auto &shard = *_shards[shard_idx];
+    try {
+        auto old_index = _index(shard);
+
+        // Take a snapshot of live items. Items modified since vacuuming was set,
+        // are recorded in vacuum_touched, and will be fixed before swapping.
+        std::vector<std::pair<uint64_t, hnswlib::tableint>> items;
+        {
+            std::lock_guard<std::mutex> lock(old_index->label_lookup_lock);
+
+            items.reserve(old_index->label_lookup_.size());
+            for (const auto &[label, internal_id] : old_index->label_lookup_) {
+                if (!old_index->isMarkedDeleted(internal_id)) {
+                    items.emplace_back(label, internal_id);
+                }
+            }
+        }
+
+        auto new_index = _create_index();
+        for (const auto &[label, internal_id] : items) {
+            new_index->addPoint(old_index->getDataByInternalId(internal_id), label);
+        }
+
+        std::unique_lock<std::shared_mutex> lock(shard.hnsw_mtx);
+        std::lock_guard<std::mutex> vacuum_lock(shard.vacuum_mtx);
+
+        for (auto id : shard.vacuum_touched) {
+            try {
+                auto embedding = shard.hnsw->getDataByLabel<float>(id);
+                _upsert(shard, *new_index, id, embedding.data());
+            } catch (const std::exception &) {
+                // Removed from the old graph.
+                try {
+                    new_index->markDelete(id);
+                } catch (const std::exception &) {
+                    // Not in the new graph either.
+                }
+            }
+        }
+
+        shard.hnsw = std::move(new_index);
+
+        shard.vacuuming = false;
+        shard.vacuum_touched.clear();
+    } catch (const std::exception &) {
+        std::lock_guard<std::mutex> lock(shard.vacuum_mtx);
+        shard.vacuuming = false;
+        shard.vacuum_touched.clear();
+    }
+}
+
+void Hnsw::_touch(Shard &shard, uint64_t id) {
+    std::lock_guard<std::mutex> lock(shard.vacuum_mtx);
+
+    if (shard.vacuuming) {
+        shard.vacuum_touched.insert(id);
+    }
+}
+
 }
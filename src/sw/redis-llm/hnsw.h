@@ -17,6 +17,13 @@
 #ifndef SEWENEW_REDIS_LLM_HNSW_H
 #define SEWENEW_REDIS_LLM_HNSW_H
 
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_set>
+#include <vector>
 #include "sw/redis-llm/vector_store.h"
 #include <hnswlib/hnswlib.h>
 
@@ -38,18 +45,102 @@ private:
 
     virtual void _lazily_init(std::size_t dim) override;
 
+    virtual uint64_t _dump_index(const std::string &path) override;
+
+    virtual uint64_t _load_index(const std::string &path, std::size_t dim) override;
+
+    virtual void _lock_index() override;
+
+    virtual void _unlock_index(bool child) override;
+
     struct Options {
         std::size_t max_elements = 10000;
         std::size_t m = 16;
         std::size_t ef_construction = 200;
+
+        // Rebuild the graph once deleted / total exceeds this ratio. 0 means never.
+        float vacuum_ratio = 0.5;
+
+        // Do not bother rebuilding small graphs.
+        std::size_t vacuum_min_deleted = 1000;
+
+        // Number of independent graphs that items are partitioned into by id hash.
+        std::size_t shards = 1;
+    };
+
+    using Index = hnswlib::HierarchicalNSW<float>;
+    using IndexSPtr = std::shared_ptr<Index>;
+
+    // A partition of the store, with its own graph, locks and vacuum state.
+    struct Shard {
+        IndexSPtr hnsw;
+
+        // Operations hold it shared, while vacuum holds it exclusively to swap hnsw.
+        std::shared_mutex hnsw_mtx;
+
+        // Reusing a deleted slot and re-adding a deleted label cannot run concurrently.
+        // The former holds it shared, and the latter holds it exclusively.
+        std::shared_mutex replace_mtx;
+
+        std::mutex vacuum_mtx;
+
+        bool vacuuming = false;
+
+        // Ids modified while vacuum is building the new graph.
+        std::unordered_set<uint64_t> vacuum_touched;
     };
 
     Options _parse_options(const nlohmann::json &conf) const;
 
+    // Write section of the graph, and return *sum* updated with the written data,
+    // except the base layer.
+    uint64_t _dump_shard(Index &index, std::ofstream &output, uint64_t sum) const;
+
+    // Load graph from the current section of *input*, whose base layer is mapped from *fd*.
+    IndexSPtr _load_shard(std::ifstream &input, int fd, uint64_t &sum) const;
+
+    IndexSPtr _create_index() const;
+
+    // Max number of items of each shard.
+    std::size_t _shard_capacity() const;
+
+    std::size_t _shard_idx(uint64_t id) const;
+
+    IndexSPtr _index(Shard &shard);
+
+    std::vector<std::pair<uint64_t, float>> _search(Shard &shard,
+            const Vector &query, std::size_t k, long &visited);
+
+    // Run *func* with index of each shard in parallel. Idle workers of the pool help the
+    // current thread, which also claims shards itself, so that it never waits for tasks
+    // stuck in the queue.
+    void _for_each_shard(const std::function<void (std::size_t)> &func);
+
+    // Insert or update *id*, reusing a deleted slot if there's any.
+    void _upsert(Shard &shard, Index &index, uint64_t id, const float *embedding);
+
+    enum class LabelState {
+        NONE,
+        LIVE,
+        DELETED
+    };
+
+    static LabelState _label_state(Index &index, uint64_t id);
+
+    bool _need_vacuum(Index &index) const;
+
+    void _schedule_vacuum(std::size_t shard_idx);
+
+    // Rebuild a fresh graph of the shard with live items, and swap it in.
+    void _vacuum(std::size_t shard_idx);
+
+    void _touch(Shard &shard, uint64_t id);
+
     Options _opts;
 
     std::unique_ptr<hnswlib::SpaceInterface<float>> _space;
-    std::unique_ptr<hnswlib::HierarchicalNSW<float>> _hnsw;
+
+    std::vector<std::unique_ptr<Shard>> _shards;
 };
 
 }
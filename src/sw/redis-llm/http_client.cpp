@@ -14,18 +14,25 @@
    limitations under the License.
  *************************************************************************/
 
+#include <algorithm>
+#include <cassert>
+#include "sw/redis-llm/cancel.h"
 #include "sw/redis-llm/errors.h"
 #include "sw/redis-llm/http_client.h"
+#include "sw/redis-llm/slowlog.h"
+#include "sw/redis-llm/stats.h"
 
 namespace {
 
-size_t write_callback(void *ptr, size_t size, size_t nmemb, std::string *res) {
-    auto len = size * nmemb;
-    auto *begin = static_cast<char *>(ptr);
-    auto *end = begin + len;
-    res->insert(res->end(), begin, end);
-    return len;
-}
+struct MultiDeleter {
+    void operator()(CURLM *multi) const {
+        if (multi != nullptr) {
+            curl_multi_cleanup(multi);
+        }
+    }
+};
+
+using Multi = std::unique_ptr<CURLM, MultiDeleter>;
 
 std::chrono::milliseconds parse_time(const std::string &str) {
     std::size_t timeout = 0;
@@ -56,6 +63,34 @@ std::chrono::milliseconds parse_time(const std::string &str) {
 
 namespace sw::redis::llm {
 
+// State of a post request in flight.
+struct HttpClient::Transfer {
+    CURL *handle = nullptr;
+
+    const std::function<void (const std::string_view &)> *on_data = nullptr;
+
+    long code = 0;
+
+    // Number of bytes received, including body of failed request.
+    std::size_t bytes = 0;
+
+    // Response body of failed request.
+    std::string error;
+
+    std::exception_ptr err;
+
+    // Token of the request making the call, or nullptr if it cannot be cancelled.
+    const CancelToken *token = nullptr;
+
+    std::string uri;
+
+    SList header;
+
+    // Points to the winner of a hedged post, i.e. the first transfer receiving a successful
+    // response. Null, if it's not a hedged post.
+    Transfer **winner = nullptr;
+};
+
 HttpClientOptions::HttpClientOptions(const nlohmann::json &conf) {
     auto iter = conf.find("uri");
     if (iter != conf.end()) {
@@ -127,35 +162,358 @@ std::string HttpClient::post(const std::string &path,
         const std::unordered_multimap<std::string, std::string> &headers,
         const std::string &body,
         const std::string &content_type) {
+    std::string response;
+    post(path, headers, body,
+            [&response](const std::string_view &data) { response.append(data.data(), data.size()); },
+            content_type);
+
+    return response;
+}
+
+void HttpClient::post(const std::string &path,
+        const std::unordered_multimap<std::string, std::string> &headers,
+        const std::string &body,
+        const std::function<void (const std::string_view &)> &on_data,
+        const std::string &content_type) {
+    Transfer xfer;
+    _prepare(xfer, path, headers, body, on_data, content_type);
+
+    auto res = curl_easy_perform(xfer.handle);
+
+    _complete(xfer, body.size(), res);
+}
+
+std::size_t HttpClient::hedged_post(std::vector<HttpAttempt> &attempts,
+        const std::string &body,
+        const std::function<void (const std::string_view &)> &on_data,
+        std::chrono::microseconds hedge_delay,
+        const std::string &content_type) {
+    assert(!attempts.empty());
+
+    auto multi = Multi(curl_multi_init());
+    if (!multi) {
+        throw Error("failed to create curl multi handle");
+    }
+
+    auto &stats = Stats::instance();
+
+    std::vector<std::unique_ptr<SafeClient>> clients(attempts.size());
+    std::vector<Transfer> transfers(attempts.size());
+    std::vector<std::chrono::steady_clock::time_point> start_times(attempts.size());
+    std::vector<bool> running(attempts.size(), false);
+    std::size_t next = 0;
+    Transfer *winner = nullptr;
+    std::exception_ptr last_err;
+
+    // Remove transfers from the multi handle, which aborts them if they're still in flight.
+    auto remove = [&](bool keep_winner) {
+        for (std::size_t idx = 0; idx != next; ++idx) {
+            if (running[idx] && !(keep_winner && &transfers[idx] == winner)) {
+                curl_multi_remove_handle(multi.get(), transfers[idx].handle);
+                running[idx] = false;
+            }
+        }
+    };
+
+    // Start the next attempt. If *wait* is false, and there's no free client, return false.
+    auto start = [&](bool wait) {
+        assert(next < attempts.size());
+
+        auto &attempt = attempts[next];
+        assert(attempt.pool != nullptr);
+
+        auto &pool = *(attempt.pool);
+        if (wait) {
+            clients[next] = std::make_unique<SafeClient>(pool);
+        } else {
+            auto cli = pool.try_fetch();
+            if (!cli) {
+                return false;
+            }
+            clients[next] = std::make_unique<SafeClient>(pool, std::move(*cli));
+        }
+
+        auto &xfer = transfers[next];
+        xfer.winner = &winner;
+        clients[next]->client()._prepare(xfer, attempt.path, attempt.headers, body, on_data, content_type);
+
+        if (curl_multi_add_handle(multi.get(), xfer.handle) != CURLM_OK) {
+            throw Error("failed to add curl handle");
+        }
+
+        running[next] = true;
+        start_times[next] = std::chrono::steady_clock::now();
+        attempt.started = true;
+        ++next;
+
+        return true;
+    };
+
+    try {
+        // It's safe to wait for a client, since no other client is held.
+        start(true);
+
+        auto pruned = false;
+        while (true) {
+            int still_running = 0;
+            if (curl_multi_perform(multi.get(), &still_running) != CURLM_OK) {
+                throw Error("failed to perform curl multi handle");
+            }
+
+            if (winner != nullptr && !pruned) {
+                // Stop others once one of them starts receiving a successful response.
+                remove(true);
+                pruned = true;
+            }
+
+            CURLMsg *msg = nullptr;
+            int msgs_left = 0;
+            while ((msg = curl_multi_info_read(multi.get(), &msgs_left)) != nullptr) {
+                if (msg->msg != CURLMSG_DONE) {
+                    continue;
+                }
+
+                std::size_t idx = 0;
+                while (idx != next && transfers[idx].handle != msg->easy_handle) {
+                    ++idx;
+                }
+                if (idx == next || !running[idx]) {
+                    continue;
+                }
+
+                curl_multi_remove_handle(multi.get(), msg->easy_handle);
+                running[idx] = false;
+
+                auto &attempt = attempts[idx];
+                try {
+                    clients[idx]->client()._complete(transfers[idx], body.size(), msg->data.result);
+                } catch (const HttpError &e) {
+                    if (winner == &transfers[idx] || !e.retryable()) {
+                        // Either part of the response has been consumed, or the request itself
+                        // is to blame, so it cannot fail over.
+                        attempt.failed = e.retryable();
+                        throw;
+                    }
+
+                    attempt.failed = true;
+                    last_err = std::current_exception();
+
+                    // Give the client back, so that failing over never waits for a client
+                    // while holding another one.
+                    clients[idx].reset();
+                    continue;
+                }
+
+                attempt.latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now() - start_times[idx]);
+
+                if (attempt.hedged) {
+                    stats.incr(Counter::HTTP_HEDGE_WINS);
+                }
+
+                winner = &transfers[idx];
+                remove(false);
+
+                return idx;
+            }
+
+            auto in_flight = std::count(running.begin(), running.end(), true);
+            if (in_flight == 0) {
+                if (next == attempts.size()) {
+                    assert(last_err);
+                    std::rethrow_exception(last_err);
+                }
+
+                // All running attempts failed, fail over to the next one.
+                stats.incr(Counter::HTTP_FAILOVERS);
+                start(true);
+                continue;
+            }
+
+            int timeout_ms = 1000;
+            if (winner == nullptr && next < attempts.size() && hedge_delay.count() > 0) {
+                auto elapsed = std::chrono::steady_clock::now() - start_times[next - 1];
+                if (elapsed >= hedge_delay) {
+                    // None responds in time, hedge with the next one. Never wait for a client
+                    // while holding others, which might deadlock with other hedged posts.
+                    if (start(false)) {
+                        stats.incr(Counter::HTTP_HEDGES);
+                        attempts[next - 1].hedged = true;
+                    } else {
+                        hedge_delay = std::chrono::microseconds(0);
+                    }
+                    continue;
+                }
+
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(hedge_delay - elapsed);
+                timeout_ms = std::min<int>(timeout_ms, left.count() + 1);
+            }
+
+            // Also wakes up for internal timers of curl.
+            curl_multi_wait(multi.get(), nullptr, 0, timeout_ms, nullptr);
+        }
+    } catch (...) {
+        remove(false);
+        throw;
+    }
+
+    // Never reach here.
+    return 0;
+}
+
+void HttpClient::_prepare(Transfer &xfer,
+        const std::string &path,
+        const std::unordered_multimap<std::string, std::string> &headers,
+        const std::string &body,
+        const std::function<void (const std::string_view &)> &on_data,
+        const std::string &content_type) {
     auto *handle = _cli.get();
+    xfer.handle = handle;
+    xfer.on_data = &on_data;
 
-    auto header = _build_header(content_type, headers);
-    _set_option(handle, CURLOPT_HTTPHEADER, header.get());
+    xfer.token = CancelToken::current();
+    if (xfer.token != nullptr) {
+        // Do not bother calling the provider, if client has already gone.
+        xfer.token->check();
+    }
+
+    xfer.header = _build_header(content_type, headers);
+    _set_option(handle, CURLOPT_HTTPHEADER, xfer.header.get());
     //_set_option(handle, CURLOPT_HEADEROPT, CURLHEADER_SEPARATE);
 
-    std::string uri = _opts.uri + path;
-    _set_option(handle, CURLOPT_URL, uri.data());
+    xfer.uri = _opts.uri + path;
+    _set_option(handle, CURLOPT_URL, xfer.uri.data());
 
     _set_option<long>(handle, CURLOPT_POSTFIELDSIZE, body.size());
     _set_option(handle, CURLOPT_POSTFIELDS, body.data());
-    _set_option(handle, CURLOPT_WRITEFUNCTION, write_callback);
+    _set_option(handle, CURLOPT_WRITEFUNCTION, _write_callback);
+    _set_option(handle, CURLOPT_WRITEDATA, &xfer);
 
-    std::string response;
-    _set_option(handle, CURLOPT_WRITEDATA, &response);
+    _set_option<long>(handle, CURLOPT_NOPROGRESS, xfer.token == nullptr ? 1L : 0L);
+    _set_option(handle, CURLOPT_XFERINFOFUNCTION, _progress_callback);
+    _set_option(handle, CURLOPT_XFERINFODATA, &xfer);
+
+    Stats::instance().incr(Counter::HTTP_REQUESTS);
+}
+
+void HttpClient::_complete(Transfer &xfer, std::size_t request_bytes, CURLcode res) {
+    auto *handle = xfer.handle;
+
+    _log_if_slow(handle, xfer.uri, request_bytes, xfer.bytes, res);
 
-    auto res = curl_easy_perform(handle);
+    auto &stats = Stats::instance();
     if (res != CURLE_OK) {
-        _cli.release();
-        throw Error(std::string("failed to do post: ") + curl_easy_strerror(res));
+        stats.incr(Counter::HTTP_ERRORS);
+
+        // The connection might be in a bad state, so close it. The pool reconnects broken clients.
+        _cli.reset();
+        xfer.handle = nullptr;
+
+        if (xfer.err) {
+            std::rethrow_exception(xfer.err);
+        }
+
+        if (res == CURLE_ABORTED_BY_CALLBACK) {
+            stats.incr(Counter::HTTP_CANCELLED);
+            throw CancelledError();
+        }
+
+        throw HttpError(std::string("failed to do post: ") + curl_easy_strerror(res), 0);
     }
 
     long code = 0;
     curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &code);
     if (code != 200) {
-        throw Error("failed to do post: " + response);
+        stats.incr(Counter::HTTP_ERRORS);
+        if (code == 429) {
+            stats.incr(Counter::HTTP_429);
+        }
+
+        throw HttpError("failed to do post: " + xfer.error, code);
     }
+}
 
-    return response;
+size_t HttpClient::_write_callback(char *ptr, size_t size, size_t nmemb, Transfer *xfer) {
+    auto len = size * nmemb;
+
+    xfer->bytes += len;
+
+    if (xfer->code == 0) {
+        curl_easy_getinfo(xfer->handle, CURLINFO_RESPONSE_CODE, &xfer->code);
+    }
+
+    if (xfer->code != 200) {
+        xfer->error.append(ptr, len);
+        return len;
+    }
+
+    if (xfer->winner != nullptr) {
+        if (*xfer->winner == nullptr) {
+            *xfer->winner = xfer;
+        } else if (*xfer->winner != xfer) {
+            // Another attempt of the hedged post has won, abort this one.
+            return 0;
+        }
+    }
+
+    try {
+        (*xfer->on_data)(std::string_view(ptr, len));
+    } catch (...) {
+        xfer->err = std::current_exception();
+
+        // Abort the transfer.
+        return 0;
+    }
+
+    return len;
+}
+
+// libcurl calls it at least once per second, even if no data is transferred.
+int HttpClient::_progress_callback(Transfer *xfer, curl_off_t /*dltotal*/, curl_off_t /*dlnow*/,
+        curl_off_t /*ultotal*/, curl_off_t /*ulnow*/) {
+    // Return non-zero to abort the transfer.
+    return xfer->token != nullptr && xfer->token->cancelled() ? 1 : 0;
+}
+
+void HttpClient::_log_if_slow(CURL *handle, const std::string &uri,
+        std::size_t request_bytes, std::size_t response_bytes, CURLcode res) const {
+    auto &slowlog = SlowLog::instance();
+
+    curl_off_t total = 0;
+    curl_easy_getinfo(handle, CURLINFO_TOTAL_TIME_T, &total);
+    if (!slowlog.slow(std::chrono::microseconds(total))) {
+        return;
+    }
+
+    SlowLogEntry entry;
+    entry.duration_us = total;
+    entry.command = SlowLog::current_command();
+    entry.uri = uri;
+    entry.request_bytes = request_bytes;
+    entry.response_bytes = response_bytes;
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &entry.status);
+    curl_easy_getinfo(handle, CURLINFO_REDIRECT_COUNT, &entry.redirects);
+
+    long connects = 0;
+    curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connects);
+    entry.connection_reused = (connects == 0);
+
+    // Timers are accumulated from the start of the transfer.
+    curl_off_t connect = 0;
+    curl_off_t app_connect = 0;
+    curl_off_t start_transfer = 0;
+    curl_easy_getinfo(handle, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(handle, CURLINFO_APPCONNECT_TIME_T, &app_connect);
+    curl_easy_getinfo(handle, CURLINFO_STARTTRANSFER_TIME_T, &start_transfer);
+    entry.connect_us = connect;
+    entry.tls_us = app_connect > connect ? app_connect - connect : 0;
+    entry.first_byte_us = start_transfer;
+
+    if (res != CURLE_OK) {
+        entry.error = curl_easy_strerror(res);
+    }
+
+    slowlog.add(std::move(entry));
 }
 
 HttpClient::SList HttpClient::_build_header(const std::string &content_type,
@@ -218,6 +576,10 @@ HttpClientPool::HttpClientPool(const HttpClientOptions &opts,
     // Lazily create connections.
 }
 
+HttpClientPool::~HttpClientPool() {
+    Stats::instance().incr(Counter::HTTP_CONNECTIONS, -static_cast<int64_t>(_used_connections));
+}
+
 HttpClientPool::HttpClientPool(HttpClientPool &&that) {
     std::lock_guard<std::mutex> lock(that._mutex);
 
@@ -237,14 +599,35 @@ HttpClientPool& HttpClientPool::operator=(HttpClientPool &&that) {
 }
 
 HttpClient HttpClientPool::fetch() {
+    auto cli = _acquire(true);
+    assert(cli);
+
+    return std::move(*cli);
+}
+
+std::optional<HttpClient> HttpClientPool::try_fetch() {
+    return _acquire(false);
+}
+
+std::optional<HttpClient> HttpClientPool::_acquire(bool wait) {
     std::unique_lock<std::mutex> lock(_mutex);
 
     if (_pool.empty()) {
         if (_used_connections == _pool_opts.size) {
+            if (!wait) {
+                return std::nullopt;
+            }
+
+            Stats::instance().incr(Counter::HTTP_POOL_WAITS);
             _wait_for_client(lock);
         } else {
             auto cli = HttpClient(_opts);
             ++_used_connections;
+
+            auto &stats = Stats::instance();
+            stats.incr(Counter::HTTP_CONNECTIONS);
+            stats.incr(Counter::HTTP_CONNECTIONS_IN_USE);
+
             return cli;
         }
     }
@@ -255,6 +638,8 @@ HttpClient HttpClientPool::fetch() {
 
     lock.unlock();
 
+    Stats::instance().incr(Counter::HTTP_CONNECTIONS_IN_USE);
+
     if (_need_reconnect(cli, lifetime)) {
         try {
             cli.reconnect();
@@ -268,6 +653,8 @@ HttpClient HttpClientPool::fetch() {
 }
 
 void HttpClientPool::release(HttpClient cli) {
+    Stats::instance().incr(Counter::HTTP_CONNECTIONS_IN_USE, -1);
+
     {
         std::lock_guard<std::mutex> lock(_mutex);
 
@@ -278,10 +665,14 @@ void HttpClientPool::release(HttpClient cli) {
 }
 
 void HttpClientPool::_move(HttpClientPool &&that) {
+    // Connections owned by this pool are closed with the old pool.
+    Stats::instance().incr(Counter::HTTP_CONNECTIONS, -static_cast<int64_t>(_used_connections));
+
     _opts = std::move(that._opts);
     _pool_opts = std::move(that._pool_opts);
     _pool = std::move(that._pool);
     _used_connections = std::move(that._used_connections);
+    that._used_connections = 0;
 }
 
 HttpClient HttpClientPool::_fetch() {
@@ -20,10 +20,15 @@
 #include <chrono>
 #include <condition_variable>
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include <curl/curl.h>
 #include "nlohmann/json.hpp"
 #include "sw/redis-llm/errors.h"
@@ -61,6 +66,31 @@ struct HttpClientPoolOptions {
     std::chrono::milliseconds connection_lifetime{0};
 };
 
+class HttpClientPool;
+
+// One of the alternative requests of HttpClient::hedged_post.
+struct HttpAttempt {
+    // A client is fetched from the pool only when the attempt starts.
+    HttpClientPool *pool = nullptr;
+
+    std::string path;
+
+    std::unordered_multimap<std::string, std::string> headers;
+
+    // The following are set by HttpClient::hedged_post.
+
+    bool started = false;
+
+    // Started because running attempts did not respond in time.
+    bool hedged = false;
+
+    // Failed with a retryable error, i.e. the endpoint is to blame. See HttpError::retryable.
+    bool failed = false;
+
+    // Time from starting the attempt to finishing it, if it wins.
+    std::chrono::microseconds latency{0};
+};
+
 class HttpClient {
 public:
     explicit HttpClient(const HttpClientOptions &opts);
@@ -72,6 +102,28 @@ public:
             const std::string &body,
             const std::string &content_type = "application/json");
 
+    // Feed response body to *on_data* as it arrives, instead of buffering the whole body.
+    // If *on_data* throws, the transfer is aborted, and the exception is rethrown.
+    void post(const std::string &path,
+            const std::unordered_multimap<std::string, std::string> &headers,
+            const std::string &body,
+            const std::function<void (const std::string_view &)> &on_data,
+            const std::string &content_type = "application/json");
+
+    // Post *body* with *attempts* concurrently in the calling thread, and feed response of
+    // the winner, i.e. the first attempt receiving a successful response, to *on_data*.
+    // Attempts start one by one. The next one starts once all running ones fail with
+    // retryable errors (fail over), or none of them responds within *hedge_delay* (hedge).
+    // 0 *hedge_delay* disables hedging. A hedge never waits for a client, and is skipped
+    // if its pool has no free client. Once there's a winner, others are aborted.
+    // Return index of the winner. Throw the last error, if all attempts fail, or the error
+    // of an attempt failing with a non-retryable error, e.g. the request is invalid.
+    static std::size_t hedged_post(std::vector<HttpAttempt> &attempts,
+            const std::string &body,
+            const std::function<void (const std::string_view &)> &on_data,
+            std::chrono::microseconds hedge_delay,
+            const std::string &content_type = "application/json");
+
     void reconnect() {
         _cli = _make_client();
     }
@@ -104,6 +156,23 @@ private:
     };
     using SList = std::unique_ptr<curl_slist, ListDeleter>;
 
+    struct Transfer;
+
+    void _prepare(Transfer &xfer,
+            const std::string &path,
+            const std::unordered_multimap<std::string, std::string> &headers,
+            const std::string &body,
+            const std::function<void (const std::string_view &)> &on_data,
+            const std::string &content_type);
+
+    // Throw Error, if the transfer failed.
+    void _complete(Transfer &xfer, std::size_t request_bytes, CURLcode res);
+
+    static size_t _write_callback(char *ptr, size_t size, size_t nmemb, Transfer *xfer);
+
+    static int _progress_callback(Transfer *xfer, curl_off_t dltotal, curl_off_t dlnow,
+            curl_off_t ultotal, curl_off_t ulnow);
+
     template <typename T>
     void _set_option(CURL *handle, CURLoption opt, T params) const {
         if (curl_easy_setopt(handle, opt, params) != CURLE_OK) {
@@ -114,6 +183,9 @@ private:
     SList _build_header(const std::string &content_type,
             std::unordered_multimap<std::string, std::string> headers) const;
 
+    void _log_if_slow(CURL *handle, const std::string &uri,
+            std::size_t request_bytes, std::size_t response_bytes, CURLcode res) const;
+
     Client _make_client() const;
 
     HttpClientOptions _opts;
@@ -133,8 +205,13 @@ public:
     HttpClientPool(HttpClientPool &&that);
     HttpClientPool& operator=(HttpClientPool &&that);
 
+    ~HttpClientPool();
+
     HttpClient fetch();
 
+    // Fetch a client without waiting. Return std::nullopt, if all clients are in use.
+    std::optional<HttpClient> try_fetch();
+
     void release(HttpClient cli);
 
 private:
@@ -146,6 +223,9 @@ private:
 
     HttpClient _fetch();
 
+    // Create or fetch a client. If *wait* is false, return std::nullopt instead of waiting.
+    std::optional<HttpClient> _acquire(bool wait);
+
     HttpClientOptions _opts;
 
     HttpClientPoolOptions _pool_opts;
@@ -165,6 +245,11 @@ public:
         assert(!_cli.broken());
     }
 
+    // Take over *cli* fetched from *pool*, and release it to *pool* on destruction.
+    SafeClient(HttpClientPool &pool, HttpClient cli) : _pool(pool), _cli(std::move(cli)) {
+        assert(!_cli.broken());
+    }
+
     SafeClient(const SafeClient &) = delete;
     SafeClient& operator=(const SafeClient &) = delete;
 
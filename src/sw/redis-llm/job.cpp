@@ -0,0 +1,137 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/job.h"
+#include <cassert>
+
+namespace sw::redis::llm {
+
+const char* job_status_name(JobStatus status) {
+    switch (status) {
+    case JobStatus::PENDING:
+        return "pending";
+
+    case JobStatus::RUNNING:
+        return "running";
+
+    case JobStatus::DONE:
+        return "done";
+
+    case JobStatus::FAILED:
+        return "failed";
+
+    default:
+        assert(false);
+        return "unknown";
+    }
+}
+
+JobManager& JobManager::instance() {
+    static JobManager manager;
+
+    return manager;
+}
+
+uint64_t JobManager::create() {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto id = ++_id;
+    _jobs.emplace(id, Job{});
+
+    return id;
+}
+
+void JobManager::start(uint64_t id) {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto iter = _jobs.find(id);
+    if (iter != _jobs.end()) {
+        iter->second.info.status = JobStatus::RUNNING;
+    }
+}
+
+void JobManager::finish(uint64_t id, std::optional<std::string> error) {
+    std::vector<RedisModuleBlockedClient *> waiters;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        auto iter = _jobs.find(id);
+        if (iter == _jobs.end()) {
+            return;
+        }
+
+        auto &job = iter->second;
+        if (error) {
+            job.info.status = JobStatus::FAILED;
+            job.info.error = std::move(*error);
+        } else {
+            job.info.status = JobStatus::DONE;
+        }
+
+        waiters.swap(job.waiters);
+
+        _finished.push_back(id);
+        while (_finished.size() > _MAX_FINISHED) {
+            _jobs.erase(_finished.front());
+            _finished.pop_front();
+        }
+    }
+
+    // Waiters reply with the latest job status. Clients timed out still need to be unblocked,
+    // so that Redis can release them.
+    for (auto *blocked_client : waiters) {
+        RedisModule_UnblockClient(blocked_client, nullptr);
+    }
+}
+
+std::optional<JobInfo> JobManager::info(uint64_t id) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto iter = _jobs.find(id);
+    if (iter == _jobs.end()) {
+        return std::nullopt;
+    }
+
+    return iter->second.info;
+}
+
+bool JobManager::wait(uint64_t id, RedisModuleBlockedClient *blocked_client) {
+    assert(blocked_client != nullptr);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto iter = _jobs.find(id);
+    if (iter == _jobs.end()) {
+        return false;
+    }
+
+    auto &job = iter->second;
+    if (job.info.status == JobStatus::DONE || job.info.status == JobStatus::FAILED) {
+        return false;
+    }
+
+    job.waiters.push_back(blocked_client);
+
+    return true;
+}
+
+std::size_t JobManager::in_flight() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return _jobs.size() - _finished.size();
+}
+
+}
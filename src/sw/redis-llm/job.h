@@ -0,0 +1,101 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SEWENEW_REDIS_LLM_JOB_H
+#define SEWENEW_REDIS_LLM_JOB_H
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "sw/redis-llm/redismodule.h"
+
+namespace sw::redis::llm {
+
+enum class JobStatus {
+    PENDING = 0,
+    RUNNING,
+    DONE,
+    FAILED
+};
+
+const char* job_status_name(JobStatus status);
+
+struct JobInfo {
+    JobStatus status = JobStatus::PENDING;
+
+    // Error message, if the job failed.
+    std::string error;
+};
+
+// Registry of async jobs, i.e. LLM.RUN with --ASYNC option. Jobs live in memory only,
+// and are lost after restart. Finished jobs are kept until there're more than
+// *max_finished* of them, and then the oldest ones are evicted.
+class JobManager {
+public:
+    static JobManager& instance();
+
+    JobManager(const JobManager &) = delete;
+    JobManager& operator=(const JobManager &) = delete;
+
+    JobManager(JobManager &&) = delete;
+    JobManager& operator=(JobManager &&) = delete;
+
+    // Create a pending job, and return its id.
+    uint64_t create();
+
+    void start(uint64_t id);
+
+    // Mark the job as done, or failed if *error* is set, and unblock clients waiting for it.
+    void finish(uint64_t id, std::optional<std::string> error = std::nullopt);
+
+    // Return std::nullopt, if the job does not exist.
+    std::optional<JobInfo> info(uint64_t id) const;
+
+    // Unblock *blocked_client* when the job finishes. Return false, if the job has
+    // already finished or does not exist, and the caller should reply immediately.
+    bool wait(uint64_t id, RedisModuleBlockedClient *blocked_client);
+
+    // Number of pending and running jobs.
+    std::size_t in_flight() const;
+
+private:
+    JobManager() = default;
+
+    struct Job {
+        JobInfo info;
+
+        std::vector<RedisModuleBlockedClient *> waiters;
+    };
+
+    static constexpr std::size_t _MAX_FINISHED = 10000;
+
+    mutable std::mutex _mutex;
+
+    uint64_t _id = 0;
+
+    std::unordered_map<uint64_t, Job> _jobs;
+
+    // Ids of finished jobs, oldest first.
+    std::deque<uint64_t> _finished;
+};
+
+}
+
+#endif // end SEWENEW_REDIS_LLM_JOB_H
@@ -0,0 +1,128 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/job_command.h"
+#include <cstring>
+#include "sw/redis-llm/errors.h"
+#include "sw/redis-llm/utils.h"
+
+namespace {
+
+void reply_string(RedisModuleCtx *ctx, const char *str) {
+    RedisModule_ReplyWithStringBuffer(ctx, str, std::strlen(str));
+}
+
+}
+
+namespace sw::redis::llm {
+
+void JobCommand::_run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) const {
+    auto args = _parse_args(argv, argc);
+
+    switch (args.op) {
+    case Op::STATUS:
+        _reply_info(ctx, args.id);
+        break;
+
+    case Op::WAIT: {
+        auto *blocked_client = RedisModule_BlockClient(ctx,
+                _reply_func, _reply_func, nullptr, args.timeout.count());
+        if (!JobManager::instance().wait(args.id, blocked_client)) {
+            // Already finished, or no such job.
+            RedisModule_AbortBlock(blocked_client);
+
+            _reply_info(ctx, args.id);
+        }
+        break;
+    }
+
+    default:
+        assert(false);
+        break;
+    }
+}
+
+JobCommand::Args JobCommand::_parse_args(RedisModuleString **argv, int argc) const {
+    assert(argv != nullptr);
+
+    if (argc < 3) {
+        throw WrongArityError();
+    }
+
+    Args args;
+
+    auto op = util::to_sv(argv[1]);
+    if (util::str_case_equal(op, "STATUS")) {
+        args.op = Op::STATUS;
+        if (argc != 3) {
+            throw WrongArityError();
+        }
+    } else if (util::str_case_equal(op, "WAIT")) {
+        args.op = Op::WAIT;
+        if (argc != 4) {
+            throw WrongArityError();
+        }
+
+        try {
+            args.timeout = std::chrono::milliseconds(std::stoul(util::to_string(argv[3])));
+        } catch (const std::exception &e) {
+            throw Error(std::string("invalid timeout: ") + e.what());
+        }
+    } else {
+        throw Error("unknown operation: " + std::string(op));
+    }
+
+    args.id = _parse_id(argv[2]);
+
+    return args;
+}
+
+uint64_t JobCommand::_parse_id(RedisModuleString *id) {
+    try {
+        return std::stoull(util::to_string(id));
+    } catch (const std::exception &e) {
+        throw Error(std::string("invalid job id: ") + e.what());
+    }
+}
+
+void JobCommand::_reply_info(RedisModuleCtx *ctx, uint64_t id) {
+    auto info = JobManager::instance().info(id);
+    if (!info) {
+        RedisModule_ReplyWithNull(ctx);
+        return;
+    }
+
+    auto failed = info->status == JobStatus::FAILED;
+    RedisModule_ReplyWithArray(ctx, failed ? 4 : 2);
+
+    reply_string(ctx, "status");
+    reply_string(ctx, job_status_name(info->status));
+
+    if (failed) {
+        reply_string(ctx, "error");
+        RedisModule_ReplyWithStringBuffer(ctx, info->error.data(), info->error.size());
+    }
+}
+
+int JobCommand::_reply_func(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
+    assert(argv != nullptr && argc == 4);
+
+    _reply_info(ctx, _parse_id(argv[2]));
+
+    return REDISMODULE_OK;
+}
+
+}
@@ -0,0 +1,61 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SEWENEW_REDIS_LLM_JOB_COMMAND_H
+#define SEWENEW_REDIS_LLM_JOB_COMMAND_H
+
+#include <chrono>
+#include <cstdint>
+#include "sw/redis-llm/module_api.h"
+#include "sw/redis-llm/command.h"
+#include "sw/redis-llm/job.h"
+
+namespace sw::redis::llm {
+
+// LLM.JOB STATUS job-id
+// LLM.JOB WAIT job-id timeout-in-milliseconds
+// Inspect or wait for async jobs created by LLM.RUN --ASYNC.
+class JobCommand : public Command {
+private:
+    virtual void _run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) const override;
+
+    enum class Op {
+        STATUS,
+        WAIT
+    };
+
+    struct Args {
+        Op op = Op::STATUS;
+
+        uint64_t id = 0;
+
+        // 0 means wait forever.
+        std::chrono::milliseconds timeout{0};
+    };
+
+    Args _parse_args(RedisModuleString **argv, int argc) const;
+
+    static uint64_t _parse_id(RedisModuleString *id);
+
+    static void _reply_info(RedisModuleCtx *ctx, uint64_t id);
+
+    // Reply with the latest status, whether the job finished or the client timed out.
+    static int _reply_func(RedisModuleCtx *ctx, RedisModuleString **argv, int argc);
+};
+
+}
+
+#endif // end SEWENEW_REDIS_LLM_JOB_COMMAND_H
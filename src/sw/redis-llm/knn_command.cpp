@@ -15,9 +15,12 @@
  *************************************************************************/
 
 #include "sw/redis-llm/knn_command.h"
+#include "sw/redis-llm/cancel.h"
 #include "sw/redis-llm/llm_model.h"
 #include "sw/redis-llm/module_api.h"
 #include "sw/redis-llm/redis_llm.h"
+#include "sw/redis-llm/slowlog.h"
+#include "sw/redis-llm/stats.h"
 #include "sw/redis-llm/utils.h"
 
 namespace sw::redis::llm {
@@ -49,10 +52,14 @@ void KnnCommand::_run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) c
     }
 
     auto *blocked_client = RedisModule_BlockClient(ctx, _reply_func, _timeout_func, _free_func, args.timeout.count());
+    auto &registry = CancelRegistry::instance();
+    auto token = registry.watch(blocked_client);
 
     try {
-        llm.worker_pool().enqueue(&KnnCommand::_knn, this, blocked_client, args, vector_store, llm_model);
+        llm.worker_pool().enqueue(_blocking_task_options(args.start, args.timeout, token),
+                &KnnCommand::_knn, this, blocked_client, args, vector_store, llm_model, token);
     } catch (const Error &err) {
+        registry.unwatch(blocked_client);
         RedisModule_AbortBlock(blocked_client);
 
         api::reply_with_error(ctx, err);
@@ -60,11 +67,24 @@ void KnnCommand::_run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) c
 }
 
 void KnnCommand::_knn(RedisModuleBlockedClient *blocked_client,
-        const Args &args, const VectorStoreSPtr &store, const LlmModelSPtr &model) const {
-    assert(blocked_client != nullptr && store);
+        const Args &args, const VectorStoreSPtr &store, const LlmModelSPtr &model,
+        const CancelTokenSPtr &token) const {
+    assert(blocked_client != nullptr && store && token);
 
     auto result = std::make_unique<AsyncResult>();
+    result->start = args.start;
+    if (args.profile) {
+        result->profile = std::make_unique<Profile>();
+        result->profile->record_since("queue", args.start);
+    }
+
+    ProfileScope scope(result->profile.get());
+    SlowLogScope slowlog_scope(args.origin);
+    CancelScope cancel_scope(token.get());
     try {
+        // Client timed out or disconnected while the task was queued.
+        token->check();
+
         if (args.embedding.empty()) {
             assert(model && !args.query.empty());
 
@@ -74,10 +94,16 @@ void KnnCommand::_knn(RedisModuleBlockedClient *blocked_client,
         } else {
             result->neighbors = store->knn(args.embedding, args.k);
         }
+    } catch (const CancelledError &) {
+        Stats::instance().incr(Counter::TASKS_CANCELLED);
+        result->err = std::current_exception();
     } catch (const Error &) {
         result->err = std::current_exception();
     }
 
+    CancelRegistry::instance().unwatch(blocked_client);
+
+    result->unblock_time = std::chrono::steady_clock::now();
     RedisModule_UnblockClient(blocked_client, result.release());
 }
 
@@ -90,6 +116,7 @@ KnnCommand::Args KnnCommand::_parse_args(RedisModuleString **argv, int argc) con
 
     Args args;
     args.key_name = argv[1];
+    args.origin = SlowLog::origin("LLM.KNN", args.key_name);
 
     auto idx = 2;
     while (idx < argc) {
@@ -110,6 +137,8 @@ KnnCommand::Args KnnCommand::_parse_args(RedisModuleString **argv, int argc) con
             }
             ++idx;
             args.embedding = util::parse_embedding(util::to_sv(argv[idx]));
+        } else if (util::str_case_equal(opt, "--PROFILE")) {
+            args.profile = true;
         } else if (util::str_case_equal(opt, "--TIMEOUT")) {
             if (idx + 1 >= argc) {
                 throw Error("syntax error");
@@ -143,6 +172,13 @@ int KnnCommand::_reply_func(RedisModuleCtx *ctx, RedisModuleString **argv, int a
     auto *res = static_cast<AsyncResult *>(RedisModule_GetBlockedClientPrivateData(ctx));
     assert(res != nullptr);
 
+    LatencyTimer timer(Latency::REPLY);
+
+    auto &profile = res->profile;
+    if (profile) {
+        profile->begin_reply(ctx, res->unblock_time);
+    }
+
     if (res->err) {
         try {
             std::rethrow_exception(res->err);
@@ -159,10 +195,19 @@ int KnnCommand::_reply_func(RedisModuleCtx *ctx, RedisModuleString **argv, int a
         }
     }
 
+    Stats::instance().record_since(Latency::CMD_KNN, res->start);
+
+    if (profile) {
+        profile->end_reply(ctx, res->start);
+    }
+
     return REDISMODULE_OK;
 }
 
 int KnnCommand::_timeout_func(RedisModuleCtx *ctx, RedisModuleString ** /*argv*/, int /*argc*/) {
+    // Client gets nothing from the task any more, so give it up.
+    CancelRegistry::instance().cancel(ctx);
+
     return RedisModule_ReplyWithNull(ctx);
 }
 
@@ -15,38 +15,20 @@
  *************************************************************************/
 
 #include "sw/redis-llm/llama_cpp.h"
-#include "sw/redis-llm/errors.h"
 
 namespace sw::redis::llm {
 
-LlamaCpp::LlamaCpp(const nlohmann::json &conf) :
-    LlmModel("llamacpp", conf),
-    _opts(_parse_options(conf)) {}
+LlamaCpp::LlamaCpp(const nlohmann::json &conf) : OpenAi("llamacpp", conf, _llama_cpp_defaults()) {}
 
-std::vector<float> LlamaCpp::embedding(const std::string_view &input, const nlohmann::json &params) {
-    return {};
-}
-
-std::string LlamaCpp::predict(const std::string_view &input, const nlohmann::json &params) {
-    return "";
-}
-
-std::string LlamaCpp::chat(const std::string_view &input,
-        const std::string &history_summary,
-        const nlohmann::json &recent_history,
-        const nlohmann::json &params) {
-    return "";
-}
+auto LlamaCpp::_llama_cpp_defaults() -> Defaults {
+    Defaults defaults;
 
-LlamaCpp::Options LlamaCpp::_parse_options(const nlohmann::json &conf) const {
-    Options opts;
-    try {
-        opts.sub_type = conf.at("sub_type").get<std::string>();
-    } catch (const nlohmann::json::exception &e) {
-        throw Error(std::string("failed to parse llama options: ") + e.what());
-    }
+    // llama-server listens on port 8080 by default, and serves the loaded model no matter
+    // which model is specified. Also it requires no API key, unless started with --api-key.
+    defaults.uri = "http://127.0.0.1:8080";
+    defaults.api_key_required = false;
 
-    return opts;
+    return defaults;
 }
 
 }
@@ -18,33 +18,20 @@
 #define SEWENEW_REDIS_LLM_LLAMA_CPP_H
 
 #include "nlohmann/json.hpp"
-#include "sw/redis-llm/llm_model.h"
+#include "sw/redis-llm/openai.h"
 
 namespace sw::redis::llm {
 
-class LlamaCpp : public LlmModel {
+// Local model served by llama.cpp's server, i.e. llama-server, which loads a GGUF model
+// and runs it with continuous batching, so that concurrent requests share forward passes.
+// The server should run on the same host, and listen on loopback interface. Since
+// llama-server exposes an OpenAI compatible API, requests are sent the same way as OpenAi.
+class LlamaCpp : public OpenAi {
 public:
     explicit LlamaCpp(const nlohmann::json &conf);
 
-    virtual std::vector<float> embedding(const std::string_view &input,
-            const nlohmann::json &params = nlohmann::json::object()) override;
-
-    virtual std::string predict(const std::string_view &input,
-            const nlohmann::json &params = nlohmann::json::object()) override;
-
-    virtual std::string chat(const std::string_view &input,
-            const std::string &history_summary,
-            const nlohmann::json &recent_history,
-            const nlohmann::json &params = nlohmann::json::object()) override;
-
 private:
-    struct Options {
-        std::string sub_type;
-    };
-
-    Options _parse_options(const nlohmann::json &conf) const;
-
-    Options _opts;
+    static Defaults _llama_cpp_defaults();
 };
 
 }
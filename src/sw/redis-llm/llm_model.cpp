@@ -18,6 +18,7 @@
 #include <cassert>
 #include "sw/redis-llm/azure_openai.h"
 #include "sw/redis-llm/errors.h"
+#include "sw/redis-llm/mock_model.h"
 #include "sw/redis-llm/openai.h"
 #include "sw/redis-llm/llama_cpp.h"
 
@@ -27,6 +28,7 @@ LlmModelFactory::LlmModelFactory() {
     _register("openai", std::make_unique<LlmModelCreatorTpl<OpenAi>>());
     _register("llamacpp", std::make_unique<LlmModelCreatorTpl<LlamaCpp>>());
     _register("azure_openai", std::make_unique<LlmModelCreatorTpl<AzureOpenAi>>());
+    _register("mock", std::make_unique<LlmModelCreatorTpl<MockModel>>());
 }
 
 LlmModelSPtr LlmModelFactory::create(const std::string &type, const nlohmann::json &conf) const {
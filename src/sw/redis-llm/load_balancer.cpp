@@ -0,0 +1,263 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/load_balancer.h"
+#include <algorithm>
+#include <cassert>
+#include "sw/redis-llm/errors.h"
+
+namespace {
+
+// Weight of the latest sample in the moving average.
+constexpr double EWMA_ALPHA = 0.2;
+
+// Do not hedge with p95 latency of too few samples.
+constexpr uint64_t MIN_HEDGE_SAMPLES = 20;
+
+// Halve the histogram once it has this number of samples, so that it follows recent latencies.
+constexpr uint64_t LATENCY_DECAY_SAMPLES = 1024;
+
+}
+
+namespace sw::redis::llm {
+
+LoadBalancerOptions::LoadBalancerOptions(const nlohmann::json &conf) {
+    try {
+        auto name = conf.value<std::string>("policy", "ewma");
+        if (name == "ewma") {
+            policy = Policy::EWMA;
+        } else if (name == "least_outstanding") {
+            policy = Policy::LEAST_OUTSTANDING;
+        } else {
+            throw Error("unknown routing policy: " + name);
+        }
+
+        max_attempts = conf.value<std::size_t>("max_attempts", 2);
+        hedge = conf.value<bool>("hedge", false);
+        hedge_delay = std::chrono::milliseconds(conf.value<std::size_t>("hedge_delay", 0));
+        fail_timeout = std::chrono::milliseconds(conf.value<std::size_t>("fail_timeout", 10000));
+    } catch (const nlohmann::json::exception &e) {
+        throw Error(std::string("invalid routing options: ") + e.what());
+    }
+
+    if (max_attempts == 0) {
+        throw Error("max_attempts of routing should be positive");
+    }
+}
+
+LoadBalancer::LoadBalancer(const LoadBalancerOptions &opts,
+        const std::vector<EndpointOptions> &endpoints) : _opts(opts) {
+    if (endpoints.empty()) {
+        throw Error("no endpoint is specified");
+    }
+
+    for (const auto &endpoint : endpoints) {
+        _endpoints.push_back(std::make_unique<Endpoint>(endpoint));
+    }
+}
+
+void LoadBalancer::post(const PathFunc &path, const std::string &body,
+        const std::function<void (const std::string_view &)> &on_data) {
+    auto plan = _plan();
+    assert(!plan.empty());
+
+    if (plan.size() == 1) {
+        _post(plan.front(), path, body, on_data);
+    } else {
+        _hedged_post(plan, path, body, on_data);
+    }
+}
+
+std::vector<std::size_t> LoadBalancer::_plan() {
+    struct Candidate {
+        std::size_t idx;
+
+        bool down;
+
+        double score;
+    };
+
+    auto now = std::chrono::steady_clock::now();
+    auto size = _endpoints.size();
+    auto start = _next.fetch_add(1, std::memory_order_relaxed);
+
+    std::vector<Candidate> candidates;
+    candidates.reserve(size);
+    for (std::size_t offset = 0; offset != size; ++offset) {
+        auto idx = (start + offset) % size;
+        auto &endpoint = *_endpoints[idx];
+        auto outstanding = static_cast<double>(endpoint.outstanding.load(std::memory_order_relaxed));
+
+        std::lock_guard<std::mutex> lock(endpoint.mtx);
+
+        auto score = outstanding;
+        if (_opts.policy == LoadBalancerOptions::Policy::EWMA) {
+            // Endpoints without samples score 0, so that they're probed first.
+            score = endpoint.ewma_us * (outstanding + 1);
+        }
+
+        candidates.push_back(Candidate{idx, now < endpoint.down_until, score});
+    }
+
+    // Keep the rotated order for ties.
+    std::stable_sort(candidates.begin(), candidates.end(),
+            [](const Candidate &lhs, const Candidate &rhs) {
+                if (lhs.down != rhs.down) {
+                    return rhs.down;
+                }
+
+                return lhs.score < rhs.score;
+            });
+
+    std::vector<std::size_t> plan;
+    for (std::size_t idx = 0; idx != std::min(size, _opts.max_attempts); ++idx) {
+        plan.push_back(candidates[idx].idx);
+    }
+
+    return plan;
+}
+
+std::chrono::microseconds LoadBalancer::_hedge_delay(Endpoint &endpoint) {
+    if (!_opts.hedge) {
+        return std::chrono::microseconds(0);
+    }
+
+    if (_opts.hedge_delay.count() > 0) {
+        return _opts.hedge_delay;
+    }
+
+    std::lock_guard<std::mutex> lock(endpoint.mtx);
+
+    if (endpoint.latencies.count < MIN_HEDGE_SAMPLES) {
+        return std::chrono::microseconds(0);
+    }
+
+    return std::chrono::microseconds(endpoint.latencies.percentile(0.95));
+}
+
+void LoadBalancer::_post(std::size_t idx, const PathFunc &path, const std::string &body,
+        const std::function<void (const std::string_view &)> &on_data) {
+    auto &endpoint = *_endpoints[idx];
+
+    endpoint.outstanding.fetch_add(1, std::memory_order_relaxed);
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        SafeClient cli(endpoint.pool);
+        cli.client().post(path(idx), endpoint.headers, body, on_data);
+    } catch (const HttpError &e) {
+        endpoint.outstanding.fetch_sub(1, std::memory_order_relaxed);
+        if (e.retryable()) {
+            _fail(endpoint);
+        }
+        throw;
+    } catch (...) {
+        endpoint.outstanding.fetch_sub(1, std::memory_order_relaxed);
+        throw;
+    }
+
+    endpoint.outstanding.fetch_sub(1, std::memory_order_relaxed);
+    _succeed(endpoint, std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start));
+}
+
+void LoadBalancer::_hedged_post(const std::vector<std::size_t> &plan, const PathFunc &path,
+        const std::string &body, const std::function<void (const std::string_view &)> &on_data) {
+    assert(plan.size() > 1);
+
+    std::vector<HttpAttempt> attempts;
+    for (auto idx : plan) {
+        auto &endpoint = *_endpoints[idx];
+
+        HttpAttempt attempt;
+        attempt.pool = &endpoint.pool;
+        attempt.path = path(idx);
+        attempt.headers = endpoint.headers;
+        attempts.push_back(std::move(attempt));
+    }
+
+    auto &primary = *_endpoints[plan.front()];
+    auto hedge_delay = _hedge_delay(primary);
+
+    // Only the primary is counted, since the others might not start at all.
+    primary.outstanding.fetch_add(1, std::memory_order_relaxed);
+
+    std::exception_ptr err;
+    std::size_t winner = plan.size();
+    try {
+        winner = HttpClient::hedged_post(attempts, body, on_data, hedge_delay);
+    } catch (...) {
+        err = std::current_exception();
+    }
+
+    primary.outstanding.fetch_sub(1, std::memory_order_relaxed);
+
+    for (std::size_t idx = 0; idx != attempts.size(); ++idx) {
+        auto &endpoint = *_endpoints[plan[idx]];
+        const auto &attempt = attempts[idx];
+        if (idx == winner) {
+            _succeed(endpoint, attempt.latency);
+        } else if (attempt.failed) {
+            _fail(endpoint);
+        }
+    }
+
+    if (err) {
+        std::rethrow_exception(err);
+    }
+}
+
+void LoadBalancer::_succeed(Endpoint &endpoint, std::chrono::microseconds latency) {
+    auto us = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+
+    std::lock_guard<std::mutex> lock(endpoint.mtx);
+
+    if (endpoint.ewma_us == 0) {
+        endpoint.ewma_us = us;
+    } else {
+        endpoint.ewma_us += EWMA_ALPHA * (us - endpoint.ewma_us);
+    }
+
+    auto &hist = endpoint.latencies;
+    if (hist.count >= LATENCY_DECAY_SAMPLES) {
+        hist.count = 0;
+        hist.max = 0;
+        for (std::size_t idx = 0; idx != Histogram::BUCKETS; ++idx) {
+            hist.buckets[idx] /= 2;
+            hist.count += hist.buckets[idx];
+            if (hist.buckets[idx] > 0) {
+                hist.max = Histogram::value(idx);
+            }
+        }
+        hist.sum /= 2;
+    }
+
+    ++hist.buckets[Histogram::bucket(us)];
+    ++hist.count;
+    hist.sum += us;
+    hist.max = std::max(hist.max, us);
+
+    // Healthy again.
+    endpoint.down_until = {};
+}
+
+void LoadBalancer::_fail(Endpoint &endpoint) {
+    std::lock_guard<std::mutex> lock(endpoint.mtx);
+
+    endpoint.down_until = std::chrono::steady_clock::now() + _opts.fail_timeout;
+}
+
+}
@@ -0,0 +1,134 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SEWENEW_REDIS_LLM_LOAD_BALANCER_H
+#define SEWENEW_REDIS_LLM_LOAD_BALANCER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "nlohmann/json.hpp"
+#include "sw/redis-llm/http_client.h"
+#include "sw/redis-llm/stats.h"
+
+namespace sw::redis::llm {
+
+struct LoadBalancerOptions {
+    LoadBalancerOptions() = default;
+
+    explicit LoadBalancerOptions(const nlohmann::json &conf);
+
+    enum class Policy {
+        // Prefer endpoint with the lowest moving average latency, weighted by outstanding requests.
+        EWMA,
+        // Prefer endpoint with the fewest outstanding requests.
+        LEAST_OUTSTANDING
+    };
+
+    Policy policy = Policy::EWMA;
+
+    // Max number of endpoints a request tries, either to fail over or to hedge.
+    std::size_t max_attempts = 2;
+
+    bool hedge = false;
+
+    // Send a hedged request to the next endpoint, if the running one does not respond in time.
+    // 0 means the p95 latency of the running endpoint.
+    std::chrono::milliseconds hedge_delay{0};
+
+    // Avoid an endpoint for this long, after it fails a request with a transport error,
+    // 429 or 5xx, i.e. a retryable HttpError.
+    std::chrono::milliseconds fail_timeout{10000};
+};
+
+// Route requests of a model to multiple endpoints, e.g. regions, API keys or deployments,
+// so that load spreads past per-key rate limits. A request failed with a retryable error
+// fails over to the next endpoint, and an optional hedged request cuts tail latency.
+class LoadBalancer {
+public:
+    struct EndpointOptions {
+        HttpClientOptions http_opts;
+
+        HttpClientPoolOptions pool_opts;
+
+        // Extra headers sent to this endpoint, e.g. API key.
+        std::unordered_multimap<std::string, std::string> headers;
+    };
+
+    LoadBalancer(const LoadBalancerOptions &opts, const std::vector<EndpointOptions> &endpoints);
+
+    // Return path of the request on the given endpoint.
+    using PathFunc = std::function<std::string (std::size_t endpoint)>;
+
+    void post(const PathFunc &path, const std::string &body,
+            const std::function<void (const std::string_view &)> &on_data);
+
+private:
+    struct Endpoint {
+        explicit Endpoint(const EndpointOptions &opts) :
+            pool(opts.http_opts, opts.pool_opts), headers(opts.headers) {}
+
+        HttpClientPool pool;
+
+        std::unordered_multimap<std::string, std::string> headers;
+
+        std::atomic<long> outstanding{0};
+
+        // Protect the following routing states.
+        std::mutex mtx;
+
+        // Moving average of latency in microseconds. 0, if there's no sample.
+        double ewma_us = 0;
+
+        // Recent latencies, which decay periodically.
+        Histogram latencies;
+
+        std::chrono::steady_clock::time_point down_until{};
+    };
+
+    // Indexes of endpoints to try in order.
+    std::vector<std::size_t> _plan();
+
+    std::chrono::microseconds _hedge_delay(Endpoint &endpoint);
+
+    void _post(std::size_t idx, const PathFunc &path, const std::string &body,
+            const std::function<void (const std::string_view &)> &on_data);
+
+    void _hedged_post(const std::vector<std::size_t> &plan, const PathFunc &path,
+            const std::string &body, const std::function<void (const std::string_view &)> &on_data);
+
+    void _succeed(Endpoint &endpoint, std::chrono::microseconds latency);
+
+    void _fail(Endpoint &endpoint);
+
+    LoadBalancerOptions _opts;
+
+    std::vector<std::unique_ptr<Endpoint>> _endpoints;
+
+    // Rotate the start of plans, so that endpoints with the same score share load.
+    std::atomic<std::size_t> _next{0};
+};
+
+}
+
+#endif // end SEWENEW_REDIS_LLM_LOAD_BALANCER_H
@@ -0,0 +1,95 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/madd_command.h"
+#include <algorithm>
+#include "sw/redis-llm/module_api.h"
+#include "sw/redis-llm/redis_llm.h"
+#include "sw/redis-llm/vector_store.h"
+#include "sw/redis-llm/utils.h"
+
+namespace sw::redis::llm {
+
+void MaddCommand::_run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) const {
+    auto args = _parse_args(argv, argc);
+
+    auto cnt = _madd(ctx, args);
+
+    RedisModule_ReplyWithLongLong(ctx, cnt);
+
+    RedisModule_ReplicateVerbatim(ctx);
+}
+
+std::size_t MaddCommand::_madd(RedisModuleCtx *ctx, const Args &args) const {
+    auto *store = api::get_value_by_key<VectorStore>(ctx, args.key_name,
+            RedisLlm::instance().vector_store_type(), api::KeyMode::READWRITE);
+    if (store == nullptr) {
+        throw Error("vector store does not exist");
+    }
+
+    auto items = util::parse_batch(args.batch, store->dim());
+    uint64_t max_id = 0;
+    for (std::size_t idx = 0; idx != items.size(); ++idx) {
+        const auto &item = items[idx];
+        try {
+            store->add(item.id, item.data, item.embedding);
+        } catch (const Error &) {
+            // Some shard might be full. Items already added should be replicated.
+            store->update_id_idx(max_id);
+            _replicate_prefix(ctx, args, items, idx);
+
+            throw;
+        }
+
+        max_id = std::max(max_id, item.id);
+    }
+
+    // Items might be created with auto generated ids on master, or before AOF rewrite.
+    store->update_id_idx(max_id);
+
+    return items.size();
+}
+
+void MaddCommand::_replicate_prefix(RedisModuleCtx *ctx, const Args &args,
+        const std::vector<util::BatchItem> &items, std::size_t cnt) const {
+    if (cnt == 0) {
+        return;
+    }
+
+    std::string batch;
+    for (std::size_t idx = 0; idx != cnt; ++idx) {
+        const auto &item = items[idx];
+        util::append_batch_item(batch, item.id, item.data, item.embedding);
+    }
+
+    RedisModule_Replicate(ctx, "LLM.MADD", "sb", args.key_name, batch.data(), batch.size());
+}
+
+MaddCommand::Args MaddCommand::_parse_args(RedisModuleString **argv, int argc) const {
+    assert(argv != nullptr);
+
+    if (argc != 3) {
+        throw WrongArityError();
+    }
+
+    Args args;
+    args.key_name = argv[1];
+    args.batch = util::to_sv(argv[2]);
+
+    return args;
+}
+
+}
@@ -0,0 +1,195 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/mock_model.h"
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include "sw/redis-llm/errors.h"
+#include "sw/redis-llm/stats.h"
+#include "sw/redis-llm/utils.h"
+
+namespace {
+
+uint64_t fnv1a(const std::string_view &input) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (auto c : input) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+uint64_t splitmix64(uint64_t &state) {
+    auto z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+std::mt19937_64& random_engine() {
+    thread_local std::mt19937_64 engine(std::random_device{}());
+    return engine;
+}
+
+}
+
+namespace sw::redis::llm {
+
+MockModel::MockModel(const nlohmann::json &conf) :
+    LlmModel("mock", conf),
+    _opts(_parse_options(conf)) {}
+
+std::vector<float> MockModel::embedding(const std::string_view &input, const nlohmann::json &params) {
+    LatencyTimer timer(Latency::EMBEDDING);
+
+    _simulate();
+
+    // Generate a unit vector from hash of the input, which is stable across platforms.
+    auto state = fnv1a(input);
+    Vector embedding(_opts.dim);
+    double norm = 0;
+    for (auto &ele : embedding) {
+        ele = static_cast<float>(splitmix64(state) >> 40) / (1 << 23) - 1.0f;
+        norm += ele * ele;
+    }
+
+    if (norm > 0) {
+        auto scale = static_cast<float>(1 / std::sqrt(norm));
+        for (auto &ele : embedding) {
+            ele *= scale;
+        }
+    }
+
+    return embedding;
+}
+
+std::string MockModel::predict(const std::string_view &input, const nlohmann::json &params) {
+    LatencyTimer timer(Latency::PREDICT);
+
+    _simulate();
+
+    return _opts.response;
+}
+
+std::string MockModel::chat(const std::string_view &input,
+        const std::string &history_summary,
+        const nlohmann::json &recent_history,
+        const nlohmann::json &params) {
+    LatencyTimer timer(Latency::PREDICT);
+
+    _simulate();
+
+    return _opts.response;
+}
+
+void MockModel::_simulate() {
+    auto &engine = random_engine();
+
+    const auto &latency = _opts.latency;
+    double ms = 0;
+    switch (latency.distribution) {
+    case Distribution::CONSTANT:
+        ms = latency.mean;
+        break;
+
+    case Distribution::UNIFORM:
+        ms = std::uniform_real_distribution<double>(latency.min, latency.max)(engine);
+        break;
+
+    case Distribution::NORMAL:
+        ms = std::normal_distribution<double>(latency.mean, latency.stddev)(engine);
+        break;
+
+    case Distribution::EXPONENTIAL:
+        if (latency.mean > 0) {
+            ms = std::exponential_distribution<double>(1 / latency.mean)(engine);
+        }
+        break;
+
+    default:
+        assert(false);
+        break;
+    }
+
+    if (ms > 0) {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms));
+    }
+
+    if (_opts.error_rate > 0 && std::uniform_real_distribution<double>(0, 1)(engine) < _opts.error_rate) {
+        throw Error("mock model error");
+    }
+}
+
+MockModel::Options MockModel::_parse_options(const nlohmann::json &conf) const {
+    Options opts;
+    try {
+        // {"dim": 1536, "response": "", "error_rate": 0, "latency": {"distribution": "constant", "mean": 0, "stddev": 0, "min": 0, "max": 0}}
+        opts.dim = conf.value<std::size_t>("dim", opts.dim);
+        if (opts.dim == 0) {
+            throw Error("dim should be positive");
+        }
+
+        opts.response = conf.value<std::string>("response", opts.response);
+
+        opts.error_rate = conf.value<double>("error_rate", opts.error_rate);
+        if (opts.error_rate < 0 || opts.error_rate > 1) {
+            throw Error("error_rate should be in range [0, 1]");
+        }
+
+        auto iter = conf.find("latency");
+        if (iter != conf.end()) {
+            opts.latency = _parse_latency_options(iter.value());
+        }
+    } catch (const nlohmann::json::exception &e) {
+        throw Error(std::string("failed to parse mock options: ") + e.what() + ":" + conf.dump());
+    }
+
+    return opts;
+}
+
+auto MockModel::_parse_latency_options(const nlohmann::json &conf) const -> LatencyOptions {
+    LatencyOptions opts;
+
+    auto distribution = conf.value<std::string>("distribution", "constant");
+    if (distribution == "constant") {
+        opts.distribution = Distribution::CONSTANT;
+    } else if (distribution == "uniform") {
+        opts.distribution = Distribution::UNIFORM;
+    } else if (distribution == "normal") {
+        opts.distribution = Distribution::NORMAL;
+    } else if (distribution == "exponential") {
+        opts.distribution = Distribution::EXPONENTIAL;
+    } else {
+        throw Error("unknown latency distribution: " + distribution);
+    }
+
+    opts.mean = conf.value<double>("mean", 0);
+    opts.stddev = conf.value<double>("stddev", 0);
+    opts.min = conf.value<double>("min", 0);
+    opts.max = conf.value<double>("max", 0);
+
+    if (opts.mean < 0 || opts.stddev < 0 || opts.min < 0 || opts.max < opts.min) {
+        throw Error("invalid latency options: " + conf.dump());
+    }
+
+    return opts;
+}
+
+}
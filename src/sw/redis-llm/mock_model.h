@@ -0,0 +1,88 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SEWENEW_REDIS_LLM_MOCK_MODEL_H
+#define SEWENEW_REDIS_LLM_MOCK_MODEL_H
+
+#include <string>
+#include "nlohmann/json.hpp"
+#include "sw/redis-llm/llm_model.h"
+
+namespace sw::redis::llm {
+
+// Model without any network access, used to measure overhead of the module itself.
+// Embedding is derived from hash of the input, so that the same input always gets the
+// same embedding. Predict and chat return a canned response. Each call sleeps for a
+// random latency, and fails with the given error rate.
+class MockModel : public LlmModel {
+public:
+    explicit MockModel(const nlohmann::json &conf);
+
+    virtual std::vector<float> embedding(const std::string_view &input,
+            const nlohmann::json &params = nlohmann::json::object()) override;
+
+    virtual std::string predict(const std::string_view &input,
+            const nlohmann::json &params = nlohmann::json::object()) override;
+
+    virtual std::string chat(const std::string_view &input,
+            const std::string &history_summary,
+            const nlohmann::json &recent_history,
+            const nlohmann::json &params = nlohmann::json::object()) override;
+
+private:
+    enum class Distribution {
+        CONSTANT,
+        UNIFORM,
+        NORMAL,
+        EXPONENTIAL
+    };
+
+    // All latencies are in milliseconds.
+    struct LatencyOptions {
+        Distribution distribution = Distribution::CONSTANT;
+
+        double mean = 0;
+
+        double stddev = 0;
+
+        double min = 0;
+
+        double max = 0;
+    };
+
+    struct Options {
+        std::size_t dim = 1536;
+
+        std::string response = "This is a mock response.";
+
+        LatencyOptions latency;
+
+        double error_rate = 0;
+    };
+
+    Options _parse_options(const nlohmann::json &conf) const;
+
+    LatencyOptions _parse_latency_options(const nlohmann::json &conf) const;
+
+    // Sleep for a random latency, and throw Error with probability of error_rate.
+    void _simulate();
+
+    Options _opts;
+};
+
+}
+
+#endif // end SEWENEW_REDIS_LLM_MOCK_MODEL_H
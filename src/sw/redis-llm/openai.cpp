@@ -16,16 +16,23 @@
 
 #include "sw/redis-llm/openai.h"
 #include "sw/redis-llm/errors.h"
+#include "sw/redis-llm/stats.h"
 #include "sw/redis-llm/utils.h"
 
 namespace sw::redis::llm {
 
-OpenAi::OpenAi(const nlohmann::json &conf) :
-    LlmModel("openai", conf),
-    _opts(_parse_options(conf)),
-    _client_pool(_opts.http_opts, _opts.http_pool_opts) {}
+OpenAi::OpenAi(const nlohmann::json &conf) : OpenAi("openai", conf, _openai_defaults()) {}
+
+OpenAi::OpenAi(const std::string &type, const nlohmann::json &conf, const Defaults &defaults) :
+    LlmModel(type, conf),
+    _opts(_parse_options(conf, defaults)),
+    _load_balancer(_opts.routing, _opts.endpoints),
+    _embedding_batcher(_opts.embedding_batch,
+            [this](const std::vector<std::string_view> &inputs) { return _embeddings(inputs); }) {}
 
 std::string OpenAi::predict(const std::string_view &input, const nlohmann::json &params) {
+    LatencyTimer timer(Latency::PREDICT);
+
     try {
         if (_opts.chat.is_null()) {
             throw Error("no chat conf is specified");
@@ -35,21 +42,12 @@ std::string OpenAi::predict(const std::string_view &input, const nlohmann::json
         auto req = _opts.chat;
         req["messages"] = _construct_msg(input);
 
-        auto ans = _query(_opts.chat_path, req);
+        ChatResponseParser parser;
+        _query(_opts.chat_path, req, parser);
 
-        auto &choices = ans["choices"];
-        if (!choices.is_array() || choices.empty()) {
-            throw Error("invalid chat choices");
-        }
-
-        auto &content = choices[0]["message"]["content"];
-        if (!content.is_string()) {
-            throw Error("invalid chat choices");
-        }
-
-        return content.get<std::string>();
+        return parser.content();
     } catch (const std::exception &e) {
-        throw Error(std::string("failed to predict with openai: ") + e.what());
+        throw Error("failed to predict with " + type() + ": " + e.what());
     }
 
     return "";
@@ -59,6 +57,8 @@ std::string OpenAi::chat(const std::string_view &input,
         const std::string &system_msg,
         const nlohmann::json &recent_history,
         const nlohmann::json &params) {
+    LatencyTimer timer(Latency::PREDICT);
+
     try {
         if (_opts.chat.is_null()) {
             throw Error("no chat conf is specified");
@@ -69,19 +69,10 @@ std::string OpenAi::chat(const std::string_view &input,
 
         req["messages"] = _construct_msg(input, system_msg, recent_history);
 
-        auto ans = _query(_opts.chat_path, req);
-
-        auto &choices = ans["choices"];
-        if (!choices.is_array() || choices.empty()) {
-            throw Error("invalid chat choices");
-        }
+        ChatResponseParser parser;
+        _query(_opts.chat_path, req, parser);
 
-        auto &content = choices[0]["message"]["content"];
-        if (!content.is_string()) {
-            throw Error("invalid chat choices");
-        }
-
-        return content.get<std::string>();
+        return parser.content();
     } catch (const std::exception &e) {
         throw Error(std::string("failed to predict: ") + e.what());
     }
@@ -90,27 +81,27 @@ std::string OpenAi::chat(const std::string_view &input,
 }
 
 Vector OpenAi::embedding(const std::string_view &input, const nlohmann::json &params) {
+    LatencyTimer timer(Latency::EMBEDDING);
+
     try {
         if (_opts.embedding.is_null()) {
             throw Error("no embedding config is specified");
         }
 
+        if (_embedding_batcher.enabled()) {
+            return _embedding_batcher.embedding(input);
+        }
+
         auto req = _opts.embedding;
         req["input"] = input;
 
-        auto ans = _query(_opts.embedding_path, req);
-
-        auto &data = ans["data"];
-        if (!data.is_array() || data.empty()) {
-            throw Error("invalid embedding response");
-        }
+        EmbeddingResponseParser parser(_embedding_dim);
+        _query(_opts.embedding_path, req, parser);
 
-        auto &embedding = data[0]["embedding"];
-        if (!embedding.is_array()) {
-            throw Error("invalid embedding response");
-        }
+        auto embedding = parser.embedding();
+        _embedding_dim = embedding.size();
 
-        return embedding.get<Vector>();
+        return embedding;
     } catch (const std::exception &e) {
         throw Error(std::string("failed to request embedding: ") + e.what());
     }
@@ -119,6 +110,19 @@ Vector OpenAi::embedding(const std::string_view &input, const nlohmann::json &pa
     return {};
 }
 
+std::vector<Vector> OpenAi::_embeddings(const std::vector<std::string_view> &inputs) {
+    auto req = _opts.embedding;
+    req["input"] = inputs;
+
+    EmbeddingResponseParser parser(_embedding_dim, inputs.size());
+    _query(_opts.embedding_path, req, parser);
+
+    auto embeddings = parser.embeddings();
+    _embedding_dim = embeddings.front().size();
+
+    return embeddings;
+}
+
 nlohmann::json OpenAi::_construct_msg(const std::string_view &input,
         std::string system_info,
         nlohmann::json recent_history) const {
@@ -143,35 +147,84 @@ nlohmann::json OpenAi::_construct_msg(const std::string_view &input,
     return msgs;
 }
 
-nlohmann::json OpenAi::_query(const std::string &path, const nlohmann::json &req) {
-    SafeClient cli(_client_pool);
-    auto output = cli.client().post(path, req.dump());
+void OpenAi::_query(const std::string &path, const nlohmann::json &req, JsonStreamParser &parser) {
+    _load_balancer.post([&path](std::size_t /*endpoint*/) { return path; }, req.dump(),
+            [&parser](const std::string_view &data) { parser.feed(data); });
+}
+
+auto OpenAi::_openai_defaults() -> Defaults {
+    Defaults defaults;
+    defaults.uri = "https://api.openai.com";
+    defaults.chat["model"] = "gpt-3.5-turbo";
+    defaults.embedding["model"] = "text-embedding-ada-002";
 
-    return nlohmann::json::parse(output);
+    // Base64 encoded floats are much smaller and faster to parse than JSON numbers.
+    defaults.embedding["encoding_format"] = "base64";
+
+    return defaults;
 }
 
-OpenAi::Options OpenAi::_parse_options(const nlohmann::json &conf) const {
+OpenAi::Options OpenAi::_parse_options(const nlohmann::json &conf, const Defaults &defaults) const {
     Options opts;
     try {
         // {"api_key": "", "chat": {"chat_path":"", "model": ""}, "embedding": {"embedding_path":"", "model":""}, "http":{"socket_timeout":"5s","connect_timeout":"5s", "enable_certificate_verification":false, "pool" : {"size":3, "wait_timeout":"0s", "connection_lifetime":"0s"}}}
-        opts.api_key = conf.at("api_key").get<std::string>();
-        opts.chat = conf.value<nlohmann::json>("chat", nlohmann::json{});
+        // API key can also be specified by each endpoint.
+        opts.api_key = conf.value<std::string>("api_key", "");
+        opts.chat = conf.value<nlohmann::json>("chat", nlohmann::json::object());
         opts.chat_path = conf.value<std::string>("chat_path", "/v1/chat/completions");
-        opts.embedding = conf.value<nlohmann::json>("embedding", nlohmann::json{});
+        opts.embedding = conf.value<nlohmann::json>("embedding", nlohmann::json::object());
         opts.embedding_path = conf.value<std::string>("embedding_path", "/v1/embeddings");
-        if (opts.chat.find("model") == opts.chat.end()) {
-            opts.chat["model"] = "gpt-3.5-turbo";
+        for (const auto &[key, val] : defaults.chat.items()) {
+            if (opts.chat.find(key) == opts.chat.end()) {
+                opts.chat[key] = val;
+            }
         }
-        if (opts.embedding.find("model") == opts.embedding.end()) {
-            opts.embedding["model"] = "text-embedding-ada-002";
+        for (const auto &[key, val] : defaults.embedding.items()) {
+            if (opts.embedding.find(key) == opts.embedding.end()) {
+                opts.embedding[key] = val;
+            }
         }
 
         std::tie(opts.http_opts, opts.http_pool_opts) = _parse_http_options(conf);
 
-        opts.http_opts.uri = "https://api.openai.com";
+        auto iter = conf.find("embedding_batch");
+        if (iter != conf.end()) {
+            opts.embedding_batch = EmbeddingBatchOptions(iter.value());
+        }
+
+        if (opts.http_opts.uri.empty()) {
+            // Set uri to use an OpenAI compatible server.
+            opts.http_opts.uri = defaults.uri;
+        }
         opts.http_opts.bearer_token = opts.api_key;
+
+        iter = conf.find("endpoints");
+        if (iter != conf.end()) {
+            // {"endpoints": [{"uri": "", "api_key": ""}], "routing": {"policy": "ewma", "max_attempts": 2, "hedge": false, "hedge_delay": 0, "fail_timeout": 10000}}
+            for (const auto &endpoint_conf : iter.value()) {
+                LoadBalancer::EndpointOptions endpoint;
+                endpoint.http_opts = opts.http_opts;
+                endpoint.http_opts.uri = endpoint_conf.value<std::string>("uri", opts.http_opts.uri);
+                endpoint.http_opts.bearer_token = endpoint_conf.value<std::string>("api_key", opts.api_key);
+                endpoint.pool_opts = opts.http_pool_opts;
+                opts.endpoints.push_back(std::move(endpoint));
+            }
+        } else {
+            opts.endpoints.push_back(LoadBalancer::EndpointOptions{opts.http_opts, opts.http_pool_opts, {}});
+        }
+
+        for (const auto &endpoint : opts.endpoints) {
+            if (defaults.api_key_required && endpoint.http_opts.bearer_token.empty()) {
+                throw Error("api_key is required");
+            }
+        }
+
+        iter = conf.find("routing");
+        if (iter != conf.end()) {
+            opts.routing = LoadBalancerOptions(iter.value());
+        }
     } catch (const nlohmann::json::exception &e) {
-        throw Error(std::string("failed to parse openai options: ") + e.what() + ":" + conf.dump());
+        throw Error("failed to parse " + type() + " options: " + e.what() + ":" + conf.dump());
     }
 
     return opts;
@@ -17,12 +17,17 @@
 #ifndef SEWENEW_REDIS_LLM_OPENAI_H
 #define SEWENEW_REDIS_LLM_OPENAI_H
 
+#include <atomic>
 #include "nlohmann/json.hpp"
+#include "sw/redis-llm/embedding_batcher.h"
 #include "sw/redis-llm/http_client.h"
 #include "sw/redis-llm/llm_model.h"
+#include "sw/redis-llm/load_balancer.h"
+#include "sw/redis-llm/response_parser.h"
 
 namespace sw::redis::llm {
 
+// Model served with OpenAI API, or an OpenAI compatible server.
 class OpenAi : public LlmModel {
 public:
     explicit OpenAi(const nlohmann::json &conf);
@@ -38,7 +43,26 @@ public:
             const nlohmann::json &recent_history,
             const nlohmann::json &params = nlohmann::json::object()) override;
 
+protected:
+    // Default options, which differ among OpenAI compatible servers.
+    struct Defaults {
+        std::string uri;
+
+        bool api_key_required = true;
+
+        // Default parameters of chat and embedding requests, which are overridden by
+        // parameters specified by user.
+        nlohmann::json chat = nlohmann::json::object();
+
+        nlohmann::json embedding = nlohmann::json::object();
+    };
+
+    // Create a model of *type*, which is served by an OpenAI compatible server.
+    OpenAi(const std::string &type, const nlohmann::json &conf, const Defaults &defaults);
+
 private:
+    static Defaults _openai_defaults();
+
     struct Options {
         std::string api_key;
 
@@ -53,9 +77,17 @@ private:
         HttpClientOptions http_opts;
 
         HttpClientPoolOptions http_pool_opts;
+
+        EmbeddingBatchOptions embedding_batch;
+
+        // Endpoints with their own uri and API key. If not specified, there's only one
+        // endpoint built from the options above.
+        std::vector<LoadBalancer::EndpointOptions> endpoints;
+
+        LoadBalancerOptions routing;
     };
 
-    Options _parse_options(const nlohmann::json &conf) const;
+    Options _parse_options(const nlohmann::json &conf, const Defaults &defaults) const;
 
     auto _parse_http_options(const nlohmann::json &conf) const
         -> std::pair<HttpClientOptions, HttpClientPoolOptions>;
@@ -64,11 +96,20 @@ private:
             std::string system_msg = "",
             nlohmann::json recent_history = {}) const;
 
-    nlohmann::json _query(const std::string &path, const nlohmann::json &input);
+    // Create embeddings of multiple inputs with a single request.
+    std::vector<Vector> _embeddings(const std::vector<std::string_view> &inputs);
+
+    // Post request, and parse the response while receiving it.
+    void _query(const std::string &path, const nlohmann::json &input, JsonStreamParser &parser);
 
     Options _opts;
 
-    HttpClientPool _client_pool;
+    LoadBalancer _load_balancer;
+
+    // Dimension of the last embedding, used to reserve space for the next one.
+    std::atomic<std::size_t> _embedding_dim{0};
+
+    EmbeddingBatcher _embedding_batcher;
 };
 
 }
@@ -51,6 +51,99 @@ void Options::load(RedisModuleString **argv, int argc) {
             } catch (const std::exception &) {
                 throw Error("invalid id");
             }
+        } else if (util::str_case_equal(opt, "--BACKGROUND_QUEUE_SIZE")) {
+            if (idx + 1 >= argc) {
+                throw Error("syntax error");
+            }
+            ++idx;
+
+            try {
+                opts.worker_pool_opts.background_queue_size = std::stoul(util::to_string(argv[idx]));
+            } catch (const std::exception &) {
+                throw Error("invalid background queue size");
+            }
+        } else if (util::str_case_equal(opt, "--BACKGROUND_SHARE")) {
+            if (idx + 1 >= argc) {
+                throw Error("syntax error");
+            }
+            ++idx;
+
+            try {
+                opts.worker_pool_opts.background_share = std::stoul(util::to_string(argv[idx]));
+            } catch (const std::exception &) {
+                throw Error("invalid background share");
+            }
+
+            if (opts.worker_pool_opts.background_share > 100) {
+                throw Error("background share should be between 0 and 100");
+            }
+        } else if (util::str_case_equal(opt, "--DEFAULT_DEADLINE")) {
+            if (idx + 1 >= argc) {
+                throw Error("syntax error");
+            }
+            ++idx;
+
+            try {
+                opts.worker_pool_opts.default_deadline = std::chrono::milliseconds(
+                        std::stoul(util::to_string(argv[idx])));
+            } catch (const std::exception &) {
+                throw Error("invalid default deadline");
+            }
+        } else if (util::str_case_equal(opt, "--TOKENIZER_VOCAB")) {
+            if (idx + 1 >= argc) {
+                throw Error("syntax error");
+            }
+            ++idx;
+
+            opts.tokenizer_vocab = util::to_string(argv[idx]);
+        } else if (util::str_case_equal(opt, "--SLOWLOG_LOG_SLOWER_THAN")) {
+            if (idx + 1 >= argc) {
+                throw Error("syntax error");
+            }
+            ++idx;
+
+            try {
+                opts.slowlog_opts.log_slower_than = std::stoll(util::to_string(argv[idx]));
+            } catch (const std::exception &) {
+                throw Error("invalid slowlog threshold");
+            }
+        } else if (util::str_case_equal(opt, "--SLOWLOG_MAX_LEN")) {
+            if (idx + 1 >= argc) {
+                throw Error("syntax error");
+            }
+            ++idx;
+
+            try {
+                opts.slowlog_opts.max_len = std::stoul(util::to_string(argv[idx]));
+            } catch (const std::exception &) {
+                throw Error("invalid slowlog max len");
+            }
+        } else if (util::str_case_equal(opt, "--STORAGE_KEEP_VERSIONS")) {
+            if (idx + 1 >= argc) {
+                throw Error("syntax error");
+            }
+            ++idx;
+
+            try {
+                opts.storage_files_opts.keep_versions = std::stoul(util::to_string(argv[idx]));
+            } catch (const std::exception &) {
+                throw Error("invalid storage keep versions");
+            }
+
+            if (opts.storage_files_opts.keep_versions == 0) {
+                throw Error("storage keep versions should be at least 1");
+            }
+        } else if (util::str_case_equal(opt, "--STORAGE_RETENTION")) {
+            if (idx + 1 >= argc) {
+                throw Error("syntax error");
+            }
+            ++idx;
+
+            try {
+                opts.storage_files_opts.retention = std::stoll(util::to_string(argv[idx]));
+            } catch (const std::exception &) {
+                throw Error("invalid storage retention");
+            }
         } else {
             throw Error("unknown option: " + std::string(opt));
         }
@@ -18,6 +18,8 @@
 #define SEWENEW_REDIS_LLM_OPTIONS_H
 
 #include "sw/redis-llm/module_api.h"
+#include "sw/redis-llm/slowlog.h"
+#include "sw/redis-llm/storage_files.h"
 #include "sw/redis-llm/worker_pool.h"
 #include <string>
 
@@ -27,6 +29,14 @@ struct Options {
     void load(RedisModuleString **argv, int argc);
 
     WorkerPoolOptions worker_pool_opts;
+
+    // Vocabulary file of tokenizer, e.g. cl100k_base.tiktoken. If not specified,
+    // number of tokens is estimated as 1 token per 4 bytes.
+    std::string tokenizer_vocab;
+
+    SlowLogOptions slowlog_opts;
+
+    StorageFilesOptions storage_files_opts;
 };
 
 }
@@ -0,0 +1,79 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/profile.h"
+#include <algorithm>
+#include "sw/redis-llm/redis_llm.h"
+
+namespace sw::redis::llm {
+
+thread_local Profile* Profile::_current = nullptr;
+
+void Profile::record(const std::string &stage, std::chrono::steady_clock::duration duration) {
+    add(stage + "_us", std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+}
+
+void Profile::add(const std::string &field, long long value) {
+    auto iter = std::find_if(_fields.begin(), _fields.end(),
+            [&field](const auto &ele) { return ele.first == field; });
+    if (iter == _fields.end()) {
+        _fields.emplace_back(field, value);
+    } else {
+        iter->second += value;
+    }
+}
+
+void Profile::reply(RedisModuleCtx *ctx) const {
+    RedisModule_ReplyWithArray(ctx, _fields.size() * 2);
+    for (const auto &[field, value] : _fields) {
+        RedisModule_ReplyWithStringBuffer(ctx, field.data(), field.size());
+        RedisModule_ReplyWithLongLong(ctx, value);
+    }
+}
+
+void Profile::begin_reply(RedisModuleCtx *ctx, std::chrono::steady_clock::time_point unblock_time) {
+    record_since("unblock", unblock_time);
+
+    // Reply result and profile.
+    RedisModule_ReplyWithArray(ctx, 2);
+
+    _reply_start = std::chrono::steady_clock::now();
+}
+
+void Profile::end_reply(RedisModuleCtx *ctx, std::chrono::steady_clock::time_point start) {
+    record_since("reply", _reply_start);
+    record_since("total", start);
+
+    reply(ctx);
+}
+
+void Profile::add_tokens(const std::vector<std::string_view> &prompt,
+        const std::string_view &completion) {
+    auto *profile = current();
+    if (profile == nullptr) {
+        return;
+    }
+
+    auto &redis_llm = RedisLlm::instance();
+    long long tokens = 0;
+    for (const auto &part : prompt) {
+        tokens += redis_llm.count_tokens(part);
+    }
+    profile->add("prompt_tokens", tokens);
+    profile->add("completion_tokens", redis_llm.count_tokens(completion));
+}
+
+}
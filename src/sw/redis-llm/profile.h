@@ -0,0 +1,125 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SEWENEW_REDIS_LLM_PROFILE_H
+#define SEWENEW_REDIS_LLM_PROFILE_H
+
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "sw/redis-llm/redismodule.h"
+
+namespace sw::redis::llm {
+
+// Timing breakdown of a single request, which is returned to client with --PROFILE option.
+// A profile is only accessed by one thread at a time, i.e. the worker thread running the
+// request, and then the main thread replying it, so it needs no lock.
+class Profile {
+public:
+    // Profile of the request being processed by the current thread, or nullptr if the
+    // request is not profiled.
+    static Profile* current() {
+        return _current;
+    }
+
+    // Accumulate duration of a stage into "<stage>_us" field.
+    void record(const std::string &stage, std::chrono::steady_clock::duration duration);
+
+    void record_since(const std::string &stage, std::chrono::steady_clock::time_point start) {
+        record(stage, std::chrono::steady_clock::now() - start);
+    }
+
+    // Accumulate a counter field, e.g. number of tokens.
+    void add(const std::string &field, long long value);
+
+    const std::vector<std::pair<std::string, long long>>& fields() const {
+        return _fields;
+    }
+
+    // Reply fields as a flat array of field-value pairs.
+    void reply(RedisModuleCtx *ctx) const;
+
+    // Called by reply callback of a blocked command before replying its result. Record time
+    // to unblock the client, and reply an array of two elements, i.e. result and profile.
+    void begin_reply(RedisModuleCtx *ctx, std::chrono::steady_clock::time_point unblock_time);
+
+    // Called after replying the result. Record time to reply, and end to end time since
+    // *start*, and then reply the profile.
+    void end_reply(RedisModuleCtx *ctx, std::chrono::steady_clock::time_point start);
+
+    // Count tokens of *prompt*, which might consist of several parts, and *completion*
+    // of an LLM call into the current profile. No-op if there's none.
+    static void add_tokens(const std::vector<std::string_view> &prompt,
+            const std::string_view &completion);
+
+private:
+    friend class ProfileScope;
+
+    static thread_local Profile *_current;
+
+    // Keep fields in the order of stages.
+    std::vector<std::pair<std::string, long long>> _fields;
+
+    std::chrono::steady_clock::time_point _reply_start;
+};
+
+// Make *profile* the current profile of this thread for the enclosing scope.
+// If *profile* is nullptr, requests in the scope are not profiled.
+class ProfileScope {
+public:
+    explicit ProfileScope(Profile *profile) : _prev(Profile::_current) {
+        Profile::_current = profile;
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope& operator=(const ProfileScope &) = delete;
+
+    ~ProfileScope() {
+        Profile::_current = _prev;
+    }
+
+private:
+    Profile *_prev = nullptr;
+};
+
+// Record duration of the enclosing scope into the current profile. No-op if there's none.
+class ProfileTimer {
+public:
+    explicit ProfileTimer(const char *stage) :
+        _profile(Profile::current()), _stage(stage), _start(std::chrono::steady_clock::now()) {}
+
+    ProfileTimer(const ProfileTimer &) = delete;
+    ProfileTimer& operator=(const ProfileTimer &) = delete;
+
+    ~ProfileTimer() {
+        if (_profile != nullptr) {
+            _profile->record_since(_stage, _start);
+        }
+    }
+
+private:
+    Profile *_profile = nullptr;
+
+    const char *_stage = nullptr;
+
+    std::chrono::steady_clock::time_point _start;
+};
+
+}
+
+#endif // end SEWENEW_REDIS_LLM_PROFILE_H
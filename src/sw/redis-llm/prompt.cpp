@@ -15,21 +15,73 @@
  *************************************************************************/
 
 #include "sw/redis-llm/prompt.h"
+#include <algorithm>
+#include <cctype>
 #include "sw/redis-llm/errors.h"
+#include "sw/redis-llm/stats.h"
+
+namespace {
+
+// Environment is read-only when rendering, so that it can be shared by all prompts and threads.
+inja::Environment& render_env() {
+    static inja::Environment env;
+
+    return env;
+}
+
+std::string_view trim(std::string_view str) {
+    auto first = str.find_first_not_of(" \t\r\n");
+    if (first == std::string_view::npos) {
+        return {};
+    }
+
+    auto last = str.find_last_not_of(" \t\r\n");
+
+    return str.substr(first, last - first + 1);
+}
+
+bool is_identifier(const std::string_view &str) {
+    if (str.empty() || std::isdigit(static_cast<unsigned char>(str.front()))) {
+        return false;
+    }
+
+    for (auto c : str) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}
 
 namespace sw::redis::llm {
 
-Prompt::Prompt(const std::string_view &tpl) {
+Prompt::Prompt(const std::string_view &tpl) : _raw_tpl(tpl) {
     inja::Environment env;
     _tpl = env.parse(tpl);
+
+    _simple = _parse_segments();
 }
 
 std::string Prompt::render(const nlohmann::json &data) const {
+    return render(PromptVars{}, data);
+}
+
+std::string Prompt::render(const PromptVars &vars, const nlohmann::json &data) const {
+    LatencyTimer timer(Latency::RENDER);
+
     std::string result;
 
     try {
-        inja::Environment env;
-        result = env.render(_tpl, data);
+        if (_simple) {
+            result = _render_segments(vars, data);
+        } else {
+            result = _render_inja(vars, data);
+        }
+    } catch (const Error &) {
+        throw;
     } catch (const std::exception &e) {
         throw Error(std::string("failed to render prompt: ") + e.what());
     }
@@ -37,4 +89,115 @@ std::string Prompt::render(const nlohmann::json &data) const {
     return result;
 }
 
+bool Prompt::_parse_segments() {
+    std::string_view tpl = _raw_tpl;
+
+    // Statements, comments and line statements are rendered by inja.
+    if (tpl.find("{%") != std::string_view::npos
+            || tpl.find("{#") != std::string_view::npos
+            || tpl.substr(0, 2) == "##"
+            || tpl.find("\n##") != std::string_view::npos) {
+        return false;
+    }
+
+    std::vector<Segment> segments;
+    std::size_t pos = 0;
+    while (pos < tpl.size()) {
+        auto open = tpl.find("{{", pos);
+        if (open == std::string_view::npos) {
+            segments.push_back(Segment{pos, tpl.size() - pos, false});
+            break;
+        }
+
+        if (open > pos) {
+            segments.push_back(Segment{pos, open - pos, false});
+        }
+
+        auto close = tpl.find("}}", open + 2);
+        if (close == std::string_view::npos) {
+            return false;
+        }
+
+        auto expr = tpl.substr(open + 2, close - open - 2);
+        auto name = trim(expr);
+        if (!is_identifier(name)) {
+            // Expressions, e.g. filters, functions and whitespace control.
+            return false;
+        }
+
+        segments.push_back(Segment{static_cast<std::size_t>(name.data() - tpl.data()), name.size(), true});
+
+        pos = close + 2;
+    }
+
+    _segments = std::move(segments);
+
+    return true;
+}
+
+std::string Prompt::_render_segments(const PromptVars &vars, const nlohmann::json &data) const {
+    std::string_view tpl = _raw_tpl;
+
+    // Values of variables, and storage for values converted from non-string JSON.
+    std::vector<std::string_view> values;
+    std::vector<std::string> storage;
+    storage.reserve(_segments.size());
+    std::size_t size = 0;
+    for (const auto &segment : _segments) {
+        if (!segment.is_var) {
+            size += segment.len;
+            continue;
+        }
+
+        auto name = tpl.substr(segment.pos, segment.len);
+        auto iter = std::find_if(vars.begin(), vars.end(),
+                [&name](const auto &var) { return var.first == name; });
+        if (iter != vars.end()) {
+            values.push_back(iter->second);
+        } else {
+            auto json_iter = data.is_object() ? data.find(std::string(name)) : data.end();
+            if (json_iter == data.end()) {
+                throw Error("failed to render prompt: variable '" + std::string(name) + "' not found");
+            }
+
+            if (json_iter->is_string()) {
+                values.push_back(json_iter->get_ref<const std::string &>());
+            } else {
+                storage.push_back(json_iter->dump());
+                values.push_back(storage.back());
+            }
+        }
+
+        size += values.back().size();
+    }
+
+    std::string output;
+    output.reserve(size);
+
+    auto value = values.begin();
+    for (const auto &segment : _segments) {
+        if (segment.is_var) {
+            output.append(value->data(), value->size());
+            ++value;
+        } else {
+            output.append(tpl.data() + segment.pos, segment.len);
+        }
+    }
+
+    return output;
+}
+
+std::string Prompt::_render_inja(const PromptVars &vars, const nlohmann::json &data) const {
+    if (vars.empty()) {
+        return render_env().render(_tpl, data);
+    }
+
+    auto all_vars = data.is_object() ? data : nlohmann::json::object();
+    for (const auto &[name, value] : vars) {
+        all_vars[std::string(name)] = std::string(value);
+    }
+
+    return render_env().render(_tpl, all_vars);
+}
+
 }
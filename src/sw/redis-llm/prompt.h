@@ -19,25 +19,54 @@
 
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 #include "inja/inja.hpp"
 #include "nlohmann/json.hpp"
 
 namespace sw::redis::llm {
 
+// Variables used to render a prompt. Values are not copied, and must outlive the rendering.
+using PromptVars = std::vector<std::pair<std::string_view, std::string_view>>;
+
 class Prompt {
 public:
     explicit Prompt(const std::string_view &tpl);
 
     std::string render(const nlohmann::json &data = nlohmann::json{}) const;
 
+    // Render with *vars*, and fall back to *data* for variables not in *vars*.
+    std::string render(const PromptVars &vars, const nlohmann::json &data = nlohmann::json{}) const;
+
     const std::string& dump() const {
         return _raw_tpl;
     }
 
 private:
+    // A piece of the raw template, either literal text or a variable name.
+    struct Segment {
+        std::size_t pos;
+
+        std::size_t len;
+
+        bool is_var;
+    };
+
+    // Split template into segments. Return false, if the template has statements,
+    // comments or expressions other than a plain variable, which should be rendered by inja.
+    bool _parse_segments();
+
+    std::string _render_segments(const PromptVars &vars, const nlohmann::json &data) const;
+
+    std::string _render_inja(const PromptVars &vars, const nlohmann::json &data) const;
+
     std::string _raw_tpl;
 
     inja::Template _tpl;
+
+    std::vector<Segment> _segments;
+
+    bool _simple = false;
 };
 
 }
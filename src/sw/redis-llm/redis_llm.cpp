@@ -20,7 +20,11 @@
 #include <string_view>
 #include "sw/redis-llm/command.h"
 #include "sw/redis-llm/errors.h"
+#include "sw/redis-llm/job.h"
 #include "sw/redis-llm/module_api.h"
+#include "sw/redis-llm/slowlog.h"
+#include "sw/redis-llm/stats.h"
+#include "sw/redis-llm/storage_files.h"
 #include "nlohmann/json.hpp"
 
 namespace {
@@ -96,6 +100,14 @@ void RedisLlm::load(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
 
     _worker_pool = std::make_unique<WorkerPool>(_options.worker_pool_opts);
 
+    SlowLog::instance().set_options(_options.slowlog_opts);
+
+    StorageFiles::instance().set_options(_options.storage_files_opts);
+
+    if (!_options.tokenizer_vocab.empty()) {
+        _tokenizer = std::make_unique<Tokenizer>(_options.tokenizer_vocab);
+    }
+
     RedisModuleTypeMethods llm_methods = {
         REDISMODULE_TYPE_METHOD_VERSION,
         _rdb_load_llm,
@@ -150,7 +162,47 @@ void RedisLlm::load(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         throw Error(std::string("failed to create ") + vector_store_type_name() + " type");
     }
 
+    // INFO callback is only available since Redis 6.0.
+    if (RedisModule_RegisterInfoFunc != nullptr
+            && RedisModule_RegisterInfoFunc(ctx, _info_func) == REDISMODULE_ERR) {
+        throw Error("failed to register info function");
+    }
+
     cmd::create_commands(ctx);
+
+    RedisModule_CreateTimer(ctx, _COLLECT_STORAGE_FILES_INTERVAL, _collect_storage_files, nullptr);
+}
+
+std::size_t RedisLlm::count_tokens(const std::string_view &text) const {
+    if (_tokenizer) {
+        return _tokenizer->count(text);
+    }
+
+    // A rough estimation for English text.
+    return (text.size() + 3) / 4;
+}
+
+std::vector<std::pair<std::string, long long>> RedisLlm::stats() const {
+    std::vector<std::pair<std::string, long long>> fields;
+    if (_worker_pool) {
+        const auto &opts = _worker_pool->options();
+        fields.emplace_back("worker_pool_size", opts.pool_size);
+        fields.emplace_back("worker_queue_capacity", opts.queue_size);
+        fields.emplace_back("worker_background_queue_capacity", opts.background_queue_size);
+        fields.emplace_back("worker_queue_depth", _worker_pool->queue_depth());
+    }
+
+    fields.emplace_back("jobs_in_flight", JobManager::instance().in_flight());
+
+    auto &stats = Stats::instance();
+
+    auto counters = stats.counters();
+    fields.insert(fields.end(), counters.begin(), counters.end());
+
+    auto latencies = stats.latencies();
+    fields.insert(fields.end(), latencies.begin(), latencies.end());
+
+    return fields;
 }
 
 LlmModelSPtr RedisLlm::create_llm(const std::string &type, const nlohmann::json &conf) {
@@ -330,6 +382,43 @@ void RedisLlm::_free_vector_store(void *value) {
     }
 }
 
+void RedisLlm::_collect_storage_files(RedisModuleCtx *ctx, void * /*data*/) {
+    auto &storage_files = StorageFiles::instance();
+
+    if (!storage_files.empty()) {
+        auto *reply = RedisModule_Call(ctx, "LASTSAVE", "");
+        if (reply != nullptr) {
+            if (RedisModule_CallReplyType(reply) == REDISMODULE_REPLY_INTEGER) {
+                storage_files.collect(RedisModule_CallReplyInteger(reply), _aof_enabled(ctx));
+            }
+
+            RedisModule_FreeCallReply(reply);
+        }
+    }
+
+    RedisModule_CreateTimer(ctx, _COLLECT_STORAGE_FILES_INTERVAL, _collect_storage_files, nullptr);
+}
+
+bool RedisLlm::_aof_enabled(RedisModuleCtx *ctx) {
+    auto *reply = RedisModule_Call(ctx, "CONFIG", "cc", "GET", "appendonly");
+    if (reply == nullptr) {
+        // Not sure, take it as enabled.
+        return true;
+    }
+
+    auto enabled = true;
+    if (RedisModule_CallReplyType(reply) == REDISMODULE_REPLY_ARRAY
+            && RedisModule_CallReplyLength(reply) == 2) {
+        std::size_t len = 0;
+        const auto *val = RedisModule_CallReplyStringPtr(RedisModule_CallReplyArrayElement(reply, 1), &len);
+        enabled = (val == nullptr || std::string_view(val, len) != "no");
+    }
+
+    RedisModule_FreeCallReply(reply);
+
+    return enabled;
+}
+
 void* RedisLlm::_rdb_load_app(RedisModuleIO *rdb, int encver) {
     try {
         assert(rdb != nullptr);
@@ -406,6 +495,19 @@ void RedisLlm::_free_app(void *value) {
     }
 }
 
+void RedisLlm::_info_func(RedisModuleInfoCtx *ctx, int /*for_crash_report*/) {
+    try {
+        auto fields = instance().stats();
+
+        RedisModule_InfoAddSection(ctx, const_cast<char *>("stats"));
+        for (auto &[field, value] : fields) {
+            RedisModule_InfoAddFieldLongLong(ctx, field.data(), value);
+        }
+    } catch (const std::exception &) {
+        // Do not break INFO command.
+    }
+}
+
 }
 
 namespace {
@@ -504,6 +606,15 @@ void rdb_save_vector_store(RedisModuleIO *rdb, VectorStore &store) {
     rdb_save_number(rdb, store.id_idx());
     rdb_save_number(rdb, store.dim());
 
+    const auto &storage_file = store.storage_file();
+    if (storage_file) {
+        // Index and data are saved in files, and we only save a reference.
+        auto [file, checksum] = store.dump();
+        rdb_save_string(rdb, file);
+        rdb_save_number(rdb, checksum);
+        return;
+    }
+
     const auto &data_store = store.data_store();
     rdb_save_number(rdb, data_store.size());
 
@@ -568,12 +679,31 @@ void* rdb_load_vector_store(RedisModuleIO *rdb) {
     auto store = llm.create_vector_store(type, conf, llm_info);
     store->set_id_idx(id_idx);
 
-    rdb_load_vector_store(rdb, *store, dim);
+    if (store->storage_file()) {
+        auto file = to_string(rdb_load_string(rdb));
+        auto checksum = rdb_load_number(rdb);
+        store->load(file, checksum, dim);
+    } else {
+        rdb_load_vector_store(rdb, *store, dim);
+    }
 
     return store.get();
 }
 
 void rewrite_vector_store(RedisModuleIO *aof, RedisModuleString *key, VectorStore &store) {
+    // Emit items in batches of binary embeddings, instead of one LLM.ADD per item.
+    const std::size_t BATCH_SIZE = 1000;
+
+    std::string batch;
+    std::size_t cnt = 0;
+    auto emit = [&]() {
+        if (cnt > 0) {
+            RedisModule_EmitAOF(aof, "LLM.MADD", "sb", key, batch.data(), batch.size());
+            batch.clear();
+            cnt = 0;
+        }
+    };
+
     const auto &data_store = store.data_store();
     for (auto &[id, data] : data_store) {
         auto vec = store.get(id);
@@ -581,27 +711,14 @@ void rewrite_vector_store(RedisModuleIO *aof, RedisModuleString *key, VectorStor
             // TODO: this should not happen
             continue;
         }
-        std::string embedding;
-        for (auto ele : *vec) {
-            if (!embedding.empty()) {
-                embedding += ",";
-            }
-            embedding += std::to_string(ele);
-        }
-        auto id_str = std::to_string(id);
 
-        RedisModule_EmitAOF(aof,
-                "LLM.ADD",
-                "scbbb",
-                key,
-                "--WITHEMBEDDING",
-                id_str.data(),
-                id_str.size(),
-                data.data(),
-                data.size(),
-                embedding.data(),
-                embedding.size());
+        util::append_batch_item(batch, id, data, *vec);
+        if (++cnt == BATCH_SIZE) {
+            emit();
+        }
     }
+
+    emit();
 }
 
 }
@@ -24,6 +24,7 @@
 #include "sw/redis-llm/llm_model.h"
 #include "sw/redis-llm/object.h"
 #include "sw/redis-llm/options.h"
+#include "sw/redis-llm/tokenizer.h"
 #include "sw/redis-llm/vector_store.h"
 #include "sw/redis-llm/worker_pool.h"
 
@@ -97,6 +98,26 @@ public:
         return *_worker_pool;
     }
 
+    // Return nullptr, if no tokenizer vocab is configured.
+    const Tokenizer* tokenizer() const {
+        return _tokenizer.get();
+    }
+
+    std::size_t count_tokens(const std::string_view &text) const;
+
+    // Worker pool status, counters and latency summaries as field-value pairs,
+    // reported by LLM.STATS and INFO llm.
+    std::vector<std::pair<std::string, long long>> stats() const;
+
+    // RDB callbacks of vector store type. Also used by benchmarks with a stubbed RedisModuleIO.
+    static void* load_vector_store(RedisModuleIO *rdb, int encver) {
+        return _rdb_load_vector_store(rdb, encver);
+    }
+
+    static void save_vector_store(RedisModuleIO *rdb, void *value) {
+        _rdb_save_vector_store(rdb, value);
+    }
+
 private:
     RedisLlm() = default;
 
@@ -128,10 +149,20 @@ private:
 
     static void _free_vector_store(void *value);
 
+    static void _info_func(RedisModuleInfoCtx *ctx, int for_crash_report);
+
+    // Periodically remove storage files of vector stores, which are no longer referenced.
+    static void _collect_storage_files(RedisModuleCtx *ctx, void *data);
+
+    static bool _aof_enabled(RedisModuleCtx *ctx);
+
     const int _MODULE_VERSION = 1;
 
     const int _ENCODING_VERSION = 0;
 
+    // In milliseconds.
+    static const long long _COLLECT_STORAGE_FILES_INTERVAL = 10000;
+
     const std::string _MODULE_NAME = "LLM";
 
     const std::string _LLM_TYPE_NAME = "LLMMOD-SW";
@@ -158,6 +189,8 @@ private:
 
     std::unique_ptr<WorkerPool> _worker_pool;
 
+    TokenizerUPtr _tokenizer;
+
     std::unordered_set<ObjectSPtr> _object_pool;
 };
 
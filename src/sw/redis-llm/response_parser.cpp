@@ -0,0 +1,457 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/response_parser.h"
+#include <cassert>
+#include <charconv>
+#include "sw/redis-llm/errors.h"
+
+namespace {
+
+bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+void append_utf8(std::string &str, uint32_t cp) {
+    if (cp < 0x80) {
+        str.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        str.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        str.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        str.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        str.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        str.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+}
+
+namespace sw::redis::llm {
+
+void JsonStreamParser::feed(const std::string_view &chunk) {
+    std::size_t pos = 0;
+    while (pos < chunk.size()) {
+        switch (_state) {
+        case State::STRING:
+            pos = _parse_string(chunk, pos);
+            break;
+
+        case State::NUMBER:
+            pos = _parse_number(chunk, pos);
+            break;
+
+        case State::LITERAL:
+            pos = _parse_literal(chunk, pos);
+            break;
+
+        default:
+            if (is_space(chunk[pos]) || _parse_token(chunk[pos])) {
+                ++pos;
+            }
+            break;
+        }
+    }
+}
+
+void JsonStreamParser::finish() {
+    // A number or literal at the end of input is not terminated by any delimiter.
+    if (_state == State::NUMBER) {
+        _parse_number(" ", 0);
+    } else if (_state == State::LITERAL) {
+        _parse_literal(" ", 0);
+    }
+
+    if (_state != State::DONE) {
+        throw Error("incomplete JSON response");
+    }
+}
+
+bool JsonStreamParser::_parse_token(char c) {
+    switch (_state) {
+    case State::VALUE:
+    case State::FIRST_VALUE:
+        if (c == '{') {
+            _stack.emplace_back();
+            _state = State::FIRST_KEY;
+        } else if (c == '[') {
+            _stack.emplace_back();
+            _stack.back().is_array = true;
+            _state = State::FIRST_VALUE;
+        } else if (c == '"') {
+            _buf.clear();
+            _is_key = false;
+            _state = State::STRING;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            // Parse the whole number from this character.
+            _buf.clear();
+            _state = State::NUMBER;
+            return false;
+        } else if (c == 't' || c == 'f' || c == 'n') {
+            _buf.assign(1, c);
+            _state = State::LITERAL;
+        } else if (c == ']' && _state == State::FIRST_VALUE) {
+            _stack.pop_back();
+            _end_value();
+        } else {
+            throw Error(std::string("invalid JSON response: unexpected ") + c);
+        }
+        break;
+
+    case State::KEY:
+    case State::FIRST_KEY:
+        if (c == '"') {
+            _buf.clear();
+            _is_key = true;
+            _state = State::STRING;
+        } else if (c == '}' && _state == State::FIRST_KEY) {
+            _stack.pop_back();
+            _end_value();
+        } else {
+            throw Error(std::string("invalid JSON response: unexpected ") + c);
+        }
+        break;
+
+    case State::COLON:
+        if (c != ':') {
+            throw Error(std::string("invalid JSON response: unexpected ") + c);
+        }
+        _state = State::VALUE;
+        break;
+
+    case State::COMMA:
+        assert(!_stack.empty());
+
+        if (c == ',') {
+            auto &frame = _stack.back();
+            if (frame.is_array) {
+                ++frame.index;
+                _state = State::VALUE;
+            } else {
+                _state = State::KEY;
+            }
+        } else if ((c == '}' && !_stack.back().is_array) || (c == ']' && _stack.back().is_array)) {
+            _stack.pop_back();
+            _end_value();
+        } else {
+            throw Error(std::string("invalid JSON response: unexpected ") + c);
+        }
+        break;
+
+    default:
+        throw Error(std::string("invalid JSON response: unexpected ") + c);
+    }
+
+    return true;
+}
+
+std::size_t JsonStreamParser::_parse_string(const std::string_view &chunk, std::size_t pos) {
+    while (pos < chunk.size()) {
+        if (_escape || _unicode_left > 0) {
+            _parse_escape(chunk[pos]);
+            ++pos;
+            continue;
+        }
+
+        // Copy unescaped characters in bulk.
+        auto end = chunk.find_first_of("\"\\", pos);
+        if (end == std::string_view::npos) {
+            _buf.append(chunk.data() + pos, chunk.size() - pos);
+            return chunk.size();
+        }
+
+        _buf.append(chunk.data() + pos, end - pos);
+        pos = end + 1;
+
+        if (chunk[end] == '\\') {
+            _escape = true;
+            continue;
+        }
+
+        if (_is_key) {
+            assert(!_stack.empty());
+
+            _stack.back().key.swap(_buf);
+            _state = State::COLON;
+        } else {
+            _on_string(_buf);
+            _end_value();
+        }
+
+        break;
+    }
+
+    return pos;
+}
+
+void JsonStreamParser::_parse_escape(char c) {
+    if (_unicode_left > 0) {
+        uint32_t val = 0;
+        if (c >= '0' && c <= '9') {
+            val = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            val = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            val = c - 'A' + 10;
+        } else {
+            throw Error("invalid JSON response: invalid unicode escape");
+        }
+
+        _unicode = (_unicode << 4) | val;
+        if (--_unicode_left > 0) {
+            return;
+        }
+
+        if (_unicode >= 0xD800 && _unicode <= 0xDBFF) {
+            // Wait for the low surrogate.
+            _high_surrogate = _unicode;
+        } else if (_unicode >= 0xDC00 && _unicode <= 0xDFFF && _high_surrogate != 0) {
+            append_utf8(_buf, 0x10000 + ((_high_surrogate - 0xD800) << 10) + (_unicode - 0xDC00));
+            _high_surrogate = 0;
+        } else {
+            append_utf8(_buf, _unicode);
+            _high_surrogate = 0;
+        }
+
+        return;
+    }
+
+    _escape = false;
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+        _buf.push_back(c);
+        break;
+
+    case 'b':
+        _buf.push_back('\b');
+        break;
+
+    case 'f':
+        _buf.push_back('\f');
+        break;
+
+    case 'n':
+        _buf.push_back('\n');
+        break;
+
+    case 'r':
+        _buf.push_back('\r');
+        break;
+
+    case 't':
+        _buf.push_back('\t');
+        break;
+
+    case 'u':
+        _unicode_left = 4;
+        _unicode = 0;
+        break;
+
+    default:
+        throw Error(std::string("invalid JSON response: invalid escape ") + c);
+    }
+}
+
+std::size_t JsonStreamParser::_parse_number(const std::string_view &chunk, std::size_t pos) {
+    auto end = pos;
+    while (end < chunk.size()) {
+        auto c = chunk[end];
+        if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '-' || c == '+') {
+            ++end;
+        } else {
+            break;
+        }
+    }
+
+    if (end == chunk.size()) {
+        // The number might continue in the next chunk.
+        _buf.append(chunk.data() + pos, end - pos);
+        return end;
+    }
+
+    if (_buf.empty()) {
+        _on_number(chunk.substr(pos, end - pos));
+    } else {
+        _buf.append(chunk.data() + pos, end - pos);
+        _on_number(_buf);
+    }
+
+    _end_value();
+
+    return end;
+}
+
+std::size_t JsonStreamParser::_parse_literal(const std::string_view &chunk, std::size_t pos) {
+    while (pos < chunk.size() && chunk[pos] >= 'a' && chunk[pos] <= 'z') {
+        _buf.push_back(chunk[pos]);
+        ++pos;
+    }
+
+    if (pos == chunk.size()) {
+        return pos;
+    }
+
+    if (_buf != "true" && _buf != "false" && _buf != "null") {
+        throw Error("invalid JSON response: unknown literal " + _buf);
+    }
+
+    _end_value();
+
+    return pos;
+}
+
+void JsonStreamParser::_end_value() {
+    _buf.clear();
+    _state = _stack.empty() ? State::DONE : State::COMMA;
+}
+
+EmbeddingResponseParser::EmbeddingResponseParser(std::size_t dim, std::size_t count) :
+    _embeddings(count), _indices(count) {
+    for (auto &embedding : _embeddings) {
+        embedding.reserve(dim);
+    }
+}
+
+Vector EmbeddingResponseParser::embedding() {
+    finish();
+
+    if (_embeddings.empty() || _embeddings.front().empty()) {
+        throw Error("invalid embedding response");
+    }
+
+    return std::move(_embeddings.front());
+}
+
+std::vector<Vector> EmbeddingResponseParser::embeddings() {
+    finish();
+
+    std::vector<Vector> output(_embeddings.size());
+    for (std::size_t pos = 0; pos != _embeddings.size(); ++pos) {
+        auto idx = _indices[pos].value_or(pos);
+        if (idx >= output.size() || !output[idx].empty() || _embeddings[pos].empty()) {
+            throw Error("invalid embedding response: missing or duplicate embedding");
+        }
+
+        output[idx] = std::move(_embeddings[pos]);
+    }
+
+    return output;
+}
+
+void EmbeddingResponseParser::_on_number(const std::string_view &num) {
+    const auto &frames = _frames();
+    if (frames.size() == 3 && !frames[2].is_array && frames[2].key == "index"
+            && frames[1].is_array && frames[1].index < _indices.size()
+            && frames[0].key == "data") {
+        // {"data": [{"index": 0}]}
+        std::size_t idx = 0;
+        auto [ptr, ec] = std::from_chars(num.data(), num.data() + num.size(), idx);
+        if (ec != std::errc() || ptr != num.data() + num.size()) {
+            throw Error("invalid embedding response: invalid index " + std::string(num));
+        }
+
+        _indices[frames[1].index] = idx;
+
+        return;
+    }
+
+    // {"data": [{"embedding": [...]}]}
+    if (frames.size() != 4 || !frames[3].is_array
+            || frames[2].key != "embedding"
+            || !frames[1].is_array
+            || frames[0].key != "data") {
+        return;
+    }
+
+    auto *embedding = _embedding(frames[1].index);
+    if (embedding == nullptr) {
+        return;
+    }
+
+    float val = 0;
+    auto [ptr, ec] = std::from_chars(num.data(), num.data() + num.size(), val);
+    if (ec != std::errc() || ptr != num.data() + num.size()) {
+        throw Error("invalid embedding response: invalid number " + std::string(num));
+    }
+
+    embedding->push_back(val);
+}
+
+void EmbeddingResponseParser::_on_string(std::string &str) {
+    // {"data": [{"embedding": "base64 encoded floats"}]}
+    const auto &frames = _frames();
+    if (frames.size() != 3 || frames[2].is_array || frames[2].key != "embedding"
+            || !frames[1].is_array
+            || frames[0].key != "data") {
+        return;
+    }
+
+    auto *embedding = _embedding(frames[1].index);
+    if (embedding == nullptr) {
+        return;
+    }
+
+    static_assert(sizeof(float) == 4, "float must be 4 bytes");
+
+    // Decode into the vector buffer directly, which has room for the padded bytes.
+    embedding->resize((str.size() / 4 * 3 + sizeof(float) - 1) / sizeof(float));
+    auto bytes = util::base64_decode(str, reinterpret_cast<char *>(embedding->data()));
+    if (bytes % sizeof(float) != 0) {
+        throw Error("invalid embedding response: invalid base64 embedding");
+    }
+
+    embedding->resize(bytes / sizeof(float));
+}
+
+Vector* EmbeddingResponseParser::_embedding(std::size_t pos) {
+    if (pos >= _embeddings.size()) {
+        return nullptr;
+    }
+
+    return &_embeddings[pos];
+}
+
+std::string ChatResponseParser::content() {
+    finish();
+
+    if (!_content) {
+        throw Error("invalid chat choices");
+    }
+
+    return std::move(*_content);
+}
+
+void ChatResponseParser::_on_string(std::string &str) {
+    // {"choices": [{"message": {"content": "..."}}]}
+    const auto &frames = _frames();
+    if (frames.size() != 4 || frames[3].is_array || frames[3].key != "content"
+            || frames[2].key != "message"
+            || !frames[1].is_array || frames[1].index != 0
+            || frames[0].key != "choices") {
+        return;
+    }
+
+    _content = std::move(str);
+}
+
+}
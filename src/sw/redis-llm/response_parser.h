@@ -0,0 +1,155 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SEWENEW_REDIS_LLM_RESPONSE_PARSER_H
+#define SEWENEW_REDIS_LLM_RESPONSE_PARSER_H
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "sw/redis-llm/utils.h"
+
+namespace sw::redis::llm {
+
+// Incremental JSON parser for LLM responses. It's fed with chunks of the response body
+// as they arrive, and reports scalar values with their paths, without building a DOM.
+class JsonStreamParser {
+public:
+    JsonStreamParser() = default;
+
+    JsonStreamParser(const JsonStreamParser &) = delete;
+    JsonStreamParser& operator=(const JsonStreamParser &) = delete;
+
+    JsonStreamParser(JsonStreamParser &&) = delete;
+    JsonStreamParser& operator=(JsonStreamParser &&) = delete;
+
+    virtual ~JsonStreamParser() = default;
+
+    void feed(const std::string_view &chunk);
+
+    // Throw Error, if the input is not a complete JSON value.
+    void finish();
+
+protected:
+    // An object or array that contains the current value.
+    struct Frame {
+        bool is_array = false;
+
+        // Key of the current value, if it's an object.
+        std::string key;
+
+        // Index of the current value, if it's an array.
+        std::size_t index = 0;
+    };
+
+    const std::vector<Frame>& _frames() const {
+        return _stack;
+    }
+
+    virtual void _on_number(const std::string_view & /*num*/) {}
+
+    virtual void _on_string(std::string & /*str*/) {}
+
+private:
+    enum class State {
+        VALUE,
+        FIRST_VALUE,
+        KEY,
+        FIRST_KEY,
+        COLON,
+        COMMA,
+        STRING,
+        NUMBER,
+        LITERAL,
+        DONE
+    };
+
+    // Return whether c is consumed.
+    bool _parse_token(char c);
+
+    std::size_t _parse_string(const std::string_view &chunk, std::size_t pos);
+
+    void _parse_escape(char c);
+
+    std::size_t _parse_number(const std::string_view &chunk, std::size_t pos);
+
+    std::size_t _parse_literal(const std::string_view &chunk, std::size_t pos);
+
+    void _end_value();
+
+    State _state = State::VALUE;
+
+    std::vector<Frame> _stack;
+
+    // Buffer for the current string, number or literal.
+    std::string _buf;
+
+    bool _is_key = false;
+
+    bool _escape = false;
+
+    // Number of hex digits left for \uXXXX escape, and the code points.
+    int _unicode_left = 0;
+
+    uint32_t _unicode = 0;
+
+    uint32_t _high_surrogate = 0;
+};
+
+// Extract data[i].embedding from an embedding response of *count* inputs. The embedding
+// can be either an array of floats, or a base64 encoded string of little-endian floats.
+class EmbeddingResponseParser : public JsonStreamParser {
+public:
+    // Reserve *dim* floats beforehand, e.g. dimension of the last response.
+    explicit EmbeddingResponseParser(std::size_t dim = 0, std::size_t count = 1);
+
+    // Throw Error, if there's no embedding in the response.
+    Vector embedding();
+
+    // Embeddings in the order of inputs, i.e. ordered by data[i].index.
+    // Throw Error, if any of them is missing.
+    std::vector<Vector> embeddings();
+
+private:
+    virtual void _on_number(const std::string_view &num) override;
+
+    virtual void _on_string(std::string &str) override;
+
+    // Embedding of data[pos], or nullptr if pos is out of range.
+    Vector* _embedding(std::size_t pos);
+
+    std::vector<Vector> _embeddings;
+
+    // data[i].index, if the response has it.
+    std::vector<std::optional<std::size_t>> _indices;
+};
+
+// Extract choices[0].message.content from a chat completion response.
+class ChatResponseParser : public JsonStreamParser {
+public:
+    // Throw Error, if there's no content in the response.
+    std::string content();
+
+private:
+    virtual void _on_string(std::string &str) override;
+
+    std::optional<std::string> _content;
+};
+
+}
+
+#endif // end SEWENEW_REDIS_LLM_RESPONSE_PARSER_H
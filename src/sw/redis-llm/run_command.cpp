@@ -17,11 +17,20 @@
 #include "sw/redis-llm/run_command.h"
 #include <cassert>
 #include "sw/redis-llm/application.h"
+#include "sw/redis-llm/cancel.h"
+#include "sw/redis-llm/job.h"
 #include "sw/redis-llm/redis_llm.h"
+#include "sw/redis-llm/slowlog.h"
+#include "sw/redis-llm/stats.h"
 
 namespace sw::redis::llm {
 
 void RunCommand::_run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) const {
+    if (RedisModule_IsKeysPositionRequest(ctx)) {
+        _report_keys(ctx, argv, argc);
+        return;
+    }
+
     auto args = _parse_args(argv, argc);
 
     auto &llm = RedisLlm::instance();
@@ -37,10 +46,54 @@ void RunCommand::_run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) c
 
     auto application = std::static_pointer_cast<Application>(app->shared_from_this());
     auto llm_model = std::static_pointer_cast<LlmModel>(model->shared_from_this());
+
+    if (!args.async_key.empty()) {
+        // LLM.RUN is readonly, so that it can run on replicas, and when OOM.
+        // However, async job writes the result, so check it here.
+        auto flags = RedisModule_GetContextFlags(ctx);
+        if (flags & REDISMODULE_CTX_FLAGS_SLAVE) {
+            throw Error("async job is not allowed on replica");
+        }
+
+        if (flags & REDISMODULE_CTX_FLAGS_OOM) {
+            throw Error("async job is not allowed when used memory > 'maxmemory'");
+        }
+
+        args.db = RedisModule_GetSelectedDb(ctx);
+
+        auto &jobs = JobManager::instance();
+        auto job_id = jobs.create();
+
+        // Key name is used by the job after this command returns.
+        RedisModule_RetainString(ctx, args.key_name);
+        try {
+            TaskOptions task_opts;
+            task_opts.priority = TaskPriority::BACKGROUND;
+            llm.worker_pool().enqueue(task_opts, &RunCommand::_run_async, this, job_id,
+                    args, std::string(args.input), application, llm_model);
+        } catch (const Error &err) {
+            RedisModule_FreeString(ctx, args.key_name);
+            jobs.finish(job_id, std::string(err.what()));
+
+            throw;
+        }
+
+        auto id = std::to_string(job_id);
+        RedisModule_ReplyWithStringBuffer(ctx, id.data(), id.size());
+
+        return;
+    }
+
     auto *blocked_client = RedisModule_BlockClient(ctx, _reply_func, _timeout_func, _free_func, args.timeout.count());
+    auto &registry = CancelRegistry::instance();
+    auto token = registry.watch(blocked_client);
+
     try {
-        llm.worker_pool().enqueue(&RunCommand::_run_impl, this, blocked_client, args, application, llm_model);
+        llm.worker_pool().enqueue(_blocking_task_options(args.start, args.timeout, token),
+                &RunCommand::_run_impl, this, blocked_client,
+                args, application, llm_model, token);
     } catch (const Error &err) {
+        registry.unwatch(blocked_client);
         RedisModule_AbortBlock(blocked_client);
 
         api::reply_with_error(ctx, err);
@@ -48,25 +101,141 @@ void RunCommand::_run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) c
 }
 
 void RunCommand::_run_impl(RedisModuleBlockedClient *blocked_client,
-        const Args &args, const ApplicationSPtr &app, const LlmModelSPtr &model) const {
-    assert(blocked_client != nullptr && app && model);
+        const Args &args, const ApplicationSPtr &app, const LlmModelSPtr &model,
+        const CancelTokenSPtr &token) const {
+    assert(blocked_client != nullptr && app && model && token);
 
     auto result = std::make_unique<AsyncResult>();
+    result->start = args.start;
+    if (args.profile) {
+        result->profile = std::make_unique<Profile>();
+        result->profile->record_since("queue", args.start);
+    }
+
+    ProfileScope scope(result->profile.get());
+    SlowLogScope slowlog_scope(args.origin);
+    CancelScope cancel_scope(token.get());
 
     try {
-        nlohmann::json context;
-        if (!args.vars.is_null()) {
-            context["vars"] = args.vars;
-        }
+        // Client timed out or disconnected while the task was queued.
+        token->check();
 
-        result->output = app->run(blocked_client, *model, context, args.input, args.verbose);
+        result->output = app->run(blocked_client, *model, _context(args), args.input, args.verbose);
+    } catch (const CancelledError &) {
+        Stats::instance().incr(Counter::TASKS_CANCELLED);
+        result->err = std::current_exception();
     } catch (const Error &) {
         result->err = std::current_exception();
     }
 
+    CancelRegistry::instance().unwatch(blocked_client);
+
+    result->unblock_time = std::chrono::steady_clock::now();
     RedisModule_UnblockClient(blocked_client, result.release());
 }
 
+void RunCommand::_run_async(uint64_t job_id, const Args &args, const std::string &input,
+        const ApplicationSPtr &app, const LlmModelSPtr &model) const {
+    assert(app && model);
+
+    auto &jobs = JobManager::instance();
+    jobs.start(job_id);
+
+    std::string output;
+    std::optional<std::string> error;
+    {
+        SlowLogScope slowlog_scope(args.origin);
+
+        try {
+            // There's no blocked client, so tell application which db to use.
+            auto context = _context(args);
+            context["db"] = args.db;
+
+            output = app->run(nullptr, *model, context, input, args.verbose);
+        } catch (const std::exception &e) {
+            error = e.what();
+        }
+    }
+
+    try {
+        _write_result(job_id, args, output, error);
+    } catch (const Error &e) {
+        if (!error) {
+            error = e.what();
+        }
+    }
+
+    jobs.finish(job_id, std::move(error));
+}
+
+void RunCommand::_write_result(uint64_t job_id, const Args &args,
+        const std::string &output, const std::optional<std::string> &error) const {
+    auto id = std::to_string(job_id);
+    const auto &key = args.async_key;
+
+    auto *ctx = RedisModule_GetThreadSafeContext(nullptr);
+    RedisModule_ThreadSafeContextLock(ctx);
+
+    RedisModule_SelectDb(ctx, args.db);
+
+    // RedisModule_Call does not check maxmemory, and the job might finish long after
+    // the command has been accepted.
+    auto oom = (RedisModule_GetContextFlags(ctx) & REDISMODULE_CTX_FLAGS_OOM) != 0;
+
+    // Replicate the write with '!' flag.
+    RedisModuleCallReply *reply = nullptr;
+    if (oom) {
+        // Do nothing.
+    } else if (args.async_stream) {
+        if (error) {
+            reply = RedisModule_Call(ctx, "XADD", "!bccccccb", key.data(), key.size(),
+                    "*", "job", id.data(), "status", "failed", "error", error->data(), error->size());
+        } else {
+            reply = RedisModule_Call(ctx, "XADD", "!bccccccb", key.data(), key.size(),
+                    "*", "job", id.data(), "status", "done", "result", output.data(), output.size());
+        }
+    } else if (!error) {
+        reply = RedisModule_Call(ctx, "SET", "!bb", key.data(), key.size(), output.data(), output.size());
+    }
+
+    std::string err;
+    if (reply != nullptr) {
+        if (RedisModule_CallReplyType(reply) == REDISMODULE_REPLY_ERROR) {
+            std::size_t len = 0;
+            const auto *msg = RedisModule_CallReplyStringPtr(reply, &len);
+            err = "failed to write result: " + std::string(msg, len);
+        }
+
+        RedisModule_FreeCallReply(reply);
+    } else if (oom) {
+        err = "failed to write result: OOM, used memory > 'maxmemory'";
+    } else if (args.async_stream || !error) {
+        err = "failed to write result";
+    }
+
+    RedisModule_FreeString(ctx, args.key_name);
+
+    RedisModule_ThreadSafeContextUnlock(ctx);
+    RedisModule_FreeThreadSafeContext(ctx);
+
+    if (!err.empty()) {
+        throw Error(err);
+    }
+}
+
+nlohmann::json RunCommand::_context(const Args &args) const {
+    nlohmann::json context;
+    if (!args.vars.is_null()) {
+        context["vars"] = args.vars;
+    }
+
+    if (!args.session.empty()) {
+        context["session"] = args.session;
+    }
+
+    return context;
+}
+
 RunCommand::Args RunCommand::_parse_args(RedisModuleString **argv, int argc) const {
     assert(argv != nullptr);
 
@@ -76,6 +245,7 @@ RunCommand::Args RunCommand::_parse_args(RedisModuleString **argv, int argc) con
 
     Args args;
     args.key_name = argv[1];
+    args.origin = SlowLog::origin("LLM.RUN", args.key_name);
 
     auto idx = 2;
     while (idx < argc) {
@@ -86,8 +256,37 @@ RunCommand::Args RunCommand::_parse_args(RedisModuleString **argv, int argc) con
             }
             ++idx;
             args.vars = util::to_json(argv[idx]);
+        } else if (util::str_case_equal(opt, "--SESSION")) {
+            if (idx + 1 >= argc) {
+                throw Error("syntax error");
+            }
+            ++idx;
+            args.session = util::to_string(argv[idx]);
         } else if (util::str_case_equal(opt, "--VERBOSE")) {
             args.verbose = true;
+        } else if (util::str_case_equal(opt, "--PROFILE")) {
+            args.profile = true;
+        } else if (util::str_case_equal(opt, "--TIMEOUT")) {
+            if (idx + 1 >= argc) {
+                throw Error("syntax error");
+            }
+            ++idx;
+            try {
+                args.timeout = std::chrono::milliseconds(std::stoul(util::to_string(argv[idx])));
+            } catch (const std::exception &e) {
+                throw Error(std::string("timeout should be a number: ") + e.what());
+            }
+        } else if (util::str_case_equal(opt, "--ASYNC") || util::str_case_equal(opt, "--ASYNC-STREAM")) {
+            if (idx + 1 >= argc) {
+                throw Error("syntax error");
+            }
+            args.async_stream = util::str_case_equal(opt, "--ASYNC-STREAM");
+            ++idx;
+            args.async_key = util::to_string(argv[idx]);
+            args.async_key_pos = idx;
+            if (args.async_key.empty()) {
+                throw Error("result key should not be empty");
+            }
         } else {
             break;
         }
@@ -104,13 +303,41 @@ RunCommand::Args RunCommand::_parse_args(RedisModuleString **argv, int argc) con
         throw WrongArityError();
     }
 
+    if (!args.async_key.empty() && args.profile) {
+        throw Error("--PROFILE cannot be used with async job");
+    }
+
     return args;
 }
 
+void RunCommand::_report_keys(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) const {
+    if (argc < 2) {
+        return;
+    }
+
+    RedisModule_KeyAtPos(ctx, 1);
+
+    try {
+        auto args = _parse_args(argv, argc);
+        if (args.async_key_pos > 0) {
+            RedisModule_KeyAtPos(ctx, args.async_key_pos);
+        }
+    } catch (const Error &) {
+        // There's no client to reply to. The error is replied when the command runs.
+    }
+}
+
 int RunCommand::_reply_func(RedisModuleCtx *ctx, RedisModuleString ** /*argv*/, int /*argc*/) {
     auto *res = static_cast<AsyncResult *>(RedisModule_GetBlockedClientPrivateData(ctx));
     assert(res != nullptr);
 
+    LatencyTimer timer(Latency::REPLY);
+
+    auto &profile = res->profile;
+    if (profile) {
+        profile->begin_reply(ctx, res->unblock_time);
+    }
+
     if (res->err) {
         try {
             std::rethrow_exception(res->err);
@@ -121,10 +348,19 @@ int RunCommand::_reply_func(RedisModuleCtx *ctx, RedisModuleString ** /*argv*/,
         RedisModule_ReplyWithStringBuffer(ctx, res->output.data(), res->output.size());
     }
 
+    Stats::instance().record_since(Latency::CMD_RUN, res->start);
+
+    if (profile) {
+        profile->end_reply(ctx, res->start);
+    }
+
     return REDISMODULE_OK;
 }
 
 int RunCommand::_timeout_func(RedisModuleCtx *ctx, RedisModuleString ** /*argv*/, int /*argc*/) {
+    // Client gets nothing from the task any more, so give it up.
+    CancelRegistry::instance().cancel(ctx);
+
     return RedisModule_ReplyWithNull(ctx);
 }
 
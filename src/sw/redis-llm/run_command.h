@@ -19,16 +19,21 @@
 
 #include <chrono>
 #include <exception>
+#include <memory>
+#include <optional>
+#include <string>
 #include "nlohmann/json.hpp"
 #include "sw/redis-llm/application.h"
+#include "sw/redis-llm/cancel.h"
 #include "sw/redis-llm/command.h"
 #include "sw/redis-llm/module_api.h"
 #include "sw/redis-llm/llm_model.h"
+#include "sw/redis-llm/profile.h"
 #include "sw/redis-llm/utils.h"
 
 namespace sw::redis::llm {
 
-// LLM.RUN key [--VARS '{"user" : "Jim"}'] [--PARAMS '{}'] [--VERBOSE] [--TIMEOUT in-milliseconds] [input]
+// LLM.RUN key [--VARS '{"user" : "Jim"}'] [--PARAMS '{}'] [--SESSION session-id] [--VERBOSE] [--PROFILE] [--TIMEOUT in-milliseconds] [--ASYNC result-key | --ASYNC-STREAM stream-key] [input]
 // This command works with APP
 class RunCommand : public Command {
 private:
@@ -37,25 +42,73 @@ private:
     struct Args {
         RedisModuleString *key_name = nullptr;
 
+        // Originating command for slow log. It's copied, since key_name might be
+        // freed while the task is running, e.g. client times out or disconnects.
+        std::string origin;
+
         nlohmann::json vars;
 
+        // Session id for chat application.
+        std::string session;
+
         std::string_view input;
 
         bool verbose = false;
 
+        bool profile = false;
+
         std::chrono::milliseconds timeout{0};
+
+        // If not empty, run as an async job, and write result into this key with SET,
+        // or into this stream with XADD if async_stream is true.
+        std::string async_key;
+
+        bool async_stream = false;
+
+        // Position of async_key in argv, or 0 if not specified.
+        int async_key_pos = 0;
+
+        // Selected db of the client, used by async job.
+        int db = 0;
+
+        // Time when the command is received.
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
     };
 
     struct AsyncResult {
         std::string output;
 
         std::exception_ptr err;
+
+        // Time when the command is received.
+        std::chrono::steady_clock::time_point start;
+
+        // Time when the worker unblocks the client.
+        std::chrono::steady_clock::time_point unblock_time;
+
+        // Not null, if --PROFILE is specified.
+        std::unique_ptr<Profile> profile;
     };
 
     Args _parse_args(RedisModuleString **argv, int argc) const;
 
+    // Report the app key and the result key, if any, so that Redis checks them
+    // for cluster slots.
+    void _report_keys(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) const;
+
     void _run_impl(RedisModuleBlockedClient *blocked_client,
-            const Args &args, const ApplicationSPtr &app, const LlmModelSPtr &model) const;
+            const Args &args, const ApplicationSPtr &app, const LlmModelSPtr &model,
+            const CancelTokenSPtr &token) const;
+
+    void _run_async(uint64_t job_id, const Args &args, const std::string &input,
+            const ApplicationSPtr &app, const LlmModelSPtr &model) const;
+
+    // Write result of an async job, and release the key name retained for the job.
+    // Throw Error, if it fails to write the result.
+    void _write_result(uint64_t job_id, const Args &args,
+            const std::string &output, const std::optional<std::string> &error) const;
+
+    nlohmann::json _context(const Args &args) const;
 
     static int _reply_func(RedisModuleCtx *ctx, RedisModuleString **argv, int argc);
 
@@ -15,6 +15,8 @@
  *************************************************************************/
 
 #include "sw/redis-llm/search_application.h"
+#include <limits>
+#include "sw/redis-llm/profile.h"
 #include "sw/redis-llm/redis_llm.h"
 
 namespace sw::redis::llm {
@@ -24,7 +26,8 @@ SearchApplication::SearchApplication(const LlmInfo &llm,
     Application("search", llm, conf),
     _prompt(conf.value<std::string>("prompt", _default_prompt)),
     _vector_store(conf.at("vector-store").get<std::string>()),
-    _k(conf.at("k").get<std::size_t>()) {}
+    _k(conf.at("k").get<std::size_t>()),
+    _token_budget(conf.value<std::size_t>("token_budget", 0)) {}
 
 std::string SearchApplication::run(RedisModuleBlockedClient *blocked_client, LlmModel &model, const nlohmann::json &context, const std::string_view &input, bool verbose) {
     /*
@@ -36,8 +39,11 @@ std::string SearchApplication::run(RedisModuleBlockedClient *blocked_client, Llm
     VectorStoreSPtr vector_store;
     LlmModelSPtr llm_model;
 
-    auto *ctx = RedisModule_GetThreadSafeContext(blocked_client);
-    RedisModule_ThreadSafeContextLock(ctx);
+    auto *ctx = _thread_safe_context(blocked_client, context);
+    {
+        ProfileTimer timer("lock");
+        RedisModule_ThreadSafeContextLock(ctx);
+    }
 
     try {
         auto &store = _get_vector_store(ctx, context);
@@ -64,16 +70,17 @@ std::string SearchApplication::run(RedisModuleBlockedClient *blocked_client, Llm
     if (!context.is_null()) {
         vars = context.value<nlohmann::json>("vars", nlohmann::json::object());
     }
-    vars["question"] = std::string(input);
-    std::string ctx_var;
-    for (auto &item : similar_items) {
-        if (!ctx_var.empty()) {
-            ctx_var += "\n";
-        }
-        ctx_var += item;
+
+    auto budget = std::numeric_limits<std::size_t>::max();
+    if (_token_budget > 0) {
+        // Tokens left for context, after rendering the prompt with an empty context.
+        auto tokens = RedisLlm::instance().count_tokens(
+                _prompt.render(PromptVars{{"question", input}, {"context", ""}}, vars));
+        budget = _token_budget > tokens ? _token_budget - tokens : 0;
     }
-    vars["context"] = ctx_var;
-    auto request = _prompt.render(vars);
+
+    auto context_var = _pack_context(similar_items, budget);
+    auto request = _prompt.render(PromptVars{{"question", input}, {"context", context_var}}, vars);
 
     std::string output;
     if (verbose) {
@@ -81,7 +88,11 @@ std::string SearchApplication::run(RedisModuleBlockedClient *blocked_client, Llm
         output += "\n\n";
     }
 
-    output += model.predict(request, llm().params);
+    auto reply = model.predict(request, llm().params);
+
+    Profile::add_tokens({request}, reply);
+
+    output += reply;
 
     return output;
 }
@@ -95,6 +106,26 @@ VectorStore& SearchApplication::_get_vector_store(RedisModuleCtx *ctx, const nlo
     return *store;
 }
 
+std::string SearchApplication::_pack_context(const std::vector<std::string> &items, std::size_t budget) const {
+    auto &llm = RedisLlm::instance();
+    std::string context;
+    for (auto &item : items) {
+        // Items are sorted by similarity, stop at the first one that does not fit.
+        auto tokens = llm.count_tokens(item) + (context.empty() ? 0 : 1);
+        if (tokens > budget) {
+            break;
+        }
+        budget -= tokens;
+
+        if (!context.empty()) {
+            context += "\n";
+        }
+        context += item;
+    }
+
+    return context;
+}
+
 std::vector<std::string> SearchApplication::_get_similar_items(const Vector &embedding, VectorStore &store) {
     auto neighbors = store.knn(embedding, _k);
     std::vector<std::string> items;
@@ -36,12 +36,18 @@ private:
 
     std::vector<std::string> _get_similar_items(const Vector &embedding, VectorStore &store);
 
+    // Join items into context within *budget* tokens.
+    std::string _pack_context(const std::vector<std::string> &items, std::size_t budget) const;
+
     Prompt _prompt;
 
     std::string _vector_store;
 
     std::size_t _k;
 
+    // Max number of tokens of the request sent to LLM. 0 means no limit.
+    std::size_t _token_budget;
+
     inline static const std::string _default_prompt = R"(Please answer the following question based on the given context.
 Context: """
 {{context}}
@@ -15,6 +15,7 @@
  *************************************************************************/
 
 #include "sw/redis-llm/simple_application.h"
+#include "sw/redis-llm/profile.h"
 
 namespace sw::redis::llm {
 
@@ -41,7 +42,11 @@ std::string SimpleApplication::run(RedisModuleBlockedClient * /*blocked_client*/
         output += "\n\n";
     }
 
-    output += model.predict(request, llm().params);
+    auto reply = model.predict(request, llm().params);
+
+    Profile::add_tokens({request}, reply);
+
+    output += reply;
 
     return output;
 }
@@ -50,7 +50,7 @@ uint64_t SizeCommand::_size(RedisModuleCtx *ctx, RedisModuleString **argv, int a
         return 0;
     }
 
-    return store->data_store().size();
+    return store->size();
 }
 
 }
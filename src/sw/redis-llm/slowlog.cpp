@@ -0,0 +1,96 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/slowlog.h"
+#include <algorithm>
+#include <cassert>
+#include "sw/redis-llm/utils.h"
+
+namespace sw::redis::llm {
+
+thread_local const std::string *SlowLog::_origin = nullptr;
+
+SlowLog& SlowLog::instance() {
+    static SlowLog slowlog;
+
+    return slowlog;
+}
+
+void SlowLog::set_options(const SlowLogOptions &opts) {
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    _opts = opts;
+}
+
+void SlowLog::add(SlowLogEntry entry) {
+    entry.timestamp = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    if (_opts.max_len == 0) {
+        return;
+    }
+
+    entry.id = _next_id++;
+    _entries.push_front(std::move(entry));
+
+    while (_entries.size() > _opts.max_len) {
+        _entries.pop_back();
+    }
+}
+
+std::vector<SlowLogEntry> SlowLog::get(std::size_t count) const {
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    count = std::min(count, _entries.size());
+
+    return std::vector<SlowLogEntry>(_entries.begin(), _entries.begin() + count);
+}
+
+std::size_t SlowLog::len() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    return _entries.size();
+}
+
+void SlowLog::reset() {
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    _entries.clear();
+}
+
+std::string SlowLog::current_command() {
+    if (_origin == nullptr) {
+        return "";
+    }
+
+    return *_origin;
+}
+
+std::string SlowLog::origin(const char *command, RedisModuleString *key) {
+    assert(command != nullptr);
+
+    std::string origin = command;
+    if (key != nullptr) {
+        origin += " ";
+        origin += util::to_sv(key);
+    }
+
+    return origin;
+}
+
+}
@@ -0,0 +1,150 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SEWENEW_REDIS_LLM_SLOWLOG_H
+#define SEWENEW_REDIS_LLM_SLOWLOG_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "sw/redis-llm/redismodule.h"
+
+namespace sw::redis::llm {
+
+struct SlowLogOptions {
+    // Log outbound calls slower than this in microseconds. Negative disables the log,
+    // while 0 logs every call.
+    long long log_slower_than = 1000000;
+
+    std::size_t max_len = 128;
+};
+
+// An outbound call to LLM provider, which exceeds the threshold.
+struct SlowLogEntry {
+    uint64_t id = 0;
+
+    // Unix timestamp in seconds.
+    int64_t timestamp = 0;
+
+    uint64_t duration_us = 0;
+
+    // Originating command and its key, e.g. "LLM.RUN app-key". Empty for background tasks.
+    std::string command;
+
+    std::string uri;
+
+    std::size_t request_bytes = 0;
+
+    std::size_t response_bytes = 0;
+
+    // HTTP status code. 0, if no response is received.
+    long status = 0;
+
+    // HttpClient does not retry, but follows redirects.
+    long redirects = 0;
+
+    bool connection_reused = false;
+
+    // Time spent to establish TCP connection, TLS handshake, and to receive the first byte.
+    uint64_t connect_us = 0;
+    uint64_t tls_us = 0;
+    uint64_t first_byte_us = 0;
+
+    // Transport error, if any.
+    std::string error;
+};
+
+// Ring buffer of slow outbound calls, similar to Redis SLOWLOG.
+class SlowLog {
+public:
+    static SlowLog& instance();
+
+    SlowLog(const SlowLog &) = delete;
+    SlowLog& operator=(const SlowLog &) = delete;
+
+    SlowLog(SlowLog &&) = delete;
+    SlowLog& operator=(SlowLog &&) = delete;
+
+    // Should only be called when module is loaded.
+    void set_options(const SlowLogOptions &opts);
+
+    // Check it before building an entry, so that fast calls cost nothing.
+    bool slow(std::chrono::microseconds duration) const {
+        return _opts.log_slower_than >= 0 && duration.count() >= _opts.log_slower_than;
+    }
+
+    // Assign id and timestamp, and add the entry, evicting the oldest one if it's full.
+    void add(SlowLogEntry entry);
+
+    // Return at most *count* latest entries, newest first.
+    std::vector<SlowLogEntry> get(std::size_t count) const;
+
+    std::size_t len() const;
+
+    void reset();
+
+    // Originating command of outbound calls made by the current thread, or empty string.
+    static std::string current_command();
+
+    // Format originating *command* on *key*, e.g. "LLM.RUN app-key". It must be called in
+    // the command thread, since *key* is freed once the client times out or disconnects.
+    static std::string origin(const char *command, RedisModuleString *key);
+
+private:
+    friend class SlowLogScope;
+
+    SlowLog() = default;
+
+    // Points to the command of the innermost SlowLogScope, or nullptr.
+    static thread_local const std::string *_origin;
+
+    SlowLogOptions _opts;
+
+    uint64_t _next_id = 0;
+
+    // Newest at front.
+    std::deque<SlowLogEntry> _entries;
+
+    mutable std::mutex _mtx;
+};
+
+// Mark outbound calls in the enclosing scope as originated from *command*,
+// which is created with SlowLog::origin.
+class SlowLogScope {
+public:
+    explicit SlowLogScope(std::string command) : _command(std::move(command)), _prev(SlowLog::_origin) {
+        SlowLog::_origin = &_command;
+    }
+
+    SlowLogScope(const SlowLogScope &) = delete;
+    SlowLogScope& operator=(const SlowLogScope &) = delete;
+
+    ~SlowLogScope() {
+        SlowLog::_origin = _prev;
+    }
+
+private:
+    std::string _command;
+
+    const std::string *_prev;
+};
+
+}
+
+#endif // end SEWENEW_REDIS_LLM_SLOWLOG_H
@@ -0,0 +1,126 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/slowlog_command.h"
+#include <cstring>
+#include "sw/redis-llm/errors.h"
+#include "sw/redis-llm/utils.h"
+
+namespace {
+
+void reply_field(RedisModuleCtx *ctx, const char *field, long long value) {
+    RedisModule_ReplyWithStringBuffer(ctx, field, std::strlen(field));
+    RedisModule_ReplyWithLongLong(ctx, value);
+}
+
+void reply_field(RedisModuleCtx *ctx, const char *field, const std::string &value) {
+    RedisModule_ReplyWithStringBuffer(ctx, field, std::strlen(field));
+    RedisModule_ReplyWithStringBuffer(ctx, value.data(), value.size());
+}
+
+}
+
+namespace sw::redis::llm {
+
+void SlowlogCommand::_run(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) const {
+    auto args = _parse_args(argv, argc);
+
+    auto &slowlog = SlowLog::instance();
+    switch (args.op) {
+    case Op::GET: {
+        auto entries = slowlog.get(args.count);
+        RedisModule_ReplyWithArray(ctx, entries.size());
+        for (const auto &entry : entries) {
+            _reply_entry(ctx, entry);
+        }
+        break;
+    }
+
+    case Op::LEN:
+        RedisModule_ReplyWithLongLong(ctx, slowlog.len());
+        break;
+
+    case Op::RESET:
+        slowlog.reset();
+        RedisModule_ReplyWithSimpleString(ctx, "OK");
+        break;
+
+    default:
+        assert(false);
+        break;
+    }
+}
+
+SlowlogCommand::Args SlowlogCommand::_parse_args(RedisModuleString **argv, int argc) const {
+    assert(argv != nullptr);
+
+    if (argc < 2) {
+        throw WrongArityError();
+    }
+
+    Args args;
+
+    auto op = util::to_sv(argv[1]);
+    if (util::str_case_equal(op, "GET")) {
+        args.op = Op::GET;
+        if (argc > 3) {
+            throw WrongArityError();
+        }
+
+        if (argc == 3) {
+            try {
+                args.count = std::stoul(util::to_string(argv[2]));
+            } catch (const std::exception &e) {
+                throw Error(std::string("invalid count: ") + e.what());
+            }
+        }
+    } else if (util::str_case_equal(op, "LEN")) {
+        args.op = Op::LEN;
+        if (argc != 2) {
+            throw WrongArityError();
+        }
+    } else if (util::str_case_equal(op, "RESET")) {
+        args.op = Op::RESET;
+        if (argc != 2) {
+            throw WrongArityError();
+        }
+    } else {
+        throw Error("unknown subcommand: " + std::string(op));
+    }
+
+    return args;
+}
+
+void SlowlogCommand::_reply_entry(RedisModuleCtx *ctx, const SlowLogEntry &entry) const {
+    // 14 field-value pairs.
+    RedisModule_ReplyWithArray(ctx, 14 * 2);
+    reply_field(ctx, "id", entry.id);
+    reply_field(ctx, "timestamp", entry.timestamp);
+    reply_field(ctx, "duration_us", entry.duration_us);
+    reply_field(ctx, "command", entry.command);
+    reply_field(ctx, "uri", entry.uri);
+    reply_field(ctx, "status", entry.status);
+    reply_field(ctx, "request_bytes", entry.request_bytes);
+    reply_field(ctx, "response_bytes", entry.response_bytes);
+    reply_field(ctx, "redirects", entry.redirects);
+    reply_field(ctx, "connection_reused", entry.connection_reused ? 1 : 0);
+    reply_field(ctx, "connect_us", entry.connect_us);
+    reply_field(ctx, "tls_us", entry.tls_us);
+    reply_field(ctx, "first_byte_us", entry.first_byte_us);
+    reply_field(ctx, "error", entry.error);
+}
+
+}
@@ -0,0 +1,283 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/stats.h"
+#include <algorithm>
+#include <cassert>
+#include "sw/redis-llm/profile.h"
+
+namespace sw::redis::llm {
+
+const char* latency_name(Latency type) {
+    switch (type) {
+    case Latency::CMD_ADD:
+        return "cmd_add";
+
+    case Latency::CMD_KNN:
+        return "cmd_knn";
+
+    case Latency::CMD_RUN:
+        return "cmd_run";
+
+    case Latency::QUEUE_WAIT:
+        return "queue_wait";
+
+    case Latency::EMBEDDING:
+        return "embedding";
+
+    case Latency::KNN:
+        return "knn";
+
+    case Latency::RENDER:
+        return "render";
+
+    case Latency::PREDICT:
+        return "predict";
+
+    case Latency::REPLY:
+        return "reply";
+
+    default:
+        assert(false);
+        return "unknown";
+    }
+}
+
+}
+
+namespace {
+
+using namespace sw::redis::llm;
+
+const char* counter_name(Counter type) {
+    switch (type) {
+    case Counter::TASKS:
+        return "tasks";
+
+    case Counter::TASKS_REJECTED:
+        return "tasks_rejected";
+
+    case Counter::TASKS_CANCELLED:
+        return "tasks_cancelled";
+
+    case Counter::TASKS_EXPIRED:
+        return "tasks_expired";
+
+    case Counter::TASKS_LATE:
+        return "tasks_late";
+
+    case Counter::HTTP_REQUESTS:
+        return "http_requests";
+
+    case Counter::HTTP_ERRORS:
+        return "http_errors";
+
+    case Counter::HTTP_429:
+        return "http_429";
+
+    case Counter::HTTP_CANCELLED:
+        return "http_cancelled";
+
+    case Counter::HTTP_FAILOVERS:
+        return "http_failovers";
+
+    case Counter::HTTP_HEDGES:
+        return "http_hedges";
+
+    case Counter::HTTP_HEDGE_WINS:
+        return "http_hedge_wins";
+
+    case Counter::HTTP_CONNECTIONS:
+        return "http_connections";
+
+    case Counter::HTTP_CONNECTIONS_IN_USE:
+        return "http_connections_in_use";
+
+    case Counter::HTTP_POOL_WAITS:
+        return "http_pool_waits";
+
+    case Counter::EMBEDDING_BATCHES:
+        return "embedding_batches";
+
+    case Counter::EMBEDDING_BATCHED_INPUTS:
+        return "embedding_batched_inputs";
+
+    default:
+        assert(false);
+        return "unknown";
+    }
+}
+
+template <typename T>
+void add_relaxed(std::atomic<T> &val, T delta) {
+    val.store(val.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+}
+
+namespace sw::redis::llm {
+
+std::size_t Histogram::bucket(uint64_t val) {
+    if (val < SUB_BUCKETS) {
+        return val;
+    }
+
+    // Index of the highest bit, which is at least 3.
+    auto exp = static_cast<std::size_t>(63 - __builtin_clzll(val));
+    auto sub = (val >> (exp - 3)) & (SUB_BUCKETS - 1);
+
+    return std::min(SUB_BUCKETS + (exp - 3) * SUB_BUCKETS + sub, BUCKETS - 1);
+}
+
+uint64_t Histogram::value(std::size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+
+    auto exp = (bucket - SUB_BUCKETS) / SUB_BUCKETS + 3;
+    auto sub = (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+
+    return ((SUB_BUCKETS + sub + 1) << (exp - 3)) - 1;
+}
+
+uint64_t Histogram::percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+
+    auto rank = static_cast<uint64_t>(p * count);
+    uint64_t seen = 0;
+    for (std::size_t idx = 0; idx != BUCKETS; ++idx) {
+        seen += buckets[idx];
+        if (seen > rank) {
+            return std::min(value(idx), max);
+        }
+    }
+
+    return max;
+}
+
+Stats& Stats::instance() {
+    static Stats stats;
+
+    return stats;
+}
+
+void Stats::record(Latency type, std::chrono::steady_clock::duration latency) {
+    auto us = static_cast<uint64_t>(std::max<int64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(latency).count(), 0));
+    auto idx = static_cast<std::size_t>(type);
+
+    auto &local = _local();
+    add_relaxed<uint64_t>(local.buckets[idx][Histogram::bucket(us)], 1);
+    add_relaxed<uint64_t>(local.sums[idx], us);
+    if (us > local.maxes[idx].load(std::memory_order_relaxed)) {
+        local.maxes[idx].store(us, std::memory_order_relaxed);
+    }
+}
+
+void Stats::incr(Counter type, int64_t delta) {
+    add_relaxed<int64_t>(_local().counters[static_cast<std::size_t>(type)], delta);
+}
+
+Histogram Stats::histogram(Latency type) const {
+    auto idx = static_cast<std::size_t>(type);
+
+    Histogram hist;
+
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    for (const auto &local : _threads) {
+        for (std::size_t bucket = 0; bucket != Histogram::BUCKETS; ++bucket) {
+            auto cnt = local->buckets[idx][bucket].load(std::memory_order_relaxed);
+            hist.buckets[bucket] += cnt;
+            hist.count += cnt;
+        }
+        hist.sum += local->sums[idx].load(std::memory_order_relaxed);
+        hist.max = std::max(hist.max, local->maxes[idx].load(std::memory_order_relaxed));
+    }
+
+    return hist;
+}
+
+int64_t Stats::counter(Counter type) const {
+    auto idx = static_cast<std::size_t>(type);
+
+    int64_t val = 0;
+
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    for (const auto &local : _threads) {
+        val += local->counters[idx].load(std::memory_order_relaxed);
+    }
+
+    return val;
+}
+
+std::vector<std::pair<std::string, long long>> Stats::counters() const {
+    std::vector<std::pair<std::string, long long>> fields;
+    for (std::size_t idx = 0; idx != static_cast<std::size_t>(Counter::MAX); ++idx) {
+        auto type = static_cast<Counter>(idx);
+        fields.emplace_back(counter_name(type), counter(type));
+    }
+
+    return fields;
+}
+
+std::vector<std::pair<std::string, long long>> Stats::latencies() const {
+    std::vector<std::pair<std::string, long long>> fields;
+    for (std::size_t idx = 0; idx != static_cast<std::size_t>(Latency::MAX); ++idx) {
+        auto type = static_cast<Latency>(idx);
+        auto hist = histogram(type);
+        std::string name = latency_name(type);
+
+        fields.emplace_back(name + "_count", hist.count);
+        fields.emplace_back(name + "_mean_us", hist.count == 0 ? 0 : hist.sum / hist.count);
+        fields.emplace_back(name + "_p50_us", hist.percentile(0.5));
+        fields.emplace_back(name + "_p90_us", hist.percentile(0.9));
+        fields.emplace_back(name + "_p99_us", hist.percentile(0.99));
+        fields.emplace_back(name + "_p999_us", hist.percentile(0.999));
+        fields.emplace_back(name + "_max_us", hist.max);
+    }
+
+    return fields;
+}
+
+Stats::ThreadStats& Stats::_local() {
+    thread_local ThreadStats *local = nullptr;
+    if (local == nullptr) {
+        auto stats = std::make_unique<ThreadStats>();
+        local = stats.get();
+
+        std::lock_guard<std::mutex> lock(_mtx);
+        _threads.push_back(std::move(stats));
+    }
+
+    return *local;
+}
+
+LatencyTimer::~LatencyTimer() {
+    auto latency = std::chrono::steady_clock::now() - _start;
+
+    Stats::instance().record(_type, latency);
+
+    auto *profile = Profile::current();
+    if (profile != nullptr) {
+        profile->record(latency_name(_type), latency);
+    }
+}
+
+}
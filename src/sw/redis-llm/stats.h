@@ -0,0 +1,176 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SEWENEW_REDIS_LLM_STATS_H
+#define SEWENEW_REDIS_LLM_STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace sw::redis::llm {
+
+// Latency of commands and stages of the pipeline.
+enum class Latency : std::size_t {
+    CMD_ADD = 0,
+    CMD_KNN,
+    CMD_RUN,
+
+    // Time a task waits in the worker queue.
+    QUEUE_WAIT,
+    EMBEDDING,
+    KNN,
+    RENDER,
+    PREDICT,
+    // Time to reply a blocked client.
+    REPLY,
+
+    MAX
+};
+
+enum class Counter : std::size_t {
+    TASKS = 0,
+    TASKS_REJECTED,
+    // Number of tasks given up, because their clients timed out or disconnected.
+    TASKS_CANCELLED,
+    // Number of tasks dropped because they were not started before deadline, and tasks
+    // finished after deadline.
+    TASKS_EXPIRED,
+    TASKS_LATE,
+    HTTP_REQUESTS,
+    HTTP_ERRORS,
+    HTTP_429,
+    // Number of calls aborted in flight, because their clients timed out or disconnected.
+    HTTP_CANCELLED,
+    // Number of requests retried on another endpoint after failures, hedged requests sent
+    // to another endpoint after a slow response, and hedged requests that won.
+    HTTP_FAILOVERS,
+    HTTP_HEDGES,
+    HTTP_HEDGE_WINS,
+    // Number of created connections, and connections fetched from pools.
+    HTTP_CONNECTIONS,
+    HTTP_CONNECTIONS_IN_USE,
+    // Number of times waiting for a free connection.
+    HTTP_POOL_WAITS,
+    // Number of embedding requests sent in batches, and inputs of these requests.
+    EMBEDDING_BATCHES,
+    EMBEDDING_BATCHED_INPUTS,
+
+    MAX
+};
+
+const char* latency_name(Latency type);
+
+// HDR style histogram of latencies in microseconds. Values are grouped by power of 2,
+// and each group is split into 8 linear buckets, i.e. relative error is at most 12.5%.
+struct Histogram {
+    static constexpr std::size_t SUB_BUCKETS = 8;
+
+    static constexpr std::size_t BUCKETS = SUB_BUCKETS * 41;
+
+    static std::size_t bucket(uint64_t val);
+
+    // Upper bound of the bucket.
+    static uint64_t value(std::size_t bucket);
+
+    // Return the value at the given percentile, e.g. 0.99.
+    uint64_t percentile(double p) const;
+
+    std::array<uint64_t, BUCKETS> buckets = {};
+
+    uint64_t count = 0;
+
+    uint64_t sum = 0;
+
+    uint64_t max = 0;
+};
+
+// Counters are recorded into per-thread slots without locks, and aggregated on read.
+class Stats {
+public:
+    static Stats& instance();
+
+    Stats(const Stats &) = delete;
+    Stats& operator=(const Stats &) = delete;
+
+    Stats(Stats &&) = delete;
+    Stats& operator=(Stats &&) = delete;
+
+    void record(Latency type, std::chrono::steady_clock::duration latency);
+
+    void record_since(Latency type, std::chrono::steady_clock::time_point start) {
+        record(type, std::chrono::steady_clock::now() - start);
+    }
+
+    void incr(Counter type, int64_t delta = 1);
+
+    Histogram histogram(Latency type) const;
+
+    int64_t counter(Counter type) const;
+
+    // Counters and latency summaries (in microseconds) as field-value pairs.
+    std::vector<std::pair<std::string, long long>> counters() const;
+
+    std::vector<std::pair<std::string, long long>> latencies() const;
+
+private:
+    Stats() = default;
+
+    // Slots of a thread. Only the owner thread writes, so relaxed load and store are enough.
+    struct ThreadStats {
+        std::array<std::array<std::atomic<uint64_t>, Histogram::BUCKETS>,
+            static_cast<std::size_t>(Latency::MAX)> buckets = {};
+
+        std::array<std::atomic<uint64_t>, static_cast<std::size_t>(Latency::MAX)> sums = {};
+
+        std::array<std::atomic<uint64_t>, static_cast<std::size_t>(Latency::MAX)> maxes = {};
+
+        std::array<std::atomic<int64_t>, static_cast<std::size_t>(Counter::MAX)> counters = {};
+    };
+
+    ThreadStats& _local();
+
+    // Slots of exited threads are kept, so that their counters are not lost.
+    mutable std::mutex _mtx;
+
+    std::vector<std::unique_ptr<ThreadStats>> _threads;
+};
+
+// Record latency of the enclosing scope, and also add it to the current request's profile if any.
+class LatencyTimer {
+public:
+    explicit LatencyTimer(Latency type) : _type(type), _start(std::chrono::steady_clock::now()) {}
+
+    LatencyTimer(const LatencyTimer &) = delete;
+    LatencyTimer& operator=(const LatencyTimer &) = delete;
+
+    ~LatencyTimer();
+
+private:
+    Latency _type;
+
+    std::chrono::steady_clock::time_point _start;
+};
+
+}
+
+#endif // end SEWENEW_REDIS_LLM_STATS_H
@@ -0,0 +1,38 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/stats_command.h"
+#include "sw/redis-llm/errors.h"
+#include "sw/redis-llm/module_api.h"
+#include "sw/redis-llm/redis_llm.h"
+
+namespace sw::redis::llm {
+
+void StatsCommand::_run(RedisModuleCtx *ctx, RedisModuleString ** /*argv*/, int argc) const {
+    if (argc != 1) {
+        throw WrongArityError();
+    }
+
+    auto fields = RedisLlm::instance().stats();
+
+    RedisModule_ReplyWithArray(ctx, fields.size() * 2);
+    for (const auto &[field, value] : fields) {
+        RedisModule_ReplyWithStringBuffer(ctx, field.data(), field.size());
+        RedisModule_ReplyWithLongLong(ctx, value);
+    }
+}
+
+}
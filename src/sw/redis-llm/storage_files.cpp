@@ -0,0 +1,220 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/storage_files.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string_view>
+#include <dirent.h>
+
+namespace sw::redis::llm {
+
+StorageFiles& StorageFiles::instance() {
+    static StorageFiles storage_files;
+
+    return storage_files;
+}
+
+void StorageFiles::set_options(const StorageFilesOptions &opts) {
+    _opts = opts;
+}
+
+std::string StorageFiles::create() {
+    std::random_device rd;
+    std::mt19937_64 gen(rd());
+
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    while (true) {
+        char buf[17];
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(gen()));
+
+        auto prefix = std::string("redis-llm-") + buf;
+        if (_prefixes.find(prefix) == _prefixes.end()) {
+            _prefixes[prefix].refs = 1;
+
+            return prefix;
+        }
+    }
+}
+
+void StorageFiles::acquire(const std::string &prefix) {
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    auto &info = _prefixes[prefix];
+    ++info.refs;
+    info.saves = 0;
+}
+
+void StorageFiles::release(const std::string &prefix) {
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    auto iter = _prefixes.find(prefix);
+    if (iter == _prefixes.end() || iter->second.refs == 0) {
+        return;
+    }
+
+    auto &info = iter->second;
+    if (--info.refs == 0) {
+        info.released_at = now;
+        info.saves = 0;
+    }
+}
+
+bool StorageFiles::empty() const {
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    return _prefixes.empty();
+}
+
+void StorageFiles::collect(long long last_save, bool aof) {
+    if (_opts.retention < 0) {
+        return;
+    }
+
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    auto expired = now - _opts.retention * 1000;
+
+    std::lock_guard<std::mutex> lock(_mtx);
+
+    auto new_save = (last_save != _last_save);
+    _last_save = last_save;
+
+    // Save time is truncated to seconds, so versions written in the last second of the save
+    // are taken as newer than the save, and kept.
+    auto durable = static_cast<int64_t>(last_save) * 1000;
+
+    // Versions of known prefixes in the working directory, i.e. Redis' dir.
+    std::unordered_map<std::string, std::vector<int64_t>> files;
+    auto *dir = opendir(".");
+    if (dir == nullptr) {
+        return;
+    }
+
+    while (auto *entry = readdir(dir)) {
+        std::string_view name(entry->d_name);
+        for (const std::string_view ext : {".index", ".data"}) {
+            if (name.size() <= ext.size() || name.substr(name.size() - ext.size()) != ext) {
+                continue;
+            }
+
+            auto file = name.substr(0, name.size() - ext.size());
+            auto pos = file.rfind('.');
+            if (pos == std::string_view::npos) {
+                break;
+            }
+
+            auto iter = _prefixes.find(std::string(file.substr(0, pos)));
+            if (iter == _prefixes.end()) {
+                break;
+            }
+
+            int64_t version = 0;
+            auto first = file.data() + pos + 1;
+            auto last = file.data() + file.size();
+            auto [ptr, ec] = std::from_chars(first, last, version);
+            if (ec == std::errc() && ptr == last) {
+                files[iter->first].push_back(version);
+            }
+
+            break;
+        }
+    }
+
+    closedir(dir);
+
+    for (auto iter = _prefixes.begin(); iter != _prefixes.end(); ) {
+        auto &[prefix, info] = *iter;
+
+        auto all = false;
+        if (info.refs == 0) {
+            // The first save finished after release might be forked before release,
+            // and still reference the files. The second one must be forked after release.
+            if (new_save && durable > info.released_at) {
+                ++info.saves;
+            }
+
+            all = (info.released_at < expired && (aof || info.saves >= 2));
+        }
+
+        auto versions = files.find(prefix);
+        if (versions != files.end()) {
+            _remove(prefix, versions->second, _opts.keep_versions, expired,
+                    aof ? 0 : durable, all);
+        }
+
+        if (all) {
+            iter = _prefixes.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+std::string StorageFiles::new_version(const std::string &prefix) {
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+
+    return prefix + "." + std::to_string(now);
+}
+
+std::string StorageFiles::prefix(const std::string &file) {
+    return file.substr(0, file.rfind('.'));
+}
+
+void StorageFiles::_remove(const std::string &prefix, std::vector<int64_t> &versions,
+        std::size_t keep, int64_t expired, int64_t durable, bool all) {
+    std::sort(versions.begin(), versions.end());
+    versions.erase(std::unique(versions.begin(), versions.end()), versions.end());
+
+    auto last = versions.end();
+    if (!all) {
+        // Always keep the newest one.
+        last -= std::min(std::max<std::size_t>(keep, 1), versions.size());
+
+        if (durable > 0) {
+            // The newest version not newer than the last successful save is referenced by it.
+            // Newer versions are written by failed or ongoing saves, and might be referenced later.
+            auto referenced = std::upper_bound(versions.begin(), versions.end(), durable);
+            if (referenced == versions.begin()) {
+                return;
+            }
+
+            last = std::min(last, referenced - 1);
+        }
+    }
+
+    for (auto iter = versions.begin(); iter != last; ++iter) {
+        // A version is superseded when the next one is written. RDB backups taken
+        // before that still reference it.
+        if (!all && *(iter + 1) >= expired) {
+            break;
+        }
+
+        auto file = prefix + "." + std::to_string(*iter);
+        std::remove(index_path(file).data());
+        std::remove(data_path(file).data());
+    }
+}
+
+}
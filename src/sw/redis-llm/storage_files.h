@@ -0,0 +1,118 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SEWENEW_REDIS_LLM_STORAGE_FILES_H
+#define SEWENEW_REDIS_LLM_STORAGE_FILES_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sw::redis::llm {
+
+struct StorageFilesOptions {
+    // Min number of the newest versions kept for each vector store.
+    std::size_t keep_versions = 2;
+
+    // Seconds to keep a version after it's superseded by a newer one, or after its vector
+    // store is deleted, so that RDB backups taken within this window can still be restored.
+    // Negative means files are never removed, and it's up to the user.
+    long long retention = 3600;
+};
+
+// Files of vector stores with mmap storage. Each dump writes a new version of files, named
+// as *prefix.version*, where prefix is unique to a vector store, and version is the dump time
+// in milliseconds. RDB references a version by name, so a failed dump or BGSAVE never
+// touches files referenced by the last successful RDB.
+class StorageFiles {
+public:
+    static StorageFiles& instance();
+
+    StorageFiles(const StorageFiles &) = delete;
+    StorageFiles& operator=(const StorageFiles &) = delete;
+
+    StorageFiles(StorageFiles &&) = delete;
+    StorageFiles& operator=(StorageFiles &&) = delete;
+
+    // Should only be called when module is loaded.
+    void set_options(const StorageFilesOptions &opts);
+
+    // Create a new prefix, and acquire it.
+    std::string create();
+
+    // Acquire *prefix*, e.g. when loading a vector store from its files.
+    void acquire(const std::string &prefix);
+
+    // Release *prefix*, e.g. when the vector store is deleted. Its files are removed, once
+    // they are out of the retention window, and no longer referenced by the last successful
+    // RDB or AOF rewrite.
+    void release(const std::string &prefix);
+
+    bool empty() const;
+
+    // Remove versions that are out of the retention window, and are neither referenced by
+    // the last successful RDB, which was saved at *last_save* (Unix time in seconds), nor
+    // written by an ongoing save. If *aof* is true, we cannot tell the version referenced
+    // by the RDB preamble of AOF, so only the retention window and the newest versions
+    // protect it.
+    void collect(long long last_save, bool aof);
+
+    // Name of a new version of files with *prefix*.
+    static std::string new_version(const std::string &prefix);
+
+    static std::string prefix(const std::string &file);
+
+    static std::string index_path(const std::string &file) {
+        return file + ".index";
+    }
+
+    static std::string data_path(const std::string &file) {
+        return file + ".data";
+    }
+
+private:
+    StorageFiles() = default;
+
+    struct Prefix {
+        std::size_t refs = 0;
+
+        // Milliseconds since epoch, when the last reference is released.
+        int64_t released_at = 0;
+
+        // Number of saves finished after released.
+        std::size_t saves = 0;
+    };
+
+    // Remove versions of *prefix* in *versions*, which are superseded before *expired*,
+    // except the newest *keep* ones, and the one referenced by the save at *durable*.
+    // 0 *durable* means it's unknown. If *all* is true, remove all versions.
+    static void _remove(const std::string &prefix, std::vector<int64_t> &versions,
+            std::size_t keep, int64_t expired, int64_t durable, bool all);
+
+    StorageFilesOptions _opts;
+
+    mutable std::mutex _mtx;
+
+    std::unordered_map<std::string, Prefix> _prefixes;
+
+    long long _last_save = 0;
+};
+
+}
+
+#endif // end SEWENEW_REDIS_LLM_STORAGE_FILES_H
@@ -0,0 +1,490 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#include "sw/redis-llm/tokenizer.h"
+#include <cctype>
+#include <fstream>
+#include <limits>
+#include <tuple>
+#include "sw/redis-llm/errors.h"
+#include "sw/redis-llm/utils.h"
+
+namespace {
+
+constexpr uint32_t NO_RANK = std::numeric_limits<uint32_t>::max();
+
+// Vocabularies with more tokens than this are split with o200k_base's pattern.
+constexpr std::size_t O200K_MIN_VOCAB_SIZE = 150000;
+
+// Decode a UTF-8 code point at pos. Return the code point and its length in bytes.
+// Invalid byte is returned as is with length 1.
+std::pair<uint32_t, std::size_t> decode_utf8(const std::string_view &text, std::size_t pos) {
+    auto c = static_cast<unsigned char>(text[pos]);
+    if (c < 0x80) {
+        return {c, 1};
+    }
+
+    std::size_t len = 0;
+    uint32_t cp = 0;
+    if ((c & 0xE0) == 0xC0) {
+        len = 2;
+        cp = c & 0x1F;
+    } else if ((c & 0xF0) == 0xE0) {
+        len = 3;
+        cp = c & 0x0F;
+    } else if ((c & 0xF8) == 0xF0) {
+        len = 4;
+        cp = c & 0x07;
+    } else {
+        return {c, 1};
+    }
+
+    if (pos + len > text.size()) {
+        return {c, 1};
+    }
+
+    for (std::size_t idx = 1; idx < len; ++idx) {
+        auto cc = static_cast<unsigned char>(text[pos + idx]);
+        if ((cc & 0xC0) != 0x80) {
+            return {c, 1};
+        }
+        cp = (cp << 6) | (cc & 0x3F);
+    }
+
+    return {cp, len};
+}
+
+bool is_space(uint32_t cp) {
+    return (cp >= 0x09 && cp <= 0x0D) || cp == 0x20 || cp == 0x85 || cp == 0xA0
+        || cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200A) || cp == 0x2028
+        || cp == 0x2029 || cp == 0x202F || cp == 0x205F || cp == 0x3000;
+}
+
+bool is_number(uint32_t cp) {
+    return (cp >= '0' && cp <= '9') || (cp >= 0xFF10 && cp <= 0xFF19);
+}
+
+// Approximation of \p{L}: non-ASCII code points are treated as letters,
+// except for common punctuation and symbol blocks.
+bool is_letter(uint32_t cp) {
+    if (cp < 0x80) {
+        return (cp >= 'a' && cp <= 'z') || (cp >= 'A' && cp <= 'Z');
+    }
+
+    if (is_space(cp) || is_number(cp)) {
+        return false;
+    }
+
+    return !((cp >= 0xA1 && cp <= 0xBF) || cp == 0xD7 || cp == 0xF7
+            || (cp >= 0x2000 && cp <= 0x2BFF)
+            || (cp >= 0x3000 && cp <= 0x303F)
+            || (cp >= 0xFE30 && cp <= 0xFE4F)
+            || (cp >= 0xFF00 && cp <= 0xFF20)
+            || (cp >= 0xFF3B && cp <= 0xFF40)
+            || (cp >= 0xFF5B && cp <= 0xFF65)
+            || (cp >= 0x1F000 && cp <= 0x1FAFF));
+}
+
+bool is_newline(uint32_t cp) {
+    return cp == '\r' || cp == '\n';
+}
+
+enum class LetterCase {
+    NONE,
+    UPPER,
+    LOWER,
+    // Letters without case, e.g. CJK, which match both upper and lower classes of o200k_base.
+    OTHER
+};
+
+// Approximation of \p{Lu}/\p{Lt} and \p{Ll}: exact for ASCII, and covers Latin, Greek and
+// Cyrillic blocks. Other letters are taken as caseless.
+LetterCase letter_case(uint32_t cp) {
+    if (!is_letter(cp)) {
+        return LetterCase::NONE;
+    }
+
+    auto alternate = [](uint32_t c) {
+        return (c % 2 == 0) ? LetterCase::UPPER : LetterCase::LOWER;
+    };
+
+    if (cp < 0x80) {
+        return (cp >= 'A' && cp <= 'Z') ? LetterCase::UPPER : LetterCase::LOWER;
+    } else if (cp >= 0xC0 && cp <= 0xFF) {
+        return cp <= 0xDE ? LetterCase::UPPER : LetterCase::LOWER;
+    } else if (cp >= 0x100 && cp <= 0x17F) {
+        if (cp == 0x138 || cp == 0x149 || cp == 0x17F) {
+            return LetterCase::LOWER;
+        }
+
+        if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) {
+            return alternate(cp + 1);
+        }
+
+        return alternate(cp);
+    } else if (cp >= 0x250 && cp <= 0x2AF) {
+        return LetterCase::LOWER;
+    } else if (cp == 0x386 || (cp >= 0x388 && cp <= 0x3AB)) {
+        return LetterCase::UPPER;
+    } else if (cp >= 0x3AC && cp <= 0x3CE) {
+        return LetterCase::LOWER;
+    } else if (cp >= 0x3D8 && cp <= 0x3EF) {
+        return alternate(cp);
+    } else if (cp >= 0x400 && cp <= 0x42F) {
+        return LetterCase::UPPER;
+    } else if (cp >= 0x430 && cp <= 0x45F) {
+        return LetterCase::LOWER;
+    } else if ((cp >= 0x460 && cp <= 0x481) || (cp >= 0x48A && cp <= 0x4FF)
+            || (cp >= 0x1E00 && cp <= 0x1EFF)) {
+        return alternate(cp);
+    } else if (cp >= 0xFF21 && cp <= 0xFF3A) {
+        return LetterCase::UPPER;
+    } else if (cp >= 0xFF41 && cp <= 0xFF5A) {
+        return LetterCase::LOWER;
+    }
+
+    return LetterCase::OTHER;
+}
+
+// Length of contraction at pos, i.e. (?i:'s|'t|'re|'ve|'m|'ll|'d), or 0 if there's none.
+std::size_t match_contraction(const std::string_view &text, std::size_t pos) {
+    auto size = text.size();
+    if (pos + 1 >= size || text[pos] != '\'') {
+        return 0;
+    }
+
+    auto lower = [&text](std::size_t idx) {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(text[idx])));
+    };
+
+    auto c = lower(pos + 1);
+    if (c == 's' || c == 't' || c == 'm' || c == 'd') {
+        return 2;
+    }
+
+    if (pos + 2 < size) {
+        auto cc = lower(pos + 2);
+        if ((c == 'r' && cc == 'e') || (c == 'v' && cc == 'e') || (c == 'l' && cc == 'l')) {
+            return 3;
+        }
+    }
+
+    return 0;
+}
+
+// Length of the piece starting at pos, matched with alternatives shared by cl100k_base and
+// o200k_base, i.e. all but the letter ones:
+// \p{N}{1,3}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+
+// o200k_base also takes '/' as a trailing character of punctuations.
+std::size_t match_non_letters(const std::string_view &text, std::size_t pos, bool o200k) {
+    auto size = text.size();
+    auto [cp, len] = decode_utf8(text, pos);
+
+    // \p{N}{1,3}
+    std::size_t end = pos;
+    if (is_number(cp)) {
+        for (auto cnt = 0; cnt < 3 && end < size; ++cnt) {
+            auto [c, l] = decode_utf8(text, end);
+            if (!is_number(c)) {
+                break;
+            }
+            end += l;
+        }
+        return end - pos;
+    }
+
+    // ` ?[^\s\p{L}\p{N}]+[\r\n]*`
+    auto start = (cp == ' ') ? pos + 1 : pos;
+    end = start;
+    while (end < size) {
+        auto [c, l] = decode_utf8(text, end);
+        if (is_space(c) || is_letter(c) || is_number(c)) {
+            break;
+        }
+        end += l;
+    }
+    if (end > start) {
+        while (end < size && (is_newline(static_cast<unsigned char>(text[end]))
+                    || (o200k && text[end] == '/'))) {
+            ++end;
+        }
+        return end - pos;
+    }
+
+    if (!is_space(cp)) {
+        return len;
+    }
+
+    // Whitespaces.
+    std::size_t last_newline_end = 0;
+    std::size_t last_space_start = pos;
+    end = pos;
+    while (end < size) {
+        auto [c, l] = decode_utf8(text, end);
+        if (!is_space(c)) {
+            break;
+        }
+        last_space_start = end;
+        end += l;
+        if (is_newline(c)) {
+            last_newline_end = end;
+        }
+    }
+
+    // \s*[\r\n]+
+    if (last_newline_end > 0) {
+        return last_newline_end - pos;
+    }
+
+    // \s+(?!\S)
+    if (end < size && last_space_start > pos) {
+        return last_space_start - pos;
+    }
+
+    // \s+
+    return end - pos;
+}
+
+// Length of the piece starting at pos, matched with cl100k_base's pre-tokenization regex:
+// (?i:'s|'t|'re|'ve|'m|'ll|'d)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}{1,3}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+
+std::size_t match_cl100k_piece(const std::string_view &text, std::size_t pos) {
+    auto size = text.size();
+
+    auto contraction = match_contraction(text, pos);
+    if (contraction > 0) {
+        return contraction;
+    }
+
+    // [^\r\n\p{L}\p{N}]?\p{L}+
+    auto [cp, len] = decode_utf8(text, pos);
+    auto start = pos;
+    if (!is_letter(cp) && !is_number(cp) && !is_newline(cp)) {
+        start += len;
+    }
+    auto end = start;
+    while (end < size) {
+        auto [c, l] = decode_utf8(text, end);
+        if (!is_letter(c)) {
+            break;
+        }
+        end += l;
+    }
+    if (end > start) {
+        return end - pos;
+    }
+
+    return match_non_letters(text, pos, false);
+}
+
+// Length of the piece starting at pos, matched with o200k_base's pre-tokenization regex,
+// where U is [\p{Lu}\p{Lt}\p{Lm}\p{Lo}\p{M}], L is [\p{Ll}\p{Lm}\p{Lo}\p{M}], and C is
+// (?i:'s|'t|'re|'ve|'m|'ll|'d):
+// [^\r\n\p{L}\p{N}]?U*L+C?|[^\r\n\p{L}\p{N}]?U+L*C?|\p{N}{1,3}| ?[^\s\p{L}\p{N}]+[\r\n/]*|\s*[\r\n]+|\s+(?!\S)|\s+
+std::size_t match_o200k_piece(const std::string_view &text, std::size_t pos) {
+    auto size = text.size();
+
+    auto [cp, len] = decode_utf8(text, pos);
+    auto start = pos;
+    if (!is_letter(cp) && !is_number(cp) && !is_newline(cp)) {
+        start += len;
+    }
+
+    // U*, and the end of its last caseless letter, which is also matched by L.
+    auto end = start;
+    std::size_t other_end = 0;
+    while (end < size) {
+        auto [c, l] = decode_utf8(text, end);
+        auto letter = letter_case(c);
+        if (letter != LetterCase::UPPER && letter != LetterCase::OTHER) {
+            break;
+        }
+        end += l;
+        if (letter == LetterCase::OTHER) {
+            other_end = end;
+        }
+    }
+
+    // L+ after U*. If there's none, backtrack U* so that L+ takes its last caseless letter.
+    auto upper_end = end;
+    while (end < size) {
+        auto [c, l] = decode_utf8(text, end);
+        auto letter = letter_case(c);
+        if (letter != LetterCase::LOWER && letter != LetterCase::OTHER) {
+            break;
+        }
+        end += l;
+    }
+
+    if (end == upper_end && other_end > 0) {
+        // U*L+ matches up to the last caseless letter of U*.
+        end = other_end;
+    }
+
+    // If L+ fails, U+L* still matches U+, i.e. all the letters.
+    if (end > start) {
+        return end - pos + match_contraction(text, end);
+    }
+
+    return match_non_letters(text, pos, true);
+}
+
+}
+
+namespace sw::redis::llm {
+
+Tokenizer::Tokenizer(const std::string &vocab_file) {
+    _load(vocab_file);
+}
+
+std::vector<uint32_t> Tokenizer::encode(const std::string_view &text) const {
+    std::vector<uint32_t> tokens;
+    _encode(text, [&tokens](uint32_t token) { tokens.push_back(token); });
+
+    return tokens;
+}
+
+std::size_t Tokenizer::count(const std::string_view &text) const {
+    std::size_t cnt = 0;
+    _encode(text, [&cnt](uint32_t) { ++cnt; });
+
+    return cnt;
+}
+
+void Tokenizer::_load(const std::string &vocab_file) {
+    std::ifstream file(vocab_file);
+    if (!file) {
+        throw Error("failed to open tokenizer vocab file: " + vocab_file);
+    }
+
+    // Offset, length and rank of each token.
+    std::vector<std::tuple<std::size_t, std::size_t, uint32_t>> tokens;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty()) {
+            continue;
+        }
+
+        auto pos = line.find(' ');
+        if (pos == std::string::npos) {
+            throw Error("invalid tokenizer vocab line: " + line);
+        }
+
+        uint32_t rank = 0;
+        try {
+            rank = std::stoul(line.substr(pos + 1));
+        } catch (const std::exception &) {
+            throw Error("invalid tokenizer vocab line: " + line);
+        }
+
+        auto token = util::base64_decode(std::string_view(line.data(), pos));
+        tokens.emplace_back(_tokens.size(), token.size(), rank);
+        _tokens += token;
+    }
+
+    if (tokens.empty()) {
+        throw Error("empty tokenizer vocab file: " + vocab_file);
+    }
+
+    _ranks.reserve(tokens.size());
+    for (const auto &[offset, len, rank] : tokens) {
+        _ranks.emplace(std::string_view(_tokens.data() + offset, len), rank);
+    }
+
+    // cl100k_base has about 100k tokens, while o200k_base has about 200k tokens.
+    _pattern = (_ranks.size() > O200K_MIN_VOCAB_SIZE) ? Pattern::O200K : Pattern::CL100K;
+}
+
+template <typename Output>
+void Tokenizer::_encode(const std::string_view &text, Output &&output) const {
+    auto match_piece = (_pattern == Pattern::O200K) ? match_o200k_piece : match_cl100k_piece;
+
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        auto len = match_piece(text, pos);
+        _encode_piece(text.substr(pos, len), output);
+        pos += len;
+    }
+}
+
+template <typename Output>
+void Tokenizer::_encode_piece(const std::string_view &piece, Output &&output) const {
+    auto rank = _rank(piece);
+    if (rank != NO_RANK) {
+        output(rank);
+        return;
+    }
+
+    // Start position of each part, and rank of merging it with the next part.
+    thread_local std::vector<std::pair<std::size_t, uint32_t>> parts;
+    parts.clear();
+    for (std::size_t idx = 0; idx <= piece.size(); ++idx) {
+        parts.emplace_back(idx, NO_RANK);
+    }
+
+    // Rank of merging parts[idx] with the next 2 parts, i.e. after parts[idx + 1] is removed.
+    auto merged_rank = [this, &piece](std::size_t idx, std::size_t skip) {
+        if (idx + skip + 2 < parts.size()) {
+            auto start = parts[idx].first;
+            return _rank(piece.substr(start, parts[idx + skip + 2].first - start));
+        }
+        return NO_RANK;
+    };
+
+    for (std::size_t idx = 0; idx + 2 < parts.size(); ++idx) {
+        parts[idx].second = merged_rank(idx, 0);
+    }
+
+    while (parts.size() > 2) {
+        auto min_rank = NO_RANK;
+        std::size_t min_idx = 0;
+        for (std::size_t idx = 0; idx + 1 < parts.size(); ++idx) {
+            if (parts[idx].second < min_rank) {
+                min_rank = parts[idx].second;
+                min_idx = idx;
+            }
+        }
+
+        if (min_rank == NO_RANK) {
+            break;
+        }
+
+        parts[min_idx].second = merged_rank(min_idx, 1);
+        if (min_idx > 0) {
+            parts[min_idx - 1].second = merged_rank(min_idx - 1, 1);
+        }
+
+        parts.erase(parts.begin() + min_idx + 1);
+    }
+
+    for (std::size_t idx = 0; idx + 1 < parts.size(); ++idx) {
+        auto start = parts[idx].first;
+        rank = _rank(piece.substr(start, parts[idx + 1].first - start));
+        if (rank != NO_RANK) {
+            output(rank);
+        }
+    }
+}
+
+uint32_t Tokenizer::_rank(const std::string_view &bytes) const {
+    auto iter = _ranks.find(bytes);
+    if (iter == _ranks.end()) {
+        return NO_RANK;
+    }
+
+    return iter->second;
+}
+
+}
@@ -0,0 +1,85 @@
+/**************************************************************************
+   Copyright (c) 2023 sewenew
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+ *************************************************************************/
+
+#ifndef SEWENEW_REDIS_LLM_TOKENIZER_H
+#define SEWENEW_REDIS_LLM_TOKENIZER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace sw::redis::llm {
+
+// Byte pair encoding tokenizer compatible with OpenAI's cl100k_base and o200k_base encodings.
+// Vocabulary is loaded from a tiktoken file, e.g. cl100k_base.tiktoken, in which each line
+// is a base64 encoded token and its rank. Token ranks are also used as merge priorities.
+// Text is split into pieces with the pattern of o200k_base, if the vocabulary is as large
+// as o200k_base's, or with the pattern of cl100k_base otherwise.
+class Tokenizer {
+public:
+    explicit Tokenizer(const std::string &vocab_file);
+
+    Tokenizer(const Tokenizer &) = delete;
+    Tokenizer& operator=(const Tokenizer &) = delete;
+
+    Tokenizer(Tokenizer &&) = delete;
+    Tokenizer& operator=(Tokenizer &&) = delete;
+
+    ~Tokenizer() = default;
+
+    std::vector<uint32_t> encode(const std::string_view &text) const;
+
+    // Number of tokens of the given text, i.e. encode(text).size().
+    std::size_t count(const std::string_view &text) const;
+
+    std::size_t vocab_size() const {
+        return _ranks.size();
+    }
+
+private:
+    void _load(const std::string &vocab_file);
+
+    // Call *output* with each token of text.
+    template <typename Output>
+    void _encode(const std::string_view &text, Output &&output) const;
+
+    template <typename Output>
+    void _encode_piece(const std::string_view &piece, Output &&output) const;
+
+    uint32_t _rank(const std::string_view &bytes) const;
+
+    enum class Pattern {
+        CL100K,
+        O200K
+    };
+
+    // Pre-tokenization pattern.
+    Pattern _pattern = Pattern::CL100K;
+
+    // Decoded bytes of all tokens. Keys of _ranks point to this buffer.
+    std::string _tokens;
+
+    std::unordered_map<std::string_view, uint32_t> _ranks;
+};
+
+using TokenizerUPtr = std::unique_ptr<Tokenizer>;
+
+}
+
+#endif // end SEWENEW_REDIS_LLM_TOKENIZER_H
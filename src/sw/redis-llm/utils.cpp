@@ -15,10 +15,82 @@
  *************************************************************************/
 
 #include "sw/redis-llm/utils.h"
+#include <array>
 #include <cassert>
 #include <cctype>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 #include "sw/redis-llm/errors.h"
 
+namespace {
+
+// Value of each base64 character, and 0xFF for invalid ones.
+const auto BASE64_TABLE = []() {
+    std::array<uint8_t, 256> table;
+    table.fill(0xFF);
+    const std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (std::size_t idx = 0; idx != alphabet.size(); ++idx) {
+        table[static_cast<unsigned char>(alphabet[idx])] = static_cast<uint8_t>(idx);
+    }
+    return table;
+}();
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+
+#define REDIS_LLM_BASE64_SSSE3
+
+// Decode 16 characters into 12 bytes at a time, with the algorithm from Wojciech Mula's
+// "Faster Base64 Encoding and Decoding using AVX2 Instructions". Stop at the first invalid
+// character, and leave the rest, including the padded tail, to the scalar decoder.
+// Return number of characters decoded, which is a multiple of 16.
+__attribute__((target("ssse3")))
+std::size_t base64_decode_ssse3(const unsigned char *in, std::size_t len, unsigned char *out) {
+    const auto lut_lo = _mm_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const auto lut_hi = _mm_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const auto lut_roll = _mm_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71,
+            0, 0, 0, 0, 0, 0, 0, 0);
+    const auto mask_2f = _mm_set1_epi8(0x2F);
+
+    std::size_t idx = 0;
+    // Each iteration writes 16 bytes, i.e. 4 bytes more than decoded. Keep the
+    // last 8 characters, so that we never write beyond the output buffer.
+    for (; idx + 24 <= len; idx += 16) {
+        auto str = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + idx));
+
+        auto hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+        auto lo_nibbles = _mm_and_si128(str, mask_2f);
+        auto hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        auto lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0) {
+            break;
+        }
+
+        auto eq_2f = _mm_cmpeq_epi8(str, mask_2f);
+        auto roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+        str = _mm_add_epi8(str, roll);
+
+        // Pack 4 6-bit values into 3 bytes.
+        auto merged = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+        merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        merged = _mm_shuffle_epi8(merged, _mm_setr_epi8(
+                    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + idx / 4 * 3), merged);
+    }
+
+    return idx;
+}
+
+#endif
+
+}
+
 namespace sw::redis::llm {
 
 LlmInfo::LlmInfo(const std::string_view &info) {
@@ -156,6 +228,139 @@ std::string dump_embedding(const Vector &embedding) {
     return embedding_str;
 }
 
+void append_batch_item(std::string &batch, uint64_t id,
+        const std::string_view &data, const Vector &embedding) {
+    uint32_t data_len = data.size();
+    uint32_t dim = embedding.size();
+
+    batch.append(reinterpret_cast<const char *>(&id), sizeof(id));
+    batch.append(reinterpret_cast<const char *>(&data_len), sizeof(data_len));
+    batch.append(reinterpret_cast<const char *>(&dim), sizeof(dim));
+    batch.append(data.data(), data.size());
+    batch.append(reinterpret_cast<const char *>(embedding.data()), dim * sizeof(float));
+}
+
+std::vector<BatchItem> parse_batch(const std::string_view &batch, std::size_t dim) {
+    std::vector<BatchItem> items;
+
+    const auto *cur = batch.data();
+    const auto *end = cur + batch.size();
+    auto read = [&cur, end](void *dest, std::size_t len) {
+        if (static_cast<std::size_t>(end - cur) < len) {
+            throw Error("invalid batch: truncated");
+        }
+        std::memcpy(dest, cur, len);
+        cur += len;
+    };
+
+    while (cur != end) {
+        BatchItem item;
+        uint32_t data_len = 0;
+        uint32_t item_dim = 0;
+        read(&item.id, sizeof(item.id));
+        read(&data_len, sizeof(data_len));
+        read(&item_dim, sizeof(item_dim));
+
+        if (static_cast<std::size_t>(end - cur) < data_len) {
+            throw Error("invalid batch: truncated");
+        }
+        item.data = std::string_view(cur, data_len);
+        cur += data_len;
+
+        if (item_dim == 0 || (dim != 0 && item_dim != dim)) {
+            throw Error("invalid batch: dimension mismatch");
+        }
+        dim = item_dim;
+
+        // Check length before allocating, so that a bogus dimension cannot force a huge allocation.
+        if (static_cast<std::size_t>(end - cur) / sizeof(float) < dim) {
+            throw Error("invalid batch: truncated");
+        }
+        item.embedding.resize(dim);
+        read(item.embedding.data(), dim * sizeof(float));
+
+        items.push_back(std::move(item));
+    }
+
+    return items;
+}
+
+std::string base64_decode(const std::string_view &input) {
+    std::string output(input.size() / 4 * 3, '\0');
+    output.resize(base64_decode(input, output.data()));
+
+    return output;
+}
+
+std::size_t base64_decode(const std::string_view &input, char *output) {
+    auto len = input.size();
+    while (len > 0 && input[len - 1] == '=') {
+        --len;
+    }
+
+    if (input.size() % 4 != 0 || input.size() - len > 2) {
+        throw Error("invalid base64 string");
+    }
+
+    const auto *in = reinterpret_cast<const unsigned char *>(input.data());
+    auto *out = reinterpret_cast<unsigned char *>(output);
+
+    std::size_t idx = 0;
+#ifdef REDIS_LLM_BASE64_SSSE3
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    if (has_ssse3) {
+        idx = base64_decode_ssse3(in, len, out);
+        out += idx / 4 * 3;
+    }
+#endif
+
+    const auto &table = BASE64_TABLE;
+    for (; idx + 4 <= len; idx += 4) {
+        auto a = table[in[idx]];
+        auto b = table[in[idx + 1]];
+        auto c = table[in[idx + 2]];
+        auto d = table[in[idx + 3]];
+        if ((a | b | c | d) & 0x80) {
+            throw Error("invalid base64 string");
+        }
+
+        uint32_t val = (a << 18) | (b << 12) | (c << 6) | d;
+        *out++ = static_cast<unsigned char>(val >> 16);
+        *out++ = static_cast<unsigned char>(val >> 8);
+        *out++ = static_cast<unsigned char>(val);
+    }
+
+    // Padded tail.
+    auto left = len - idx;
+    if (left == 1) {
+        throw Error("invalid base64 string");
+    } else if (left > 1) {
+        auto a = table[in[idx]];
+        auto b = table[in[idx + 1]];
+        auto c = left == 3 ? table[in[idx + 2]] : 0;
+        if ((a | b | c) & 0x80) {
+            throw Error("invalid base64 string");
+        }
+
+        uint32_t val = (a << 18) | (b << 12) | (c << 6);
+        *out++ = static_cast<unsigned char>(val >> 16);
+        if (left == 3) {
+            *out++ = static_cast<unsigned char>(val >> 8);
+        }
+    }
+
+    return out - reinterpret_cast<unsigned char *>(output);
+}
+
+uint64_t checksum(const char *data, std::size_t len, uint64_t hash) {
+    for (std::size_t idx = 0; idx != len; ++idx) {
+        hash ^= static_cast<unsigned char>(data[idx]);
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
 }
 
 }
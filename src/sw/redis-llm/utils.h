@@ -100,6 +100,35 @@ Vector parse_embedding(const std::string_view &opt);
 
 std::string dump_embedding(const Vector &embedding);
 
+// Items of a batch used by LLM.MADD, with full precision binary embeddings.
+// Each item is encoded as: id (uint64), data length (uint32), dimension (uint32),
+// data, and embedding (dimension float32s). Numbers are in host byte order,
+// i.e. little endian on all supported platforms.
+struct BatchItem {
+    uint64_t id = 0;
+
+    std::string_view data;
+
+    Vector embedding;
+};
+
+void append_batch_item(std::string &batch, uint64_t id,
+        const std::string_view &data, const Vector &embedding);
+
+// All embeddings of the batch must have *dim* dimensions. 0 *dim* means the dimension of
+// the first item. Throw Error, if batch is invalid.
+std::vector<BatchItem> parse_batch(const std::string_view &batch, std::size_t dim = 0);
+
+// Decode standard base64 encoded string. Throw Error, if input is invalid.
+std::string base64_decode(const std::string_view &input);
+
+// Decode base64 into *output*, which must have at least input.size() / 4 * 3 bytes.
+// Return number of decoded bytes. Use SSSE3 instructions if CPU supports.
+std::size_t base64_decode(const std::string_view &input, char *output);
+
+// 64-bit FNV-1a hash of *data*, chained with *hash* of previous data.
+uint64_t checksum(const char *data, std::size_t len, uint64_t hash = 14695981039346656037ULL);
+
 }
 
 }
@@ -15,34 +15,188 @@
  *************************************************************************/
 
 #include "sw/redis-llm/vector_store.h"
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <unordered_set>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "sw/redis-llm/errors.h"
 #include "sw/redis-llm/hnsw.h"
+#include "sw/redis-llm/profile.h"
+#include "sw/redis-llm/stats.h"
+#include "sw/redis-llm/storage_files.h"
+
+namespace {
+
+const std::string DATA_FILE_MAGIC = "LLMDATA1";
+
+// Read-only memory map of a whole file.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path);
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile& operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&) = delete;
+    MappedFile& operator=(MappedFile &&) = delete;
+
+    ~MappedFile();
+
+    const char* data() const {
+        return static_cast<const char *>(_addr);
+    }
+
+    std::size_t size() const {
+        return _size;
+    }
+
+private:
+    void *_addr = nullptr;
+
+    std::size_t _size = 0;
+};
+
+MappedFile::MappedFile(const std::string &path) {
+    auto fd = open(path.data(), O_RDONLY);
+    if (fd < 0) {
+        throw sw::redis::llm::Error("failed to open file: " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw sw::redis::llm::Error("failed to stat file: " + path);
+    }
+
+    _size = st.st_size;
+    if (_size > 0) {
+        _addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (_addr == MAP_FAILED) {
+            close(fd);
+            throw sw::redis::llm::Error("failed to mmap file: " + path);
+        }
+    }
+
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (_addr != nullptr) {
+        munmap(_addr, _size);
+    }
+}
+
+struct ForkState {
+    // Protects stores. Held from prepare to after fork.
+    std::mutex mtx;
+
+    std::unordered_set<sw::redis::llm::VectorStore *> stores;
+
+    // Once set, new operations wait until fork finishes, so that they do not starve
+    // the forking thread, which waits for the exclusive lock.
+    std::atomic<bool> pending{false};
+
+    std::mutex gate_mtx;
+
+    std::condition_variable gate_cv;
+};
+
+ForkState& fork_state() {
+    static ForkState state;
+
+    return state;
+}
+
+template <typename T>
+T read_pod(const char *&cur, const char *end) {
+    if (static_cast<std::size_t>(end - cur) < sizeof(T)) {
+        throw sw::redis::llm::Error("truncated data file");
+    }
+
+    T val;
+    std::memcpy(&val, cur, sizeof(T));
+    cur += sizeof(T);
+
+    return val;
+}
+
+}
 
 namespace sw::redis::llm {
 
+VectorStore::VectorStore(const std::string &type, const nlohmann::json &conf, const LlmInfo &llm) :
+        _type(type), _conf(conf), _dim(0), _llm(llm) {
+    std::string storage;
+    try {
+        storage = conf.value<std::string>("storage", "memory");
+    } catch (const nlohmann::json::exception &e) {
+        throw Error(std::string("invalid storage: ") + e.what());
+    }
+
+    if (storage == "mmap") {
+        _storage_file = StorageFiles::instance().create();
+    } else if (storage != "memory") {
+        throw Error("unknown storage: " + storage);
+    } else {
+        // Only stores dumped into files by the forked child need to be locked on fork.
+        return;
+    }
+
+    static std::once_flag once;
+    std::call_once(once, []() {
+                pthread_atfork(&VectorStore::_prepare_fork,
+                        &VectorStore::_parent_after_fork,
+                        &VectorStore::_child_after_fork);
+            });
+
+    auto &state = fork_state();
+    std::lock_guard<std::mutex> lock(state.mtx);
+    state.stores.insert(this);
+}
+
+VectorStore::~VectorStore() {
+    {
+        auto &state = fork_state();
+        std::lock_guard<std::mutex> lock(state.mtx);
+        state.stores.erase(this);
+    }
+
+    if (_storage_file) {
+        StorageFiles::instance().release(*_storage_file);
+    }
+}
+
 uint64_t VectorStore::add(uint64_t id, const std::string_view &data, const Vector &embedding) {
+    ProfileTimer timer("add");
+
     if (embedding.empty()) {
         throw Error("invalid embedding: size is 0");
     }
 
-    std::lock_guard<std::mutex> lock(_mtx);
-
     if (_dim == 0) {
-        // Use the first item's dimension as the dimension of the vector store.
-        _dim = embedding.size();
-
-        assert(_dim > 0);
-
-        _lazily_init(_dim);
+        _init_dim(embedding.size());
     }
 
     if (_dim != embedding.size()) {
         throw Error("vector dimension does not match");
     }
 
+    // Different ids can be added concurrently, and the underlying index does fine-grained locking.
+    auto lock = _shared_lock();
+    std::lock_guard<std::mutex> id_lock(_id_mutex(id));
+
     _add(id, embedding);
 
-    _data_store[id] = data;
+    {
+        std::lock_guard<std::mutex> data_lock(_data_mtx);
+
+        _data_store[id] = data;
+    }
 
     return id;
 }
@@ -53,24 +207,32 @@ uint64_t VectorStore::add(const std::string_view &data, const Vector &embedding)
 }
 
 bool VectorStore::rem(uint64_t id) {
-    std::lock_guard<std::mutex> lock(_mtx);
+    auto lock = _shared_lock();
+    std::lock_guard<std::mutex> id_lock(_id_mutex(id));
 
-    auto iter = _data_store.find(id);
-    if (iter == _data_store.end()) {
-        return false;
+    {
+        std::lock_guard<std::mutex> data_lock(_data_mtx);
+
+        if (_data_store.find(id) == _data_store.end()) {
+            return false;
+        }
     }
 
     _rem(id);
 
-    _data_store.erase(iter);
+    {
+        std::lock_guard<std::mutex> data_lock(_data_mtx);
+
+        _data_store.erase(id);
+    }
 
     return true;
 }
 
 std::optional<Vector> VectorStore::get(uint64_t id) {
-    std::lock_guard<std::mutex> lock(_mtx);
+    auto lock = _shared_lock();
 
-    if (_data_store.empty()) {
+    if (_dim == 0) {
         return std::nullopt;
     }
 
@@ -78,7 +240,7 @@ std::optional<Vector> VectorStore::get(uint64_t id) {
 }
 
 std::optional<std::string> VectorStore::data(uint64_t id) {
-    std::lock_guard<std::mutex> lock(_mtx);
+    std::lock_guard<std::mutex> lock(_data_mtx);
 
     auto iter = _data_store.find(id);
     if (iter == _data_store.end()) {
@@ -89,15 +251,219 @@ std::optional<std::string> VectorStore::data(uint64_t id) {
 }
 
 std::vector<std::pair<uint64_t, float>> VectorStore::knn(const Vector &query, std::size_t k) {
-    std::lock_guard<std::mutex> lock(_mtx);
+    LatencyTimer timer(Latency::KNN);
+
+    auto lock = _shared_lock();
 
-    if (_data_store.empty()) {
+    if (_dim == 0 || size() == 0) {
         return {};
     }
 
     return _knn(query, k);
 }
 
+std::size_t VectorStore::size() {
+    std::lock_guard<std::mutex> lock(_data_mtx);
+
+    return _data_store.size();
+}
+
+void VectorStore::_init_dim(std::size_t dim) {
+    assert(dim > 0);
+
+    std::unique_lock<std::shared_mutex> lock(_mtx);
+
+    if (_dim == 0) {
+        // Use the first item's dimension as the dimension of the vector store.
+        _lazily_init(dim);
+
+        _dim = dim;
+    }
+}
+
+std::pair<std::string, uint64_t> VectorStore::dump() {
+    if (!_storage_file) {
+        throw Error("vector store is not stored in file");
+    }
+
+    // Files of each version are written only once, and never modified.
+    auto file = StorageFiles::new_version(*_storage_file);
+    auto index_file = StorageFiles::index_path(file);
+    auto data_file = StorageFiles::data_path(file);
+
+    auto lock = _shared_lock();
+
+    try {
+        uint64_t sum = util::checksum(nullptr, 0);
+        if (_dim > 0) {
+            sum = _dump_index(index_file);
+        } else {
+            // Index has not been created yet.
+            std::ofstream(index_file, std::ios::binary | std::ios::trunc);
+        }
+
+        std::ofstream output(data_file, std::ios::binary | std::ios::trunc);
+
+        auto write = [&output, &sum](const char *data, std::size_t len) {
+            output.write(data, len);
+            sum = util::checksum(data, len, sum);
+        };
+
+        write(DATA_FILE_MAGIC.data(), DATA_FILE_MAGIC.size());
+
+        std::lock_guard<std::mutex> data_lock(_data_mtx);
+
+        uint64_t cnt = _data_store.size();
+        write(reinterpret_cast<const char *>(&cnt), sizeof(cnt));
+        for (const auto &[id, data] : _data_store) {
+            uint64_t len = data.size();
+            write(reinterpret_cast<const char *>(&id), sizeof(id));
+            write(reinterpret_cast<const char *>(&len), sizeof(len));
+            write(data.data(), data.size());
+        }
+
+        output.flush();
+        if (!output) {
+            throw Error("failed to write data file: " + data_file);
+        }
+
+        return {file, sum};
+    } catch (...) {
+        std::remove(index_file.data());
+        std::remove(data_file.data());
+        throw;
+    }
+}
+
+void VectorStore::load(const std::string &file, uint64_t sum, std::size_t dim) {
+    std::unique_lock<std::shared_mutex> lock(_mtx);
+
+    auto &storage_files = StorageFiles::instance();
+    auto prefix = StorageFiles::prefix(file);
+    if (_storage_file != prefix) {
+        if (_storage_file) {
+            storage_files.release(*_storage_file);
+        }
+
+        storage_files.acquire(prefix);
+        _storage_file = prefix;
+    }
+
+    uint64_t expected_sum = util::checksum(nullptr, 0);
+    if (dim > 0) {
+        // The base layer of the index is mapped, and paged in when it's accessed.
+        expected_sum = _load_index(StorageFiles::index_path(file), dim);
+    }
+
+    _dim = dim;
+
+    auto data_file = StorageFiles::data_path(file);
+    MappedFile data(data_file);
+
+    if (util::checksum(data.data(), data.size(), expected_sum) != sum) {
+        throw Error("checksum mismatch for vector store file: " + file);
+    }
+
+    const auto *cur = data.data();
+    const auto *end = cur + data.size();
+    if (data.size() < DATA_FILE_MAGIC.size()
+            || std::string_view(cur, DATA_FILE_MAGIC.size()) != DATA_FILE_MAGIC) {
+        throw Error("invalid data file: " + data_file);
+    }
+    cur += DATA_FILE_MAGIC.size();
+
+    std::unordered_map<uint64_t, std::string> data_store;
+    auto cnt = read_pod<uint64_t>(cur, end);
+    data_store.reserve(cnt);
+    for (uint64_t idx = 0; idx != cnt; ++idx) {
+        auto id = read_pod<uint64_t>(cur, end);
+        auto len = read_pod<uint64_t>(cur, end);
+        if (static_cast<uint64_t>(end - cur) < len) {
+            throw Error("truncated data file: " + data_file);
+        }
+        data_store.emplace(id, std::string(cur, len));
+        cur += len;
+    }
+
+    std::lock_guard<std::mutex> data_lock(_data_mtx);
+    _data_store = std::move(data_store);
+}
+
+uint64_t VectorStore::_dump_index(const std::string & /*path*/) {
+    throw Error("mmap storage is not supported by " + _type);
+}
+
+uint64_t VectorStore::_load_index(const std::string & /*path*/, std::size_t /*dim*/) {
+    throw Error("mmap storage is not supported by " + _type);
+}
+
+std::shared_lock<std::shared_mutex> VectorStore::_shared_lock() {
+    auto &state = fork_state();
+    if (state.pending) {
+        std::unique_lock<std::mutex> lock(state.gate_mtx);
+        state.gate_cv.wait(lock, [&state]() { return !state.pending; });
+    }
+
+    return std::shared_lock<std::shared_mutex>(_mtx);
+}
+
+void VectorStore::_prepare_fork() {
+    auto &state = fork_state();
+
+    state.mtx.lock();
+
+    state.pending = true;
+
+    for (auto *store : state.stores) {
+        store->_mtx.lock();
+        store->_data_mtx.lock();
+        store->_lock_index();
+    }
+
+    // Threads waiting on the gate do not hold it, and others only hold it for a moment.
+    state.gate_mtx.lock();
+}
+
+void VectorStore::_parent_after_fork() {
+    _unlock_after_fork(false);
+}
+
+void VectorStore::_child_after_fork() {
+    _unlock_after_fork(true);
+}
+
+void VectorStore::_unlock_after_fork(bool child) {
+    auto &state = fork_state();
+
+    if (child) {
+        for (auto *store : state.stores) {
+            store->_unlock_index(true);
+            _reset_lock(store->_data_mtx);
+            _reset_lock(store->_mtx);
+        }
+
+        // No thread waits on the gate in the child.
+        state.pending = false;
+        _reset_lock(state.gate_mtx);
+        _reset_lock(state.gate_cv);
+        _reset_lock(state.mtx);
+
+        return;
+    }
+
+    for (auto *store : state.stores) {
+        store->_unlock_index(false);
+        store->_data_mtx.unlock();
+        store->_mtx.unlock();
+    }
+
+    state.pending = false;
+    state.gate_mtx.unlock();
+    state.gate_cv.notify_all();
+
+    state.mtx.unlock();
+}
+
 uint64_t VectorStore::_auto_gen_id() {
     return ++_id_idx;
 }
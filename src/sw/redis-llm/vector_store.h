@@ -18,9 +18,12 @@
 #define SEWENEW_REDIS_LLM_VECTOR_STORE_H
 
 #include <cstdint>
+#include <array>
 #include <atomic>
 #include <mutex>
+#include <new>
 #include <optional>
+#include <shared_mutex>
 #include <unordered_map>
 #include <utility>
 #include "nlohmann/json.hpp"
@@ -31,10 +34,9 @@ namespace sw::redis::llm {
 
 class VectorStore : public Object {
 public:
-    VectorStore(const std::string &type, const nlohmann::json &conf, const LlmInfo &llm) :
-        _type(type), _conf(conf), _dim(0), _llm(llm) {}
+    VectorStore(const std::string &type, const nlohmann::json &conf, const LlmInfo &llm);
 
-    virtual ~VectorStore() = default;
+    virtual ~VectorStore();
 
     uint64_t add(uint64_t id, const std::string_view &data, const Vector &embedding);
 
@@ -49,6 +51,8 @@ public:
 
     std::vector<std::pair<uint64_t, float>> knn(const Vector &query, std::size_t k);
 
+    std::size_t size();
+
     const std::string& type() const {
         return _type;
     }
@@ -77,9 +81,39 @@ public:
         _id_idx = idx;
     }
 
+    // Ensure that auto generated ids never collide with *id*.
+    void update_id_idx(uint64_t id) {
+        auto idx = _id_idx.load();
+        while (idx < id && !_id_idx.compare_exchange_weak(idx, id)) {}
+    }
+
+    // If storage is "mmap", index and data are persisted into versioned files named with
+    // this prefix, and RDB only saves the file name and checksum. Otherwise, return std::nullopt.
+    const std::optional<std::string>& storage_file() const {
+        return _storage_file;
+    }
+
+    // Dump index and data into a new version of storage files, and return its name and
+    // checksum. It's safe to call it in a forked child, e.g. BGSAVE.
+    std::pair<std::string, uint64_t> dump();
+
+    // Load index and data from storage files, and verify them with *checksum*.
+    void load(const std::string &file, uint64_t checksum, std::size_t dim);
+
+protected:
+    // Locks held by the forking thread cannot be unlocked in the child, e.g. glibc takes
+    // a write-locked rwlock as read-locked, since the thread id differs. Instead, since
+    // there's no other thread in the child, re-initialize it.
+    template <typename Mutex>
+    static void _reset_lock(Mutex &mtx) {
+        new (&mtx) Mutex;
+    }
+
 private:
     std::unordered_map<uint64_t, std::string> _data_store;
 
+    // NOTE: _add, _rem, _get and _knn might be called concurrently, and the implementation
+    // should be thread-safe. However, operations on the same id are serialized.
     virtual void _add(uint64_t id, const Vector &embedding) = 0;
 
     virtual void _rem(uint64_t id) = 0;
@@ -90,19 +124,62 @@ private:
 
     virtual void _lazily_init(std::size_t dim) = 0;
 
+    // Vector stores that support mmap storage should override the following methods,
+    // which return checksum of the index file. The checksum might skip large parts
+    // of the file, which are mapped and loaded lazily.
+    virtual uint64_t _dump_index(const std::string &path);
+
+    virtual uint64_t _load_index(const std::string &path, std::size_t dim);
+
+    // Lock the underlying index exclusively before fork, so that it's consistent in the
+    // child process. It's called with _mtx held exclusively.
+    virtual void _lock_index() {}
+
+    // Unlock the index after fork. In the child, locks should be reset with _reset_lock.
+    virtual void _unlock_index(bool /*child*/) {}
+
+    // Wait until pending fork finishes, and lock _mtx shared.
+    std::shared_lock<std::shared_mutex> _shared_lock();
+
+    // Handlers of pthread_atfork. Lock all vector stores with mmap storage before fork,
+    // and unlock them in both parent and child. So that the child process, e.g. BGSAVE, sees a consistent snapshot,
+    // and never waits on locks held by threads which do not exist in the child.
+    static void _prepare_fork();
+
+    static void _parent_after_fork();
+
+    static void _child_after_fork();
+
+    static void _unlock_after_fork(bool child);
+
     uint64_t _auto_gen_id();
 
+    void _init_dim(std::size_t dim);
+
+    std::mutex& _id_mutex(uint64_t id) {
+        return _id_mtxs[id % _id_mtxs.size()];
+    }
+
     std::string _type;
 
     nlohmann::json _conf;
 
-    std::size_t _dim;
+    std::atomic<std::size_t> _dim;
 
     LlmInfo _llm;
 
+    std::optional<std::string> _storage_file;
+
     std::atomic<uint64_t> _id_idx{0};
 
-    std::mutex _mtx;
+    // Held exclusively only when initializing the underlying index.
+    std::shared_mutex _mtx;
+
+    // Protects _data_store.
+    std::mutex _data_mtx;
+
+    // Serialize operations on the same id.
+    std::array<std::mutex, 256> _id_mtxs;
 };
 
 using VectorStoreSPtr = std::shared_ptr<VectorStore>;
@@ -15,6 +15,7 @@
  *************************************************************************/
 
 #include "sw/redis-llm/worker_pool.h"
+#include <algorithm>
 #include <cassert>
 
 namespace sw::redis::llm {
@@ -37,22 +38,92 @@ WorkerPool::~WorkerPool() {
 
 void WorkerPool::_run() {
     while (true) {
-        std::packaged_task<void ()> task;
+        Task task;
         {
             std::unique_lock<std::mutex> lock(_mutex);
-            _cv.wait(lock, [this]() { return this->_quit || !this->_tasks.empty(); });
+            ++_idle;
+            _cv.wait(lock, [this]() { return this->_quit || this->_size > 0; });
+            --_idle;
 
-            if (_tasks.empty()) {
+            if (_size == 0) {
                 assert(_quit);
                 break;
             }
 
-            task = std::move(_tasks.front());
-            _tasks.pop();
+            task = _pop();
         }
 
-        task();
+        auto &stats = Stats::instance();
+        stats.record_since(Latency::QUEUE_WAIT, task.enqueue_time);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= task.deadline) {
+            // Nobody is waiting for it any more.
+            stats.incr(Counter::TASKS_EXPIRED);
+
+            if (task.token) {
+                task.token->cancel();
+                task.task();
+            }
+
+            continue;
+        }
+
+        task.task();
+
+        if (std::chrono::steady_clock::now() > task.deadline) {
+            stats.incr(Counter::TASKS_LATE);
+        }
+    }
+}
+
+bool WorkerPool::_full(TaskPriority priority) const {
+    const auto &tasks = _tasks[static_cast<std::size_t>(priority)];
+    if (priority == TaskPriority::BACKGROUND) {
+        return tasks.size() >= _opts.background_queue_size;
+    }
+
+    return tasks.size() >= _opts.queue_size;
+}
+
+void WorkerPool::_push(Task task, TaskPriority priority) {
+    auto &tasks = _tasks[static_cast<std::size_t>(priority)];
+    tasks.push_back(std::move(task));
+    std::push_heap(tasks.begin(), tasks.end(), _later);
+
+    ++_size;
+}
+
+auto WorkerPool::_pop() -> Task {
+    assert(_size > 0);
+
+    auto &interactive = _tasks[static_cast<std::size_t>(TaskPriority::INTERACTIVE)];
+    auto &background = _tasks[static_cast<std::size_t>(TaskPriority::BACKGROUND)];
+
+    auto *tasks = &interactive;
+    if (interactive.empty()) {
+        tasks = &background;
+    } else if (!background.empty() && _opts.background_share > 0
+            && (_interactive_streak + 1) * _opts.background_share >= 100) {
+        // Give background tasks their share.
+        tasks = &background;
     }
+
+    if (tasks == &interactive) {
+        ++_interactive_streak;
+    } else {
+        _interactive_streak = 0;
+    }
+
+    assert(!tasks->empty());
+
+    std::pop_heap(tasks->begin(), tasks->end(), _later);
+    auto task = std::move(tasks->back());
+    tasks->pop_back();
+
+    --_size;
+
+    return task;
 }
 
 void WorkerPool::_stop() {
@@ -17,22 +17,63 @@
 #ifndef SEWENEW_REDIS_LLM_WORKER_POOL_H
 #define SEWENEW_REDIS_LLM_WORKER_POOL_H
 
+#include <array>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <future>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <type_traits>
+#include <vector>
+#include "sw/redis-llm/cancel.h"
 #include "sw/redis-llm/errors.h"
+#include "sw/redis-llm/stats.h"
 
 namespace sw::redis::llm {
 
 struct WorkerPoolOptions {
     std::size_t pool_size = 10;
 
+    // Max number of queued interactive tasks.
     std::size_t queue_size = 1000;
+
+    // Max number of queued background tasks, so that a burst of them never rejects
+    // interactive tasks, and vice versa.
+    std::size_t background_queue_size = 1000;
+
+    // Tasks without deadline are ordered as if they had this deadline since being enqueued,
+    // so that tasks with deadline cannot starve them. They're never dropped though.
+    std::chrono::milliseconds default_deadline{5000};
+
+    // Percentage of tasks which go to background tasks, if both kinds are waiting,
+    // so that background tasks are not starved by interactive load. 0 means background
+    // tasks only run when no interactive task is waiting.
+    std::size_t background_share = 10;
+};
+
+// Tasks of a higher priority run first, except for the share of background tasks.
+enum class TaskPriority : std::size_t {
+    // Requests whose clients are waiting for the reply.
+    INTERACTIVE = 0,
+    // Async jobs and maintenance, e.g. summarizing chat history, vacuuming vector store.
+    BACKGROUND,
+
+    MAX
+};
+
+struct TaskOptions {
+    TaskPriority priority = TaskPriority::INTERACTIVE;
+
+    // Within the same priority, tasks with earlier deadline run first, and tasks without
+    // deadline are ordered with WorkerPoolOptions::default_deadline.
+    // A task not started before its deadline is dropped.
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+    // If not null, instead of dropping an expired task, cancel the token and still run the task,
+    // so that it can clean up, e.g. unblock its client. Such task should check the token first.
+    CancelTokenSPtr token;
 };
 
 class WorkerPool {
@@ -49,6 +90,13 @@ public:
 
     template <typename Func, typename ...Args>
     auto enqueue(Func &&func, Args &&...args)
+        -> std::future<typename std::invoke_result_t<Func, Args...>> {
+        return enqueue(TaskOptions{}, std::forward<Func>(func), std::forward<Args>(args)...);
+    }
+
+    // If the task is dropped, the returned future throws std::future_error.
+    template <typename Func, typename ...Args>
+    auto enqueue(const TaskOptions &task_opts, Func &&func, Args &&...args)
         -> std::future<typename std::invoke_result_t<Func, Args...>> {
         std::packaged_task<std::invoke_result_t<Func, Args...> ()> task(
                 std::bind(std::forward<Func>(func), std::forward<Args>(args)...));
@@ -57,30 +105,108 @@ public:
         {
             std::lock_guard<std::mutex> lock(_mutex);
 
-            if (_tasks.size() == _opts.queue_size) {
+            if (_full(task_opts.priority)) {
+                Stats::instance().incr(Counter::TASKS_REJECTED);
                 throw Error("worker queue is full");
             }
 
-            _tasks.emplace(std::move(task));
+            auto now = std::chrono::steady_clock::now();
+            auto due = task_opts.deadline;
+            if (due == std::chrono::steady_clock::time_point::max()) {
+                due = now + _opts.default_deadline;
+            }
+
+            _push(Task{std::packaged_task<void ()>(std::move(task)),
+                    now,
+                    task_opts.deadline,
+                    due,
+                    _seq++,
+                    task_opts.token},
+                    task_opts.priority);
         }
 
+        Stats::instance().incr(Counter::TASKS);
+
         _cv.notify_one();
 
         return result;
     }
 
+    const WorkerPoolOptions& options() const {
+        return _opts;
+    }
+
+    // Number of tasks waiting in the queue.
+    std::size_t queue_depth() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        return _size;
+    }
+
+    // Number of idle workers, which are not going to take queued tasks. A task enqueued
+    // now is likely to start right away, if it's positive.
+    std::size_t idle_workers() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        return _idle > _size ? _idle - _size : 0;
+    }
+
 private:
+    struct Task {
+        std::packaged_task<void ()> task;
+
+        std::chrono::steady_clock::time_point enqueue_time;
+
+        std::chrono::steady_clock::time_point deadline;
+
+        // Order of tasks, i.e. deadline, or the default one if the task has no deadline.
+        std::chrono::steady_clock::time_point due;
+
+        // Break ties of due time in FIFO order.
+        uint64_t seq = 0;
+
+        CancelTokenSPtr token;
+    };
+
+    // Order of a min heap, i.e. earliest due time at top.
+    static bool _later(const Task &lhs, const Task &rhs) {
+        if (lhs.due != rhs.due) {
+            return lhs.due > rhs.due;
+        }
+
+        return lhs.seq > rhs.seq;
+    }
+
+    bool _full(TaskPriority priority) const;
+
+    void _push(Task task, TaskPriority priority);
+
+    // Pop the most urgent task. The queue should not be empty.
+    Task _pop();
+
     void _stop();
 
     void _run();
 
     WorkerPoolOptions _opts;
 
-    std::queue<std::packaged_task<void ()>> _tasks;
+    // A heap of tasks for each priority.
+    std::array<std::vector<Task>, static_cast<std::size_t>(TaskPriority::MAX)> _tasks;
+
+    // Total number of queued tasks.
+    std::size_t _size = 0;
+
+    // Number of workers waiting for tasks.
+    std::size_t _idle = 0;
+
+    // Number of interactive tasks popped since the last background task.
+    std::size_t _interactive_streak = 0;
+
+    uint64_t _seq = 0;
 
     bool _quit;
 
-    std::mutex _mutex;
+    mutable std::mutex _mutex;
 
     std::condition_variable _cv;
 